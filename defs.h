@@ -26,9 +26,12 @@ enum {
 /* File I/O structure.
  */
 typedef	struct fileinfo {
-    char       *name;		/* the name of the file */
-    FILE       *fp;		/* the real file handle */
-    char	alloc;		/* TRUE if name was allocated internally */
+    char	       *name;		/* the name of the file */
+    FILE	       *fp;		/* the real file handle */
+    char		alloc;		/* TRUE if name was allocated internally */
+    unsigned char      *buf;		/* the file's contents, if buffered */
+    unsigned long	bufsize;	/* the size of the buffered contents */
+    unsigned long	bufpos;		/* the current position in buf */
 } fileinfo;
 
 /* Pseudorandom number generators.
@@ -118,6 +121,8 @@ enum {
     CmdSeeSolutionFiles,
     CmdVolumeUp,
     CmdVolumeDown,
+    CmdFaster,
+    CmdSlower,
     CmdStepping,
     CmdSubStepping,
     CmdRndSlideDir,
@@ -189,7 +194,12 @@ typedef	struct gamesetup {
     int			solutionsize;	/* size of the saved solution data */
     unsigned char      *leveldata;	/* the data defining the level */
     unsigned char      *solutiondata;	/* the player's best solution so far */
+    unsigned char      *levelimage;	/* the compiled level, or NULL */
     unsigned long	levelhash;	/* the level data's hash value */
+    fpos_t		levelpos;	/* location of the level in its file */
+    unsigned long	solutionhash;	/* the solution data's hash value */
+    fpos_t		solutionpos;	/* where the solution is in its file */
+    int			ldflags;	/* level data flags (see below) */
     char const	       *unsolvable;	/* why level is unsolvable, or NULL */
     char		name[256];	/* name of the level */
     char		passwd[256];	/* the level's password */
@@ -201,6 +211,12 @@ typedef	struct gamesetup {
 #define	SGF_REPLACEABLE		0x0002	/* solution is marked as replaceable */
 #define	SGF_SETNAME		0x0004	/* internal to solution.c */
 
+/* Flags describing a level's data.
+ */
+#define	LDF_REREADABLE		0x0001	/* data can be reread from the file */
+#define	LDF_RECENTLYUSED	0x0002	/* data has been used recently */
+#define	LDF_SOLREREADABLE	0x0004	/* solution can be reread from file */
+
 /* A structure for storing a message text.
  */
 typedef struct taggedtext {
@@ -218,6 +234,8 @@ typedef	struct gameseries {
     int			ruleset;	/* the ruleset for the game file */
     int			gsflags;	/* series flags (see below) */
     gamesetup	       *games;		/* the array of levels */
+    int		       *levelindex;	/* hash tables for finding levels */
+    int			indexsize;	/* size of each hash table */
     fileinfo		mapfile;	/* the file containing the levels */
     char	       *mapfilename;	/* the name of said file */
     fileinfo		savefile;	/* the file holding the solutions */
@@ -238,5 +256,6 @@ typedef	struct gameseries {
 #define	GSF_NODEFAULTSAVE	0x0004	/* don't use default tws filename */
 #define	GSF_IGNOREPASSWDS	0x0008	/* don't require passwords */
 #define	GSF_LYNXFIXES		0x0010	/* change MS data into Lynx levels */
+#define	GSF_COMPILED		0x0020	/* data file contains level images */
 
 #endif
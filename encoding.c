@@ -22,6 +22,31 @@
  */
 #define	readpos(x, y)	(*(x) < CXGRID ? *(x) + CYGRID * *(y) : CXGRID*CYGRID)
 
+/* Store a 16-bit value little-endian in a compiled level image.
+ */
+#define	writeword(p, v)	((p)[0] = (v) & 0xFF, (p)[1] = ((v) >> 8) & 0xFF)
+
+/* The layout of a compiled level image. All values are stored
+ * little-endian. The tables are stored at their full size, so that
+ * every field is found at a fixed offset. The map is stored with four
+ * bytes per cell: the top tile's id and state, followed by the bottom
+ * tile's id and state.
+ */
+#define	IMG_MARKER	0		/* LEVELIMAGE_MARKER if valid */
+#define	IMG_CHIPS	2		/* no. of chips needed */
+#define	IMG_FLAGS	4		/* status flags set by the decoder */
+#define	IMG_TRAPCOUNT	6		/* number of trap wirings */
+#define	IMG_CLONERCOUNT	8		/* number of cloner wirings */
+#define	IMG_CRLISTCOUNT	10		/* number of creatures */
+#define	IMG_LEVELHASH	12		/* hash value of the level data */
+#define	IMG_TRAPS	16		/* 256 trap wirings */
+#define	IMG_CLONERS	(IMG_TRAPS + 256 * 4)	/* 256 cloner wirings */
+#define	IMG_CRLIST	(IMG_CLONERS + 256 * 4)	/* 256 creatures */
+#define	IMG_HINTTEXT	(IMG_CRLIST + 256 * 2)	/* the hint text */
+#define	IMG_MAP		(IMG_HINTTEXT + 256)	/* the map cells */
+
+#define	LEVELIMAGE_MARKER	0x4C43
+
 /* Translation table for the codes used by the data file to define the
  * initial state of a level.
  */
@@ -305,13 +330,164 @@ static int expandmsdatlevel(gamestate *state)
     return FALSE;
 }
 
-/* Exported interface.
+/* Initialize the gamestate by copying in the contents of a compiled
+ * level image.
+ */
+static int loadlevelimage(gamestate *state)
+{
+    unsigned char const	       *image;
+    unsigned char const	       *p;
+    int				i;
+
+    image = state->game->levelimage;
+    state->chipsneeded = readword(image + IMG_CHIPS);
+    state->statusflags |= readword(image + IMG_FLAGS) & SF_BADTILES;
+    state->trapcount = readword(image + IMG_TRAPCOUNT);
+    state->clonercount = readword(image + IMG_CLONERCOUNT);
+    state->crlistcount = readword(image + IMG_CRLISTCOUNT);
+    for (i = 0, p = image + IMG_TRAPS ; i < state->trapcount ; ++i, p += 4) {
+	state->traps[i].from = readword(p);
+	state->traps[i].to = readword(p + 2);
+    }
+    p = image + IMG_CLONERS;
+    for (i = 0 ; i < state->clonercount ; ++i, p += 4) {
+	state->cloners[i].from = readword(p);
+	state->cloners[i].to = readword(p + 2);
+    }
+    for (i = 0, p = image + IMG_CRLIST ; i < state->crlistcount ; ++i, p += 2)
+	state->crlist[i] = readword(p);
+    memcpy(state->hinttext, image + IMG_HINTTEXT, sizeof state->hinttext);
+    if (sizeof *state->map == 4) {
+	memcpy(state->map, image + IMG_MAP, sizeof state->map);
+    } else {
+	for (i = 0, p = image + IMG_MAP ; i < CXGRID * CYGRID ; ++i, p += 4) {
+	    state->map[i].top.id = p[0];
+	    state->map[i].top.state = p[1];
+	    state->map[i].bot.id = p[2];
+	    state->map[i].bot.state = p[3];
+	}
+    }
+    return TRUE;
+}
+
+/*
+ * Exported interface.
+ */
+
+/* Initialize the gamestate from the level data, using the compiled
+ * image of the level if one is available.
  */
 int expandleveldata(gamestate *state)
 {
+    if (state->game->levelimage)
+	return loadlevelimage(state);
     return expandmsdatlevel(state);
 }
 
+/* Decode the given level and store the result in image as a compiled
+ * level image.
+ */
+int compileleveldata(gamesetup const *game, unsigned char *image)
+{
+    static gamestate	scratch;
+    unsigned char      *p;
+    int			i;
+
+    memset(image, 0, LEVELIMAGE_SIZE);
+    scratch.game = (gamesetup*)game;
+    scratch.statusflags = 0;
+    if (!expandmsdatlevel(&scratch))
+	return FALSE;
+
+    writeword(image + IMG_MARKER, LEVELIMAGE_MARKER);
+    writeword(image + IMG_CHIPS, scratch.chipsneeded);
+    writeword(image + IMG_FLAGS, scratch.statusflags & SF_BADTILES);
+    writeword(image + IMG_TRAPCOUNT, scratch.trapcount);
+    writeword(image + IMG_CLONERCOUNT, scratch.clonercount);
+    writeword(image + IMG_CRLISTCOUNT, scratch.crlistcount);
+    writeword(image + IMG_LEVELHASH, game->levelhash & 0xFFFF);
+    writeword(image + IMG_LEVELHASH + 2, (game->levelhash >> 16) & 0xFFFF);
+    for (i = 0, p = image + IMG_TRAPS ; i < scratch.trapcount ; ++i, p += 4) {
+	writeword(p, scratch.traps[i].from);
+	writeword(p + 2, scratch.traps[i].to);
+    }
+    p = image + IMG_CLONERS;
+    for (i = 0 ; i < scratch.clonercount ; ++i, p += 4) {
+	writeword(p, scratch.cloners[i].from);
+	writeword(p + 2, scratch.cloners[i].to);
+    }
+    for (i = 0, p = image + IMG_CRLIST ; i < scratch.crlistcount ; ++i, p += 2)
+	writeword(p, scratch.crlist[i]);
+    strcpy((char*)image + IMG_HINTTEXT, scratch.hinttext);
+    for (i = 0, p = image + IMG_MAP ; i < CXGRID * CYGRID ; ++i, p += 4) {
+	p[0] = scratch.map[i].top.id;
+	p[1] = scratch.map[i].top.state;
+	p[2] = scratch.map[i].bot.id;
+	p[3] = scratch.map[i].bot.state;
+    }
+    return TRUE;
+}
+
+/* Return TRUE if id is a tile that expandmsdatlevel() can produce.
+ */
+static int validtileid(int id)
+{
+    static char	valid[256];
+    static int	initialized = FALSE;
+    int		n;
+
+    if (!initialized) {
+	valid[Nothing] = TRUE;
+	for (n = 0 ; n < (int)(sizeof fileids / sizeof *fileids) ; ++n)
+	    valid[fileids[n]] = TRUE;
+	initialized = TRUE;
+    }
+    return valid[id];
+}
+
+/* Validate a compiled level image read from a file. The image is
+ * rejected if it was compiled from different level data, or if it
+ * contains anything that expandmsdatlevel() would not have produced.
+ */
+int checklevelimage(unsigned char const *image, unsigned long levelhash)
+{
+    unsigned char const	       *p;
+    int				i, n;
+
+    if (readword(image + IMG_MARKER) != LEVELIMAGE_MARKER)
+	return FALSE;
+    if (readword(image + IMG_LEVELHASH) != (int)(levelhash & 0xFFFF)
+		|| readword(image + IMG_LEVELHASH + 2)
+				!= (int)((levelhash >> 16) & 0xFFFF))
+	return FALSE;
+
+    n = readword(image + IMG_TRAPCOUNT);
+    if (n > 256)
+	return FALSE;
+    for (i = 0, p = image + IMG_TRAPS ; i < n * 2 ; ++i, p += 2)
+	if (readword(p) > CXGRID * CYGRID)
+	    return FALSE;
+    n = readword(image + IMG_CLONERCOUNT);
+    if (n > 256)
+	return FALSE;
+    for (i = 0, p = image + IMG_CLONERS ; i < n * 2 ; ++i, p += 2)
+	if (readword(p) > CXGRID * CYGRID)
+	    return FALSE;
+    n = readword(image + IMG_CRLISTCOUNT);
+    if (n > 256)
+	return FALSE;
+    for (i = 0, p = image + IMG_CRLIST ; i < n ; ++i, p += 2)
+	if (readword(p) > CXGRID * CYGRID)
+	    return FALSE;
+
+    if (!memchr(image + IMG_HINTTEXT, '\0', 256))
+	return FALSE;
+    for (i = 0, p = image + IMG_MAP ; i < CXGRID * CYGRID ; ++i, p += 4)
+	if (!validtileid(p[0]) || p[1] || !validtileid(p[2]) || p[3])
+	    return FALSE;
+    return TRUE;
+}
+
 /* Return the setup for a small level to display at the completion of
  * a series.
  */
@@ -345,6 +521,7 @@ void getenddisplaysetup(gamestate *state)
     ending.leveldata = endingdata;
     ending.solutionsize = 0;
     ending.solutiondata = NULL;
+    ending.levelimage = NULL;
     strcpy(ending.name, "CONGRATULATIONS!");
     ending.passwd[0] = '\0';
 
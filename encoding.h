@@ -9,11 +9,31 @@
 
 #include	"state.h"
 
+/* The size of a compiled level image. A compiled image holds a
+ * level's map, wirings, creature list, and hint text, already decoded
+ * into the form used by the gamestate structure.
+ */
+#define	LEVELIMAGE_SIZE		6928
+
 /* Initialize the gamestate by reading the level data from the setup.
  * FALSE is returned if the level data is invalid.
  */
 extern int expandleveldata(gamestate *state);
 
+/* Decode the level data in game and store the results in image,
+ * which must point to a buffer of LEVELIMAGE_SIZE bytes. FALSE is
+ * returned if the level data is invalid, in which case the image is
+ * marked as unusable.
+ */
+extern int compileleveldata(gamesetup const *game, unsigned char *image);
+
+/* Return TRUE if image is a usable compiled level image. levelhash
+ * is the hash value of the level data that the image accompanies; an
+ * image compiled from other data is not usable.
+ */
+extern int checklevelimage(unsigned char const *image,
+			   unsigned long levelhash);
+
 /* Return the setup for a small level, created at runtime, that can be
  * displayed at the completion of a series.
  */
@@ -44,6 +44,15 @@
 #  endif
 #endif
 
+/* The number of bytes remaining to be read in a buffered file.
+ */
+#define	bufleft(file)	((file)->bufpos < (file)->bufsize ? \
+				(file)->bufsize - (file)->bufpos : 0)
+
+/* The address of the current position in a buffered file.
+ */
+#define	bufptr(file)	((file)->buf + (file)->bufpos)
+
 /* The function used to display error messages relating to file I/O.
  */
 int _fileerr(char const *cfile, unsigned long lineno,
@@ -69,6 +78,9 @@ void clearfileinfo(fileinfo *file)
     file->name = NULL;
     file->fp = NULL;
     file->alloc = FALSE;
+    file->buf = NULL;
+    file->bufsize = 0;
+    file->bufpos = 0;
 }
 
 /* Open a file. If the fileinfo structure does not already have a
@@ -90,6 +102,9 @@ int fileopen(fileinfo *file, char const *name, char const *mode,
 	    file->alloc = FALSE;
 	}
     }
+    file->buf = NULL;
+    file->bufsize = 0;
+    file->bufpos = 0;
     errno = 0;
     file->fp = fopen(name, mode);
     if (file->fp)
@@ -108,6 +123,12 @@ void fileclose(fileinfo *file, char const *msg)
 	    fileerr(file, msg);
 	file->fp = NULL;
     }
+    if (file->buf) {
+	free(file->buf);
+	file->buf = NULL;
+	file->bufsize = 0;
+	file->bufpos = 0;
+    }
     if (file->alloc) {
 	free(file->name);
 	file->name = NULL;
@@ -115,6 +136,39 @@ void fileclose(fileinfo *file, char const *msg)
     }
 }
 
+/* Read the entire file into memory. The current position in the file
+ * is retained. If the file cannot be read in, the file is left as it
+ * was, so that the caller can continue to use it unbuffered.
+ */
+int filebuffer(fileinfo *file, char const *msg)
+{
+    long	pos, size;
+
+    if (file->buf)
+	return TRUE;
+    errno = 0;
+    if ((pos = ftell(file->fp)) < 0)
+	return fileerr(file, msg);
+    if (fseek(file->fp, 0, SEEK_END) || (size = ftell(file->fp)) < 0)
+	goto failure;
+    if (!(file->buf = malloc(size ? size : 1)))
+	goto failure;
+    rewind(file->fp);
+    if (size && fread(file->buf, size, 1, file->fp) != 1) {
+	free(file->buf);
+	file->buf = NULL;
+	goto failure;
+    }
+    file->bufsize = size;
+    file->bufpos = pos;
+    return TRUE;
+
+  failure:
+    fileerr(file, msg);
+    fseek(file->fp, pos, SEEK_SET);
+    return FALSE;
+}
+
 /* fgetpos().
  */
 int filegetpos(fileinfo *file, fpos_t *pos, char const *msg)
@@ -140,6 +194,10 @@ int filesetpos(fileinfo *file, fpos_t *pos, char const *msg)
 int filerewind(fileinfo *file, char const *msg)
 {
     (void)msg;
+    if (file->buf) {
+	file->bufpos = 0;
+	return TRUE;
+    }
     rewind(file->fp);
     return TRUE;
 }
@@ -149,6 +207,14 @@ int filerewind(fileinfo *file, char const *msg)
 int fileskip(fileinfo *file, int offset, char const *msg)
 {
     errno = 0;
+    if (file->buf) {
+	if (offset < 0 && (unsigned long)-offset > file->bufpos) {
+	    errno = EINVAL;
+	    return fileerr(file, msg);
+	}
+	file->bufpos += offset;
+	return TRUE;
+    }
     if (!fseek(file->fp, offset, SEEK_CUR))
 	return TRUE;
     return fileerr(file, msg);
@@ -160,6 +226,8 @@ int filetestend(fileinfo *file)
 {
     int	ch;
 
+    if (file->buf)
+	return !bufleft(file);
     if (feof(file->fp))
 	return TRUE;
     ch = fgetc(file->fp);
@@ -176,6 +244,13 @@ int fileread(fileinfo *file, void *data, unsigned long size, char const *msg)
     if (!size)
 	return TRUE;
     errno = 0;
+    if (file->buf) {
+	if (bufleft(file) < size)
+	    return fileerr(file, msg);
+	memcpy(data, bufptr(file), size);
+	file->bufpos += size;
+	return TRUE;
+    }
     if (fread(data, size, 1, file->fp) == 1)
 	return TRUE;
     return fileerr(file, msg);
@@ -194,6 +269,16 @@ void *filereadbuf(fileinfo *file, unsigned long size, char const *msg)
     if (!size)
 	return buf;
     errno = 0;
+    if (file->buf) {
+	if (bufleft(file) < size) {
+	    fileerr(file, msg);
+	    free(buf);
+	    return NULL;
+	}
+	memcpy(buf, bufptr(file), size);
+	file->bufpos += size;
+	return buf;
+    }
     if (fread(buf, size, 1, file->fp) != 1) {
 	fileerr(file, msg);
 	free(buf);
@@ -214,13 +299,24 @@ int filegetline(fileinfo *file, char *buf, int *len, char const *msg)
 	return TRUE;
     }
     errno = 0;
-    if (!fgets(buf, *len, file->fp))
+    if (file->buf) {
+	if (!bufleft(file))
+	    return fileerr(file, msg);
+	for (n = 0 ; n < *len - 1 && bufleft(file) ; )
+	    if ((buf[n++] = file->buf[file->bufpos++]) == '\n')
+		break;
+	buf[n] = '\0';
+    } else if (!fgets(buf, *len, file->fp))
 	return fileerr(file, msg);
     n = strlen(buf);
     if (n == *len - 1 && buf[n] != '\n') {
-	do
-	    ch = fgetc(file->fp);
-	while (ch != EOF && ch != '\n');
+	if (file->buf) {
+	    while (bufleft(file) && file->buf[file->bufpos++] != '\n') ;
+	} else {
+	    do
+		ch = fgetc(file->fp);
+	    while (ch != EOF && ch != '\n');
+	}
     } else
 	buf[n--] = '\0';
     *len = n;
@@ -247,6 +343,12 @@ int filereadint8(fileinfo *file, unsigned char *val8, char const *msg)
     int	byte;
 
     errno = 0;
+    if (file->buf) {
+	if (!bufleft(file))
+	    return fileerr(file, msg);
+	*val8 = file->buf[file->bufpos++];
+	return TRUE;
+    }
     if ((byte = fgetc(file->fp)) == EOF)
 	return fileerr(file, msg);
     *val8 = (unsigned char)byte;
@@ -267,9 +369,18 @@ int filewriteint8(fileinfo *file, unsigned char val8, char const *msg)
  */
 int filereadint16(fileinfo *file, unsigned short *val16, char const *msg)
 {
-    int	byte;
+    unsigned char const	       *p;
+    int				byte;
 
     errno = 0;
+    if (file->buf) {
+	if (bufleft(file) < 2)
+	    return fileerr(file, msg);
+	p = bufptr(file);
+	*val16 = p[0] | (p[1] << 8);
+	file->bufpos += 2;
+	return TRUE;
+    }
     if ((byte = fgetc(file->fp)) != EOF) {
 	*val16 = byte & 0xFFU;
 	if ((byte = fgetc(file->fp)) != EOF) {
@@ -295,9 +406,19 @@ int filewriteint16(fileinfo *file, unsigned short val16, char const *msg)
  */
 int filereadint32(fileinfo *file, unsigned long *val32, char const *msg)
 {
-    int	byte;
+    unsigned char const	       *p;
+    int				byte;
 
     errno = 0;
+    if (file->buf) {
+	if (bufleft(file) < 4)
+	    return fileerr(file, msg);
+	p = bufptr(file);
+	*val32 = (unsigned long)p[0] | ((unsigned long)p[1] << 8)
+	       | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+	file->bufpos += 4;
+	return TRUE;
+    }
     if ((byte = fgetc(file->fp)) != EOF) {
 	*val32 = byte & 0xFFUL;
 	if ((byte = fgetc(file->fp)) != EOF) {
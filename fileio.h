@@ -23,8 +23,17 @@ extern void clearfileinfo(fileinfo *file);
 extern int fileopen(fileinfo *file, char const *name, char const *mode,
 		    char const *msg);
 
+/* Read the entire contents of a file opened for binary reading into
+ * memory. Until the file is closed, the reading functions take their
+ * data directly from memory instead of going through the standard I/O
+ * library. The file's current position is unchanged. If FALSE is
+ * returned, the file can still be read normally.
+ */
+extern int filebuffer(fileinfo *file, char const *msg);
+
 /* The following functions correspond directly to C's standard I/O
- * functions. The extra msg parameter works as described above for
+ * functions. filegetpos() and filesetpos() cannot be used with a
+ * buffered file. The extra msg parameter works as described above for
  * fileopen().
  */
 extern int filerewind(fileinfo *file, char const *msg);
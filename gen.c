@@ -0,0 +1,26 @@
+/* gen.c: General functions belonging to no single module.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	"gen.h"
+
+/* Return the cells of the table row at the position given by pos,
+ * and update pos to the position of the following row.
+ */
+char const * const *gettablerow(tablespec const *table, int *pos,
+				char const **cells)
+{
+    char const * const *row;
+    int			i, n;
+
+    if (table->getrow) {
+	(*table->getrow)(table->rowdata, (*pos)++, cells);
+	return cells;
+    }
+    row = (char const * const*)table->items + *pos;
+    for (i = 0, n = 0 ; i < table->cols ; i += row[n++][0] - '0') ;
+    *pos += n;
+    return row;
+}
@@ -26,6 +26,14 @@
  * the cell, "+" to align to the right, "." to center the text, and
  * "!" to permit the cell to occupy multiple lines, with word
  * wrapping. At most one cell in a given row can be word-wrapped.
+ *
+ * Instead of having its contents in items, a table can produce its
+ * rows on demand through getrow. The function stores the strings of
+ * the cells of the given row in cells, which has room for one string
+ * per column, and returns the number of cells. The strings need only
+ * remain valid until the next call. Code that walks through a table
+ * keeps the position of a row as the index of its first entry in
+ * items, or as the row number in a table that uses getrow.
  */
 typedef	struct tablespec {
     short	rows;		/* number of rows */
@@ -33,8 +41,18 @@ typedef	struct tablespec {
     short	sep;		/* amount of space between columns */
     short	collapse;	/* the column to squeeze if necessary */
     char      **items;		/* the table's contents */
+    int	      (*getrow)(void *data, int row, char const **cells);
+				/* the producer of the rows, if any */
+    void       *rowdata;	/* the data passed to getrow */
 } tablespec;
 
+/* Return the cells of the table row at the position given by pos,
+ * and update pos to the position of the following row. cells
+ * provides storage for a row that the table produces on demand.
+ */
+extern char const * const *gettablerow(tablespec const *table, int *pos,
+				       char const **cells);
+
 /* The dimensions of a level.
  */
 #define	CXGRID	32
@@ -21,10 +21,22 @@ static char *yowzitch_items[] = {
     "1-Usage:", "2-tworld [OPTIONS] [LEVELSET] [SAVEFILE] [LEVEL]",
     "1+-F,", "1---full-screen ",
 	     "1!Run in full-screen mode.",
+    "1+", "1---scale=N ",
+	     "1!Enlarge the display by a factor of N (between 1 and 4).",
     "1+-n,", "1---volume=N ",
 	     "1!Set initial volume to N (between 0 and 10).",
     "1+-a,", "1---audio-buffer=N ",
              "1!Set audio buffer size (between 1 and 6).",
+    "1+", "1---catch-up=N ",
+	     "1!Give up on the game time lost when more than N ticks behind.",
+    "1+", "1---frame-rate=N ",
+	     "1!Draw N frames per second during play.",
+    "1+", "1---export-video=FILE ",
+	     "1!Write a video of the solution for LEVEL to FILE and exit.",
+    "1+", "1---map-images=DIR ",
+	     "1!Write images of the named level set's maps to DIR and exit.",
+    "1+", "1---telemetry=FILE ",
+	     "1!Show where each tick's time goes, and write it to FILE.",
     "1+-q,", "1---quiet ",
              "1!Disable all audio output.",
     "1+-r,", "1---read-only ",
@@ -49,6 +61,10 @@ static char *yowzitch_items[] = {
              "1!Display times for the named level set and exit.",
     "1+-b,", "1---batch-verify ",
              "1!Verify solutions for the named level set and exit.",
+    "1+", "1---compile-levelset=FILE ",
+             "1!Write the named level set to FILE in compiled form and exit.",
+    "1+", "1---level-memory=N ",
+             "1!Keep at most N kilobytes of levels and solutions in memory.",
     "1+-d,", "1---list-dirs ",
              "1!Display default directories and exit.",
     "1+-h,", "1---help ",
@@ -61,7 +77,8 @@ static char *yowzitch_items[] = {
     "3!LEVEL specifies the level number to start at.",
     "3!SAVEFILE specifies an alternate solution file."
 };
-static tablespec const yowzitch_table = { 23, 3, 1, -1, yowzitch_items };
+static tablespec const yowzitch_table = { 31, 3, 1, -1,
+					  yowzitch_items, NULL, NULL };
 tablespec const *yowzitch = &yowzitch_table;
 
 /* Version and license information.
@@ -84,7 +101,8 @@ static char *vourzhon_items[] = {
     "1!Bug reports are appreciated, and can be sent to"
     " breadbox@muppetlabs.com."
 };
-static tablespec const vourzhon_table = { 9, 1, 0, -1, vourzhon_items };
+static tablespec const vourzhon_table = { 9, 1, 0, -1,
+					  vourzhon_items, NULL, NULL };
 tablespec const *vourzhon = &vourzhon_table;
 
 /* Descriptions of the different surfaces of the levels.
@@ -250,7 +268,7 @@ void onlinemainhelp(int topic)
 	"1+\267", "1-About Tile World",
 	"1+\267", "1-Return to the program"
     };
-    static tablespec const table = { 7, 2, 1, 1, items };
+    static tablespec const table = { 7, 2, 1, 1, items, NULL, NULL };
 
     int n;
 
@@ -325,7 +343,8 @@ void onlinecontexthelp(int topic)
 	"1-",
 	"1!Now, press any key to go back to the list of level sets."
     };
-    static tablespec const firsthelp_table = { 9, 1, 0, 1, firsthelp_items };
+    static tablespec const firsthelp_table = { 9, 1, 0, 1,
+					       firsthelp_items, NULL, NULL };
 
     switch (topic) {
       case Help_First:
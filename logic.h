@@ -17,11 +17,19 @@ struct gamelogic {
     gamestate  *state;			  /* ptr to the current game state */
     int		localstateinfosize;	  /* how big to make localstateinfo */
     int	      (*initgame)(gamelogic*);	  /* prepare to play a game */
+    int	      (*restoregame)(gamelogic*); /* replay a saved initial state */
     int	      (*advancegame)(gamelogic*); /* advance the game one tick */
     int	      (*endgame)(gamelogic*);	  /* clean up after the game is done */
     void      (*shutdown)(gamelogic*);	  /* turn off the logic engine */
 };
 
+/* restoregame is called in place of initgame when the game state,
+ * including localstateinfo, has been restored to a copy taken after
+ * an earlier call to initgame for the same level. It is NULL if the
+ * engine keeps state outside of the gamestate that such a copy would
+ * miss.
+ */
+
 /* The available game logic engines.
  */
 extern gamelogic *lynxlogicstartup(void);
@@ -11,6 +11,7 @@
 #include	"state.h"
 #include	"random.h"
 #include	"logic.h"
+#include	"telemetry.h"
 
 /* A number well above the maximum number of creatures that could possibly
  * exist simultaneously.
@@ -1206,7 +1207,7 @@ static int continuemovement(creature *cr)
  */
 static int endmovement(creature *cr)
 {
-    int	floor;
+    int	floor, button, phase;
     int	survived = TRUE;
 
     if (isanimation(cr->id))
@@ -1321,6 +1322,8 @@ static int endmovement(creature *cr)
     if (!survived)
 	return FALSE;
 
+    button = floor >= Button_Blue && floor <= Button_Brown;
+    phase = button ? beginphase(Phase_Buttons) : Phase_None;
     switch (floor) {
       case Bomb:
 	floorat(cr->pos) = Empty;
@@ -1351,6 +1354,8 @@ static int endmovement(creature *cr)
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
     }
+    if (button)
+	endphase(phase);
 
     return survived;
 }
@@ -1790,16 +1795,30 @@ static int initgame(gamelogic *logic)
     return !ismarkedinvalid();
 }
 
+/* Prepare a copy of the game state that was saved immediately after a
+ * call to initgame() to be played again. Only the values carried over
+ * from the previous game need to be refreshed.
+ */
+static int restoregame(gamelogic *logic)
+{
+    setstate(logic);
+    rndslidedir() = lastrndslidedir;
+    stepping() = laststepping;
+    return !ismarkedinvalid();
+}
+
 /* Advance the game state by one tick.
  */
 static int advancegame(gamelogic *logic)
 {
     creature   *cr;
+    int		phase, n;
 
     setstate(logic);
 
     initialhousekeeping();
 
+    phase = beginphase(Phase_Moves);
     for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
 	setfdir(cr, NIL);
 	cr->tdir = NIL;
@@ -1814,13 +1833,17 @@ static int advancegame(gamelogic *logic)
 	if (cr->moving <= 0)
 	    choosemove(cr);
     }
+    endphase(phase);
 
+    phase = beginphase(Phase_Chip);
     cr = getchip();
     if (getfdir(cr) == NIL && cr->tdir == NIL)
 	couldntmove() = FALSE;
     else
 	checkmovingto();
+    endphase(phase);
 
+    phase = beginphase(Phase_Moves);
     for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
 	if (cr->hidden)
 	    continue;
@@ -1828,8 +1851,11 @@ static int advancegame(gamelogic *logic)
 	    continue;
 	cr->tdir = NIL;
 	setfdir(cr, NIL);
-	if (floorat(cr->pos) == Button_Brown && cr->moving <= 0)
+	if (floorat(cr->pos) == Button_Brown && cr->moving <= 0) {
+	    n = beginphase(Phase_Buttons);
 	    springtrap(trapfrombutton(cr->pos));
+	    endphase(n);
+	}
     }
 
     for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
@@ -1840,6 +1866,7 @@ static int advancegame(gamelogic *logic)
 	if (floorat(cr->pos) == Teleport)
 	    teleportcreature(cr);
     }
+    endphase(phase);
 
     finalhousekeeping();
 
@@ -1884,6 +1911,7 @@ gamelogic *lynxlogicstartup(void)
     logic.ruleset = Ruleset_Lynx;
     logic.localstateinfosize = sizeof(struct lxstate);
     logic.initgame = initgame;
+    logic.restoregame = restoregame;
     logic.advancegame = advancegame;
     logic.endgame = endgame;
     logic.shutdown = shutdown;
@@ -11,6 +11,7 @@
 #include	"state.h"
 #include	"random.h"
 #include	"logic.h"
+#include	"telemetry.h"
 
 #ifdef NDEBUG
 #define	_assert(test)	((void)0)
@@ -1425,8 +1426,9 @@ static void resetbuttons(void)
  */
 static void handlebuttons(void)
 {
-    int	pos, id;
+    int	pos, id, phase;
 
+    phase = beginphase(Phase_Buttons);
     for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
 	if (cellat(pos)->top.state & FS_BUTTONDOWN) {
 	    cellat(pos)->top.state &= ~FS_BUTTONDOWN;
@@ -1458,6 +1460,7 @@ static void handlebuttons(void)
 	    break;
 	}
     }
+    endphase(phase);
 }
 
 /*
@@ -1509,7 +1512,7 @@ static void endmovement(creature *cr, int dir)
     int		dead = FALSE;
     int		wasslipping;
     int		oldpos, newpos;
-    int		id, floor, i;
+    int		id, floor, i, button, phase;
 
     oldpos = cr->pos;
     newpos = cr->pos + delta[dir];
@@ -1671,6 +1674,8 @@ static void endmovement(creature *cr, int dir)
     cr->pos = oldpos;
 
     tile = &cell->bot;
+    button = floor >= Button_Blue && floor <= Button_Brown;
+    phase = button ? beginphase(Phase_Buttons) : Phase_None;
     switch (floor) {
       case Button_Blue:
 	if (cr->state & CS_DEFERPUSH)
@@ -1700,6 +1705,8 @@ static void endmovement(creature *cr, int dir)
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
     }
+    if (button)
+	endphase(phase);
 
     cr->pos = newpos;
 
@@ -2162,7 +2169,7 @@ static int advancegame(gamelogic *logic)
 {
     creature   *cr;
     int		r = 0;
-    int		n;
+    int		n, phase;
 
     setstate(logic);
 
@@ -2171,6 +2178,7 @@ static int advancegame(gamelogic *logic)
 
     if (currenttime() && !(currenttime() & 1)) {
 	controllerdir() = NIL;
+	phase = beginphase(Phase_Moves);
 	for (n = 0 ; n < creaturecount ; ++n) {
 	    cr = creatures[n];
 	    if (cr->hidden || (cr->state & CS_CLONING) || cr->id == Chip)
@@ -2179,16 +2187,21 @@ static int advancegame(gamelogic *logic)
 	    if (cr->tdir != NIL)
 		advancecreature(cr, cr->tdir);
 	}
+	endphase(phase);
 	if ((r = checkforending()))
 	    goto done;
     }
 
     if (currenttime() && !(currenttime() & 1)) {
+	phase = beginphase(Phase_Floor);
 	floormovements();
+	endphase(phase);
 	if ((r = checkforending()))
 	    goto done;
     }
+    phase = beginphase(Phase_Slips);
     updatesliplist();
+    endphase(phase);
 
     timeoffset() = 0;
     if (timelimit()) {
@@ -2201,15 +2214,22 @@ static int advancegame(gamelogic *logic)
 	    addsoundeffect(SND_TIME_LOW);
     }
 
+    phase = beginphase(Phase_Chip);
     cr = getchip();
     choosemove(cr);
     if (cr->tdir != NIL) {
-	if (advancecreature(cr, cr->tdir))
+	n = advancecreature(cr, cr->tdir);
+	endphase(phase);
+	if (n)
 	    if ((r = checkforending()))
 		goto done;
 	cr->state |= CS_HASMOVED;
+    } else {
+	endphase(phase);
     }
+    phase = beginphase(Phase_Slips);
     updatesliplist();
+    endphase(phase);
     createclones();
 
   done:
@@ -2262,6 +2282,7 @@ gamelogic *mslogicstartup(void)
     logic.ruleset = Ruleset_MS;
     logic.localstateinfosize = sizeof(struct msstate);
     logic.initgame = initgame;
+    logic.restoregame = NULL;
     logic.advancegame = advancegame;
     logic.endgame = endgame;
     logic.shutdown = shutdown;
@@ -53,6 +53,7 @@ typedef	struct oshwglobals
     short		wtile;		/* width of one tile in pixels */
     short		htile;		/* height of one tile in pixels */
     short		cptile;		/* size of one tile in pixels */
+    short		scale;		/* the display's scaling factor */
     fontcolors		textclr;	/* color triplet for normal text */
     fontcolors		dimtextclr;	/* color triplet for dim text */
     fontcolors		hilightclr;	/* color triplet for bold text */
@@ -89,15 +90,20 @@ typedef	struct oshwglobals
 
     /* Return a pointer to an image of a cell with the two given
      * tiles. If the top image is transparent, the composite image is
-     * created using the overlay buffer. (Thus the caller should be
-     * done using the image returned before calling this function
-     * again.) timerval should hold the time of the game, for
-     * rendering animated cell tiles, or -1 if the game has not
-     * started.
+     * taken from a cache of composed cells, and can be replaced by a
+     * later call. (Thus the caller should be done using the image
+     * returned before calling this function again.) timerval should
+     * hold the time of the game, for rendering animated cell tiles,
+     * or -1 if the game has not started.
      */
     SDL_Surface* (*getcellimagefunc)(SDL_Rect *rect,
 				     int top, int bot, int timerval);
 
+    /* Return TRUE if the image of the given cell tile changes with the
+     * time of the game, i.e. if it is animated.
+     */
+    int (*iscellanimatedfunc)(int id);
+
     /* Return a pointer to a tile image for the given creature or
      * animation sequence with the specified direction, sub-position,
      * and animation frame.
@@ -125,8 +131,9 @@ typedef	struct oshwglobals
      * for each column of the table. The rectangles y-coordinates and
      * heights are taken from area, and the x-coordinates and widths
      * are calculated so as to best render the columns of the table in
-     * the given space. The caller has the responsibility of freeing
-     * the returned array.
+     * the given space. (If the table produces its rows on demand and
+     * has many of them, only a sample of the rows is measured.) The
+     * caller has the responsibility of freeing the returned array.
      */
     SDL_Rect *(*measuretablefunc)(SDL_Rect const *area,
 				  tablespec const *table);
@@ -134,9 +141,9 @@ typedef	struct oshwglobals
     /* Draw a single row of the given table. cols is an array of
      * rectangles, one for each column. Each rectangle is altered by
      * the function as per puttext's PT_UPDATERECT behavior. row
-     * points to an integer indicating the first table entry of the
-     * row to display; upon return, this value is updated to point to
-     * the first entry following the row. flags can be set to PT_DIM
+     * points to an integer indicating the position of the row to
+     * display (see tablespec); upon return, this value is updated to
+     * the position of the following row. flags can be set to PT_DIM
      * and/or PT_HIGHLIGHT; the values will be applied to every entry
      * in the row.
      */
@@ -162,6 +169,39 @@ extern oshwglobals sdlg;
 #define	scrollmove		(*sdlg.scrollmovefunc)
 #define	getcreatureimage	(*sdlg.getcreatureimagefunc)
 #define	getcellimage		(*sdlg.getcellimagefunc)
+#define	iscellanimated		(*sdlg.iscellanimatedfunc)
+
+/* Compute a hash value and the size of the given file, which
+ * identify the file that some cached data was derived from. FALSE is
+ * returned if the file cannot be read.
+ */
+extern int _sdlhashfile(char const *filename, Uint32 *hash, Uint32 *size);
+
+/* Return the current time in microseconds. Only the difference
+ * between two return values is meaningful.
+ */
+extern unsigned long _sdlgetmicroseconds(void);
+
+/* The number of steps into which a tick is divided when drawing
+ * frames in between ticks, and the current step.
+ */
+#define	TICK_PHASES	256
+extern int _sdltickphase(void);
+
+/* Add the contents of the given surface to the video being written,
+ * if there is one.
+ */
+extern void _sdlvideoframe(SDL_Surface *surface);
+
+/* Convert count pixels in the given pixel format to 24-bit RGB.
+ */
+extern void _sdlpixelstorgb(Uint8 const *src, int count,
+			    SDL_PixelFormat *fmt, Uint8 *dest);
+
+/* Tell the input module that the game display has been updated, so
+ * that it can measure the latency of key presses.
+ */
+extern void _sdlinputdisplayed(void);
 
 /* The initialization functions for the various modules.
  */
@@ -169,8 +209,8 @@ extern int _sdltimerinitialize(int showhistogram);
 extern int _sdlresourceinitialize(void);
 extern int _sdltextinitialize(void);
 extern int _sdltileinitialize(void);
-extern int _sdlinputinitialize(void);
-extern int _sdloutputinitialize(int fullscreen);
+extern int _sdlinputinitialize(int showlatency);
+extern int _sdloutputinitialize(int fullscreen, int scale);
 extern int _sdlsfxinitialize(int silence, int soundbufsize);
 
 #endif
@@ -4,6 +4,8 @@
  * License. No warranty. See COPYING for details.
  */
 
+#include	<stdio.h>
+#include	<stdlib.h>
 #include	<string.h>
 #include	"SDL.h"
 #include	"sdlgen.h"
@@ -20,6 +22,15 @@ typedef	struct keycmdmap {
     int		hold;		/* TRUE for repeating joystick-mode keys */
 } keycmdmap;
 
+/* Structure describing a key event waiting to be applied to the key
+ * states.
+ */
+typedef	struct keyevent {
+    unsigned long	when;		/* the time of the event */
+    short		scancode;	/* the key's scan code */
+    short		down;		/* TRUE if the key was pressed */
+} keyevent;
+
 /* Structure describing mouse activity.
  */
 typedef struct mouseaction {
@@ -50,6 +61,24 @@ static char		keystates[SDLK_LAST];
  */
 static mouseaction	mouseinfo;
 
+/* The key events that have been received but not yet applied to the
+ * key states, in order of arrival.
+ */
+#define	KEYQUEUESIZE	64
+static keyevent		keyqueue[KEYQUEUESIZE];
+static int		keyqueuehead = 0;
+static int		keyqueuetail = 0;
+
+/* The time of the earliest key press applied since the game display
+ * was last updated, or zero if there has been none, and a histogram
+ * in milliseconds of the time between a key press and the next
+ * update of the game display.
+ */
+static int		showlatency = FALSE;
+static unsigned long	pendingpress = 0;
+static unsigned		latencyhist[500];
+static unsigned long	maxlatency = 0;
+
 /* TRUE if direction keys are to be treated as always repeating.
  */
 static int		joystickstyle = FALSE;
@@ -93,6 +122,10 @@ static keycmdmap const gamekeycmds[] = {
     { 's',			  0, +1,  0,   CmdSeeSolutionFiles,   FALSE },
     { 'v',                       +1,  0,  0,   CmdVolumeUp,           FALSE },
     { 'v',                        0,  0,  0,   CmdVolumeDown,         FALSE },
+    { '=',                       -1,  0,  0,   CmdFaster,             FALSE },
+    { SDLK_KP_PLUS,              -1, -1,  0,   CmdFaster,             FALSE },
+    { '-',                        0,  0,  0,   CmdSlower,             FALSE },
+    { SDLK_KP_MINUS,             -1, -1,  0,   CmdSlower,             FALSE },
     { SDLK_RETURN,               -1, -1,  0,   CmdProceed,            FALSE },
     { SDLK_KP_ENTER,             -1, -1,  0,   CmdProceed,            FALSE },
     { ' ',                       -1, -1,  0,   CmdProceed,            FALSE },
@@ -166,14 +199,9 @@ static int mergeable[CmdKeyMoveLast + 1];
  * Running the keyboard's state machine.
  */
 
-/* This callback is called whenever the state of any keyboard key
- * changes. It records this change in the keystates array. The key can
- * be recorded as being struck, pressed, repeating, held down, or down
- * but ignored, as appropriate to when they were first pressed and the
- * current behavior settings. Shift-type keys are always either on or
- * off.
+/* Return TRUE if the key is a shift-type key.
  */
-static void _keyeventcallback(int scancode, int down)
+static int isshiftkey(int scancode)
 {
     switch (scancode) {
       case SDLK_LSHIFT:
@@ -187,22 +215,88 @@ static void _keyeventcallback(int scancode, int down)
       case SDLK_NUMLOCK:
       case SDLK_CAPSLOCK:
       case SDLK_MODE:
+	return TRUE;
+    }
+    return FALSE;
+}
+
+/* Record a change in the state of a keyboard key in the keystates
+ * array. The key can be recorded as being struck, pressed, repeating,
+ * held down, or down but ignored, as appropriate to when they were
+ * first pressed and the current behavior settings. Shift-type keys
+ * are always either on or off.
+ */
+static void applykeyevent(int scancode, int down)
+{
+    if (isshiftkey(scancode)) {
 	keystates[scancode] = down ? KS_ON : KS_OFF;
-	break;
-      default:
-	if (scancode < SDLK_LAST) {
-	    if (down) {
-		keystates[scancode] = keystates[scancode] == KS_OFF ?
+    } else if (scancode < SDLK_LAST) {
+	if (down) {
+	    keystates[scancode] = keystates[scancode] == KS_OFF ?
 						KS_PRESSED : KS_REPEATING;
-	    } else {
-		keystates[scancode] = keystates[scancode] == KS_PRESSED ?
+	} else {
+	    keystates[scancode] = keystates[scancode] == KS_PRESSED ?
 						KS_STRUCK : KS_OFF;
-	    }
 	}
-	break;
     }
 }
 
+/* This callback is called whenever the state of any keyboard key
+ * changes. The change is stamped with the current time and added to
+ * the queue, to be applied at the next polling cycle. (The timer
+ * collects events while it waits for a tick, so the time is accurate
+ * to within a few milliseconds.) If the queue is full, the oldest
+ * event is applied right away.
+ */
+static void _keyeventcallback(int scancode, int down)
+{
+    keyevent   *ev;
+    int		next;
+
+    next = (keyqueuehead + 1) % KEYQUEUESIZE;
+    if (next == keyqueuetail) {
+	ev = keyqueue + keyqueuetail;
+	applykeyevent(ev->scancode, ev->down);
+	keyqueuetail = (keyqueuetail + 1) % KEYQUEUESIZE;
+    }
+    ev = keyqueue + keyqueuehead;
+    ev->when = _sdlgetmicroseconds();
+    ev->scancode = scancode;
+    ev->down = down;
+    keyqueuehead = next;
+}
+
+/* Apply the queued key events to the key states. If onetap is TRUE,
+ * a key that is pressed and released before the polling cycle is
+ * given the cycle to itself: once a key has been struck, any later
+ * key presses are left in the queue for the next cycle, instead of
+ * being lost among the keys of this one. The return value is the time
+ * of the earliest key press that was applied, or zero if there was
+ * none.
+ */
+static unsigned long applykeyevents(int onetap)
+{
+    keyevent	       *ev;
+    unsigned long	when = 0;
+    int			struck = FALSE;
+
+    while (keyqueuetail != keyqueuehead) {
+	ev = keyqueue + keyqueuetail;
+	if (ev->down && !isshiftkey(ev->scancode)) {
+	    if (onetap && struck)
+		break;
+	    if (!when)
+		when = ev->when;
+	}
+	applykeyevent(ev->scancode, ev->down);
+	if (ev->scancode < SDLK_LAST
+			&& keystates[ev->scancode] == KS_STRUCK)
+	    struck = TRUE;
+	keyqueuetail = (keyqueuetail + 1) % KEYQUEUESIZE;
+    }
+    return when;
+}
+
 /* Initialize (or re-initialize) all key states.
  */
 static void restartkeystates(void)
@@ -211,12 +305,13 @@ static void restartkeystates(void)
     int		count, n;
 
     memset(keystates, KS_OFF, sizeof keystates);
+    keyqueuehead = keyqueuetail = 0;
     keyboard = SDL_GetKeyState(&count);
     if (count > SDLK_LAST)
 	count = SDLK_LAST;
     for (n = 0 ; n < count ; ++n)
 	if (keyboard[n])
-	    _keyeventcallback(n, TRUE);
+	    applykeyevent(n, TRUE);
 }
 
 /* Update the key states. This is done at the start of each polling
@@ -326,9 +421,11 @@ int anykey(void)
 
     resetkeystates();
     eventupdate(FALSE);
+    applykeyevents(FALSE);
     for (;;) {
 	resetkeystates();
 	eventupdate(TRUE);
+	applykeyevents(FALSE);
 	for (n = 0 ; n < SDLK_LAST ; ++n)
 	    if (keystates[n] == KS_STRUCK || keystates[n] == KS_PRESSED
 					  || keystates[n] == KS_REPEATING)
@@ -342,17 +439,22 @@ int anykey(void)
  * mode, the function can return CmdPreserve, indicating that if the key
  * command from the previous poll has not been processed, it should still
  * be considered active. If two mergeable keys are selected, the return
- * value will be the bitwise-or of their command values.
+ * value will be the bitwise-or of their command values. Keys that are
+ * tapped in quick succession are returned by successive polls.
  */
 int input(int wait)
 {
     keycmdmap const    *kc;
+    unsigned long	when;
     int			lingerflag = FALSE;
     int			cmd1, cmd, n;
 
     for (;;) {
 	resetkeystates();
-	eventupdate(wait);
+	eventupdate(wait && keyqueuehead == keyqueuetail);
+	when = applykeyevents(TRUE);
+	if (!wait && !pendingpress)
+	    pendingpress = when;
 
 	cmd1 = cmd = 0;
 	for (kc = keycmds ; kc->scancode ; ++kc) {
@@ -437,10 +539,62 @@ int setkeyboardinputmode(int enable)
     return TRUE;
 }
 
-/* Initialization.
+/* Note that the game display has been updated. If a key was pressed
+ * since the last update, the time between the two is recorded.
+ */
+void _sdlinputdisplayed(void)
+{
+    unsigned long	ms;
+
+    if (!pendingpress)
+	return;
+    if (showlatency) {
+	ms = (_sdlgetmicroseconds() - pendingpress) / 1000;
+	if (ms < sizeof latencyhist / sizeof *latencyhist) {
+	    ++latencyhist[ms];
+	    if (ms > maxlatency)
+		maxlatency = ms;
+	}
+    }
+    pendingpress = 0;
+}
+
+/* At shutdown time, display the percentiles of the latency histogram
+ * on stdout.
+ */
+static void shutdown(void)
+{
+    static int const	percentiles[] = { 50, 90, 99 };
+    unsigned long	total, n;
+    int			i, j;
+
+    total = 0;
+    for (i = 0 ; i < (int)(sizeof latencyhist / sizeof *latencyhist) ; ++i)
+	total += latencyhist[i];
+    if (!total)
+	return;
+    printf("Latency from key press to display (ms), %lu presses\n", total);
+    n = 0;
+    j = 0;
+    for (i = 0 ; i < (int)(sizeof latencyhist / sizeof *latencyhist) ; ++i) {
+	n += latencyhist[i];
+	for ( ; j < (int)(sizeof percentiles / sizeof *percentiles) ; ++j) {
+	    if (n * 100 < total * percentiles[j])
+		break;
+	    printf("%3d%%: %d\n", percentiles[j], i);
+	}
+    }
+    printf(" max: %lu\n", maxlatency);
+}
+
+/* Initialization. If _showlatency is TRUE, the latency of key presses
+ * is measured, and reported at shutdown.
  */
-int _sdlinputinitialize(void)
+int _sdlinputinitialize(int _showlatency)
 {
+    showlatency = _showlatency;
+    if (showlatency)
+	atexit(shutdown);
     sdlg.keyeventcallbackfunc = _keyeventcallback;
     sdlg.mouseeventcallbackfunc = _mouseeventcallback;
 
@@ -466,10 +620,12 @@ tablespec const *keyboardhelp(int which)
 	"1-Ctrl-N", "1-jump to the next level",
 	"1-V", "1-decrease volume",
 	"1-Shift-V", "1-increase volume",
+	"1-+ -", "1-change the speed of a playback",
 	"1-Ctrl-C", "1-exit the program",
 	"1-Alt-F4", "1-exit the program"
     };
-    static tablespec const keyhelp_ingame = { 11, 2, 4, 1, ingame_items };
+    static tablespec const keyhelp_ingame = { 12, 2, 4, 1,
+					      ingame_items, NULL, NULL };
 
     static char *twixtgame_items[] = {
 	"1-P", "1-jump to the previous level",
@@ -492,7 +648,7 @@ tablespec const *keyboardhelp(int which)
 	"1-Alt-F4", "1-exit the program"
     };
     static tablespec const keyhelp_twixtgame = { 18, 2, 2, 1,
-						 twixtgame_items };
+						 twixtgame_items, NULL, NULL };
 
     static char *scorelist_items[] = {
 	"1-up down", "1-move selection",
@@ -503,7 +659,8 @@ tablespec const *keyboardhelp(int which)
 	"1-Ctrl-C", "1-exit the program",
 	"1-Alt-F4", "1-exit the program"
     };
-    static tablespec const keyhelp_scorelist = { 7, 2, 2, 1, scorelist_items };
+    static tablespec const keyhelp_scorelist = { 7, 2, 2, 1,
+						 scorelist_items, NULL, NULL };
 
     static char *scroll_items[] = {
 	"1-up down", "1-move selection",
@@ -513,7 +670,8 @@ tablespec const *keyboardhelp(int which)
 	"1-Ctrl-C", "1-exit the program",
 	"1-Alt-F4", "1-exit the program"
     };
-    static tablespec const keyhelp_scroll = { 6, 2, 2, 1, scroll_items };
+    static tablespec const keyhelp_scroll = { 6, 2, 2, 1,
+					      scroll_items, NULL, NULL };
 
     switch (which) {
       case KEYHELP_INGAME:	return &keyhelp_ingame;
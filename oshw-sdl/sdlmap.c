@@ -0,0 +1,392 @@
+/* sdlmap.c: Writing images of entire level maps.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"SDL.h"
+#include	"sdlgen.h"
+#include	"../err.h"
+#include	"../state.h"
+
+/* The size of one map cell in the images, in pixels.
+ */
+#define	MAPIMAGECELL	8
+
+/* The number of threads that reduce and write the images, and the
+ * number of maps that can be held for them at once.
+ */
+#define	MAPTHREADS	4
+#define	MAPSLOTS	(MAPTHREADS + 2)
+
+/* The states of a slot.
+ */
+enum { Slot_Free, Slot_Ready, Slot_Busy };
+
+/* A map that has been drawn and is waiting to be written, or is being
+ * written.
+ */
+typedef	struct mapslot {
+    SDL_Surface	       *map;		/* the entire map at full size */
+    char	       *filename;	/* where to write the image */
+    int			status;		/* free, ready, or being written */
+} mapslot;
+
+/* The slots holding the maps. The slots are shared with the writing
+ * threads, and slotlock protects them. slotready is signalled when a
+ * map is ready to be written, and slotdone when a slot is freed.
+ */
+static mapslot		slots[MAPSLOTS];
+static SDL_mutex       *slotlock = NULL;
+static SDL_cond	       *slotready = NULL;
+static SDL_cond	       *slotdone = NULL;
+static SDL_Thread      *threads[MAPTHREADS];
+static int		threadcount = 0;
+static int		started = FALSE;
+static int		finishing = FALSE;
+
+/* TRUE if any of the images could not be written.
+ */
+static int		writeerror = FALSE;
+
+/*
+ * Drawing, reducing, and writing maps.
+ */
+
+/* Draw the entire map of the given game state, with its creatures, at
+ * full size.
+ */
+static void drawmap(gamestate const *state, SDL_Surface *dest)
+{
+    SDL_Rect		rect;
+    SDL_Surface	       *s;
+    creature const     *cr;
+    int			pos;
+
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	rect.x = (pos % CXGRID) * sdlg.wtile;
+	rect.y = (pos / CXGRID) * sdlg.htile;
+	s = getcellimage(&rect, state->map[pos].top.id,
+			 state->map[pos].bot.id, -1);
+	SDL_BlitSurface(s, NULL, dest, &rect);
+    }
+    for (cr = state->creatures ; cr->id ; ++cr) {
+	if (cr->hidden)
+	    continue;
+	rect.x = (cr->pos % CXGRID) * sdlg.wtile;
+	rect.y = (cr->pos / CXGRID) * sdlg.htile;
+	s = getcreatureimage(&rect, cr->id, cr->dir, cr->moving, cr->frame);
+	SDL_BlitSurface(s, NULL, dest, &rect);
+    }
+}
+
+/* Add up the pixels of one row of a map with four bytes per pixel
+ * and eight bits per color channel. Two channels are added at once:
+ * lo holds the sums of the first and third bytes of the pixels
+ * covered by each pixel of the image, and hi the second and fourth.
+ */
+static void addpixels32(Uint32 const *src, int const *xfrom, int const *xto,
+			Uint32 *lo, Uint32 *hi)
+{
+    Uint32	pixel;
+    int		x, sx;
+
+    for (x = 0 ; x < CXGRID * MAPIMAGECELL ; ++x) {
+	for (sx = xfrom[x] ; sx < xto[x] ; ++sx) {
+	    pixel = src[sx];
+	    lo[x] += pixel & 0x00FF00FF;
+	    hi[x] += (pixel >> 8) & 0x00FF00FF;
+	}
+    }
+}
+
+/* Return the sum of the color channel at the given shift out of the
+ * sums made by addpixels32().
+ */
+static int channelsum(Uint32 lo, Uint32 hi, int shift)
+{
+    return (((shift & 8) ? hi : lo) >> (shift & 16)) & 0xFFFF;
+}
+
+/* Reduce a map to an image with MAPIMAGECELL pixels to a cell, in
+ * 24-bit RGB. Each pixel of the image is the average color of the
+ * pixels of the map that it covers. Maps with 32-bit pixels, which
+ * are the usual case, are added up without converting each pixel.
+ */
+static void reducemap(SDL_Surface *map, Uint8 *dest)
+{
+    SDL_PixelFormat    *fmt = map->format;
+    Uint8	       *src;
+    Uint8	       *row;
+    Uint32		lo[CXGRID * MAPIMAGECELL];
+    Uint32		hi[CXGRID * MAPIMAGECELL];
+    unsigned long	sums[CXGRID * MAPIMAGECELL * 3];
+    int			xfrom[CXGRID * MAPIMAGECELL];
+    int			xto[CXGRID * MAPIMAGECELL];
+    int			w, h, y0, y1, fast;
+    int			x, y, sx, sy, n;
+
+    w = CXGRID * MAPIMAGECELL;
+    h = CYGRID * MAPIMAGECELL;
+    for (x = 0 ; x < w ; ++x) {
+	xfrom[x] = x * map->w / w;
+	xto[x] = (x + 1) * map->w / w;
+	if (xto[x] <= xfrom[x])
+	    xto[x] = xfrom[x] + 1;
+    }
+    fast = fmt->BytesPerPixel == 4
+		&& !fmt->Rloss && !fmt->Gloss && !fmt->Bloss
+		&& (map->w / w + 1) * (map->h / h + 1) <= 256;
+    if (!(row = malloc(map->w * 3)))
+	memerrexit();
+
+    for (y = 0 ; y < h ; ++y) {
+	y0 = y * map->h / h;
+	y1 = (y + 1) * map->h / h;
+	if (y1 <= y0)
+	    y1 = y0 + 1;
+	src = (Uint8*)map->pixels + y0 * map->pitch;
+	if (fast) {
+	    memset(lo, 0, sizeof lo);
+	    memset(hi, 0, sizeof hi);
+	    for (sy = y0 ; sy < y1 ; ++sy, src += map->pitch)
+		addpixels32((Uint32 const*)src, xfrom, xto, lo, hi);
+	    for (x = 0 ; x < w ; ++x) {
+		n = (y1 - y0) * (xto[x] - xfrom[x]);
+		*dest++ = (channelsum(lo[x], hi[x], fmt->Rshift) + n / 2) / n;
+		*dest++ = (channelsum(lo[x], hi[x], fmt->Gshift) + n / 2) / n;
+		*dest++ = (channelsum(lo[x], hi[x], fmt->Bshift) + n / 2) / n;
+	    }
+	    continue;
+	}
+
+	memset(sums, 0, sizeof sums);
+	for (sy = y0 ; sy < y1 ; ++sy, src += map->pitch) {
+	    _sdlpixelstorgb(src, map->w, fmt, row);
+	    for (x = 0 ; x < w ; ++x) {
+		for (sx = xfrom[x] ; sx < xto[x] ; ++sx) {
+		    sums[x * 3] += row[sx * 3];
+		    sums[x * 3 + 1] += row[sx * 3 + 1];
+		    sums[x * 3 + 2] += row[sx * 3 + 2];
+		}
+	    }
+	}
+	for (x = 0 ; x < w ; ++x) {
+	    n = (y1 - y0) * (xto[x] - xfrom[x]);
+	    *dest++ = (sums[x * 3] + n / 2) / n;
+	    *dest++ = (sums[x * 3 + 1] + n / 2) / n;
+	    *dest++ = (sums[x * 3 + 2] + n / 2) / n;
+	}
+    }
+
+    free(row);
+}
+
+/* Reduce the map in the given slot and write it to its file as a PPM
+ * image.
+ */
+static int writemapfile(mapslot const *slot)
+{
+    FILE       *fp;
+    Uint8      *image;
+    int		w, h, f;
+
+    w = CXGRID * MAPIMAGECELL;
+    h = CYGRID * MAPIMAGECELL;
+    if (!(image = malloc(w * h * 3)))
+	memerrexit();
+    reducemap(slot->map, image);
+
+    if (!(fp = fopen(slot->filename, "wb"))) {
+	errmsg(slot->filename, "cannot open for writing");
+	free(image);
+	return FALSE;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", w, h);
+    fwrite(image, w * h * 3, 1, fp);
+    f = !ferror(fp);
+    if (fclose(fp))
+	f = FALSE;
+    if (!f)
+	errmsg(slot->filename, "write error");
+    free(image);
+    return f;
+}
+
+/* The body of a writing thread. Maps are taken from the slots that
+ * are ready and written until none are left and the images are
+ * finished.
+ */
+static int mapthreadbody(void *data)
+{
+    mapslot    *slot;
+    int		n, f;
+
+    (void)data;
+    SDL_LockMutex(slotlock);
+    for (;;) {
+	for (n = 0 ; n < MAPSLOTS ; ++n)
+	    if (slots[n].status == Slot_Ready)
+		break;
+	if (n == MAPSLOTS) {
+	    if (finishing)
+		break;
+	    SDL_CondWait(slotready, slotlock);
+	    continue;
+	}
+	slot = slots + n;
+	slot->status = Slot_Busy;
+	SDL_UnlockMutex(slotlock);
+	f = writemapfile(slot);
+	SDL_LockMutex(slotlock);
+	if (!f)
+	    writeerror = TRUE;
+	slot->status = Slot_Free;
+	SDL_CondSignal(slotdone);
+    }
+    SDL_UnlockMutex(slotlock);
+    return 0;
+}
+
+/* Start the writing threads. If none can be created, the images are
+ * written as they are drawn.
+ */
+static void startmapthreads(void)
+{
+    started = TRUE;
+    slotlock = SDL_CreateMutex();
+    slotready = SDL_CreateCond();
+    slotdone = SDL_CreateCond();
+    if (!slotlock || !slotready || !slotdone) {
+	warn("couldn't create map image threads: %s", SDL_GetError());
+	return;
+    }
+    for (threadcount = 0 ; threadcount < MAPTHREADS ; ++threadcount)
+	if (!(threads[threadcount] = SDL_CreateThread(mapthreadbody, NULL)))
+	    break;
+    if (!threadcount)
+	warn("couldn't create map image threads: %s", SDL_GetError());
+}
+
+/* Return a slot to draw a map in, waiting for one to be freed if they
+ * are all in use.
+ */
+static mapslot *getfreeslot(void)
+{
+    int	n;
+
+    if (!threadcount)
+	return slots;
+    SDL_LockMutex(slotlock);
+    for (;;) {
+	for (n = 0 ; n < MAPSLOTS ; ++n)
+	    if (slots[n].status == Slot_Free)
+		break;
+	if (n < MAPSLOTS)
+	    break;
+	SDL_CondWait(slotdone, slotlock);
+    }
+    SDL_UnlockMutex(slotlock);
+    return slots + n;
+}
+
+/*
+ * Exported functions.
+ */
+
+/* Write images of level maps instead of showing the display.
+ */
+int setmapimageexport(void)
+{
+    SDL_putenv("SDL_VIDEODRIVER=dummy");
+    return TRUE;
+}
+
+/* Draw the map of the given game state and pass it on to the writing
+ * threads.
+ */
+int writemapimage(void const *state, char const *filename)
+{
+    mapslot	       *slot;
+    SDL_Surface	       *screen;
+
+    if (!started)
+	startmapthreads();
+    slot = getfreeslot();
+
+    if (!slot->map) {
+	screen = sdlg.screen;
+	slot->map = SDL_CreateRGBSurface(SDL_SWSURFACE,
+					 CXGRID * sdlg.wtile,
+					 CYGRID * sdlg.htile,
+					 screen->format->BitsPerPixel,
+					 screen->format->Rmask,
+					 screen->format->Gmask,
+					 screen->format->Bmask,
+					 screen->format->Amask);
+	if (!slot->map)
+	    die("couldn't create surface: %s", SDL_GetError());
+	if (screen->format->palette)
+	    SDL_SetColors(slot->map, screen->format->palette->colors,
+			  0, screen->format->palette->ncolors);
+    }
+    free(slot->filename);
+    if (!(slot->filename = malloc(strlen(filename) + 1)))
+	memerrexit();
+    strcpy(slot->filename, filename);
+    drawmap(state, slot->map);
+
+    if (!threadcount) {
+	if (!writemapfile(slot))
+	    writeerror = TRUE;
+	return !writeerror;
+    }
+    SDL_LockMutex(slotlock);
+    slot->status = Slot_Ready;
+    SDL_CondSignal(slotready);
+    SDL_UnlockMutex(slotlock);
+    return TRUE;
+}
+
+/* Wait for the remaining images to be written, and free the slots.
+ */
+int finishmapimages(void)
+{
+    int	f, n;
+
+    if (threadcount) {
+	SDL_LockMutex(slotlock);
+	finishing = TRUE;
+	SDL_CondBroadcast(slotready);
+	SDL_UnlockMutex(slotlock);
+	for (n = 0 ; n < threadcount ; ++n)
+	    SDL_WaitThread(threads[n], NULL);
+	threadcount = 0;
+    }
+    if (slotlock)
+	SDL_DestroyMutex(slotlock);
+    if (slotready)
+	SDL_DestroyCond(slotready);
+    if (slotdone)
+	SDL_DestroyCond(slotdone);
+    slotlock = NULL;
+    slotready = slotdone = NULL;
+
+    for (n = 0 ; n < MAPSLOTS ; ++n) {
+	if (slots[n].map)
+	    SDL_FreeSurface(slots[n].map);
+	free(slots[n].filename);
+	slots[n].map = NULL;
+	slots[n].filename = NULL;
+	slots[n].status = Slot_Free;
+    }
+
+    f = !writeerror;
+    started = FALSE;
+    finishing = FALSE;
+    writeerror = FALSE;
+    return f;
+}
@@ -64,7 +64,8 @@ static void _eventupdate(int wait)
 		SDL_ShowCursor(SDL_ENABLE);
 		mousevisible = TRUE;
 	    }
-	    mouseeventcallback(event.button.x, event.button.y,
+	    mouseeventcallback(event.button.x / sdlg.scale,
+			       event.button.y / sdlg.scale,
 			       event.button.button,
 			       event.type == SDL_MOUSEBUTTONDOWN);
 	    break;
@@ -106,6 +107,97 @@ void setsubtitle(char const *subtitle)
     SDL_WM_SetCaption(buf, "Tile World");
 }
 
+/* Compute a hash value and the size of the given file. FALSE is
+ * returned if the file cannot be read.
+ */
+int _sdlhashfile(char const *filename, Uint32 *hash, Uint32 *size)
+{
+    FILE	       *fp;
+    unsigned char	buf[8192];
+    Uint32		h, total;
+    size_t		n, i;
+
+    if (!(fp = fopen(filename, "rb")))
+	return FALSE;
+    h = 2166136261UL;
+    total = 0;
+    while ((n = fread(buf, 1, sizeof buf, fp)) > 0) {
+	for (i = 0 ; i < n ; ++i)
+	    h = (h ^ buf[i]) * 16777619UL;
+	total += n;
+    }
+    n = ferror(fp);
+    fclose(fp);
+    if (n)
+	return FALSE;
+    *hash = h;
+    *size = total;
+    return TRUE;
+}
+
+/* A function being run on a separate thread, or the value it
+ * returned if it could not be run on one.
+ */
+typedef	struct bgtask {
+    SDL_Thread	       *thread;		/* the thread, or NULL */
+    Uint32		threadid;	/* the thread's ID, once running */
+    int		      (*func)(void*);	/* the function to run */
+    void	       *data;		/* the function's argument */
+    int			result;		/* the function's return value */
+} bgtask;
+
+/* The entry point of a background task's thread. The thread's ID is
+ * recorded by the thread itself, so that it is already known if the
+ * function ends up calling exit().
+ */
+static int runbackgroundtask(void *data)
+{
+    bgtask     *task = data;
+
+    task->threadid = SDL_ThreadID();
+    return (*task->func)(task->data);
+}
+
+/* Start a background task.
+ */
+void *startbackgroundtask(int (*func)(void*), void *data)
+{
+    bgtask     *task;
+
+    if (!(task = malloc(sizeof *task)))
+	memerrexit();
+    task->threadid = 0;
+    task->func = func;
+    task->data = data;
+    task->thread = SDL_CreateThread(runbackgroundtask, task);
+    if (!task->thread)
+	task->result = (*func)(data);
+    return task;
+}
+
+/* Return TRUE if the caller is running on the task's thread.
+ */
+int onbackgroundtask(void const *task)
+{
+    bgtask const       *t = task;
+
+    return t->thread && t->threadid == SDL_ThreadID();
+}
+
+/* Wait for a background task to finish.
+ */
+int waitforbackgroundtask(void *task)
+{
+    bgtask     *t = task;
+    int		result;
+
+    if (t->thread)
+	SDL_WaitThread(t->thread, &t->result);
+    result = t->result;
+    free(t);
+    return result;
+}
+
 /* Shut down SDL.
  */
 static void shutdown(void)
@@ -117,7 +209,7 @@ static void shutdown(void)
  * the other modules of the library.
  */
 int oshwinitialize(int silence, int soundbufsize,
-		   int showhistogram, int fullscreen)
+		   int showhistogram, int fullscreen, int scale)
 {
     SDL_Surface	       *icon;
 
@@ -143,8 +235,8 @@ int oshwinitialize(int silence, int soundbufsize,
     return _sdltimerinitialize(showhistogram)
 	&& _sdltextinitialize()
 	&& _sdltileinitialize()
-	&& _sdlinputinitialize()
-	&& _sdloutputinitialize(fullscreen)
+	&& _sdlinputinitialize(showhistogram)
+	&& _sdloutputinitialize(fullscreen, scale)
 	&& _sdlsfxinitialize(silence, soundbufsize);
 }
 
@@ -12,6 +12,7 @@
 #include	"sdlgen.h"
 #include	"../err.h"
 #include	"../state.h"
+#include	"../telemetry.h"
 
 /* Space to leave between graphic objects.
  */
@@ -36,6 +37,14 @@
  */
 #define	gettileimage(id)	(getcellimage(NULL, (id), Empty, -1))
 
+/* Structure for holding a creature's position, in eighths of a tile.
+ */
+typedef	struct crposition {
+    short		id;		/* the creature, or zero if hidden */
+    short		x;		/* the horizontal position */
+    short		y;		/* the vertical position */
+} crposition;
+
 /* Structure for holding information about the message display.
  */
 typedef	struct msgdisplayinfo {
@@ -57,6 +66,12 @@ static SDL_Surface     *prompticons = NULL;
  */
 static int		fullscreen = FALSE;
 
+/* The surface of the actual display, when the display is scaled. In
+ * that case sdlg.screen is an offscreen surface at the unscaled size,
+ * and the areas of it that are updated are enlarged into this one.
+ */
+static SDL_Surface     *displaysurface = NULL;
+
 /* Coordinates specifying the placement of the various screen elements.
  */
 static int		screenw, screenh;
@@ -81,6 +96,61 @@ static int		fullredraw = TRUE;
  */
 static int		mapvieworigin = -1;
 
+/* An offscreen surface holding an image of the entire map, without
+ * the creatures. Cells are drawn into it as they come into view or
+ * change, and the map view is copied from it.
+ */
+static SDL_Surface     *mapsurface = NULL;
+
+/* What each cell of mapsurface shows, and whether a creature's image
+ * overlapped the cell on the display the last time the map view was
+ * drawn (CELL_COVERED) or is about to overlap it now (CELL_COVERING).
+ * A cell with drawn set to FALSE has not yet been drawn in mapsurface.
+ * An animated cell also remembers the time it was drawn for.
+ */
+static struct {
+    unsigned char	top;		/* the top tile drawn */
+    unsigned char	bot;		/* the bottom tile drawn */
+    unsigned char	covered;	/* CELL_* flags */
+    unsigned char	drawn;		/* TRUE if the cell has been drawn */
+    int			timer;		/* the time that was drawn */
+} drawnmap[CXGRID * CYGRID];
+
+#define	CELL_COVERED	0x01
+#define	CELL_COVERING	0x02
+
+/* The map view origin that the map view was last drawn with, in
+ * pixels. An origin of -1 forces the entire view to be copied to the
+ * display.
+ */
+static int		drawnorigin = -1;
+
+/* The areas of the map view that were changed by the last redraw.
+ */
+static SDL_Rect		dirtyrects[(NXTILES + 1) * (NYTILES + 1)];
+static int		dirtycount = 0;
+
+/* The positions of the creatures and of the view at the last tick
+ * that was displayed (now), and at the tick before it (then), which
+ * are used to draw frames in between ticks. The earlier positions are
+ * only kept when they belong to the tick immediately before.
+ * positionsgame and positionstime identify the last tick. moving is
+ * TRUE if anything moved by less than a tile from one tick to the
+ * next; larger moves are not drawn as a motion. drawnphase is the
+ * phase of the tick that the map view was last drawn at.
+ */
+static crposition	crnow[CXGRID * CYGRID];
+static crposition	crthen[CXGRID * CYGRID];
+static int		crnowcount = 0;
+static int		crthencount = 0;
+static int		xviewnow, yviewnow;
+static int		xviewthen, yviewthen;
+static int		havethen = FALSE;
+static void const      *positionsgame = NULL;
+static int		positionstime = -1;
+static int		moving = FALSE;
+static int		drawnphase = TICK_PHASES;
+
 /*
  * Display initialization functions.
  */
@@ -257,20 +327,222 @@ static int createdisplay(void)
 	SDL_FreeSurface(sdlg.screen);
 	sdlg.screen = NULL;
     }
+    if (mapsurface) {
+	SDL_FreeSurface(mapsurface);
+	mapsurface = NULL;
+    }
     flags = SDL_SWSURFACE | SDL_ANYFORMAT;
     if (fullscreen)
 	flags |= SDL_FULLSCREEN;
-    if (!(sdlg.screen = SDL_SetVideoMode(screenw, screenh, 32, flags))) {
+    displaysurface = SDL_SetVideoMode(screenw * sdlg.scale,
+				      screenh * sdlg.scale, 32, flags);
+    if (!displaysurface) {
 	errmsg(NULL, "cannot open %dx%d display: %s\n",
-		     screenw, screenh, SDL_GetError());
+		     screenw * sdlg.scale, screenh * sdlg.scale,
+		     SDL_GetError());
 	return FALSE;
     }
-    if (sdlg.screen->w != screenw || sdlg.screen->h != screenh)
+    if (displaysurface->w != screenw * sdlg.scale
+		|| displaysurface->h != screenh * sdlg.scale)
 	warn("requested a %dx%d display, got %dx%d instead",
-	     sdlg.screen->w, sdlg.screen->h);
+	     screenw * sdlg.scale, screenh * sdlg.scale,
+	     displaysurface->w, displaysurface->h);
+    if (sdlg.scale == 1) {
+	sdlg.screen = displaysurface;
+    } else {
+	sdlg.screen = SDL_CreateRGBSurface(SDL_SWSURFACE,
+				displaysurface->w / sdlg.scale,
+				displaysurface->h / sdlg.scale,
+				displaysurface->format->BitsPerPixel,
+				displaysurface->format->Rmask,
+				displaysurface->format->Gmask,
+				displaysurface->format->Bmask,
+				displaysurface->format->Amask);
+	if (!sdlg.screen)
+	    die("couldn't create surface: %s", SDL_GetError());
+	if (displaysurface->format->palette)
+	    SDL_SetColors(sdlg.screen, displaysurface->format->palette->colors,
+			  0, displaysurface->format->palette->ncolors);
+    }
+    drawnorigin = -1;
+    return TRUE;
+}
+
+/* The number of pixels that widenrow32() handles at a time. The
+ * inner loops have a constant length and a fixed stride, so that the
+ * compiler can turn them into vector instructions.
+ */
+#define	WIDENSTRIDE	4
+
+/* Copy count 32-bit pixels from src to dest, repeating each pixel n
+ * times. Each scaling factor has its own copy of the loop, so that n
+ * is a constant within it.
+ */
+static void widenrow32(Uint32 *dest, Uint32 const *src, int count, int n)
+{
+    Uint32	v[WIDENSTRIDE];
+    int		x, i, j;
+
+    x = 0;
+    switch (n) {
+      case 2:
+	for ( ; x + WIDENSTRIDE <= count ; x += WIDENSTRIDE) {
+	    for (j = 0 ; j < WIDENSTRIDE ; ++j)
+		v[j] = src[x + j];
+	    for (j = 0 ; j < WIDENSTRIDE ; ++j)
+		for (i = 0 ; i < 2 ; ++i)
+		    dest[(x + j) * 2 + i] = v[j];
+	}
+	break;
+      case 3:
+	for ( ; x + WIDENSTRIDE <= count ; x += WIDENSTRIDE) {
+	    for (j = 0 ; j < WIDENSTRIDE ; ++j)
+		v[j] = src[x + j];
+	    for (j = 0 ; j < WIDENSTRIDE ; ++j)
+		for (i = 0 ; i < 3 ; ++i)
+		    dest[(x + j) * 3 + i] = v[j];
+	}
+	break;
+      case 4:
+	for ( ; x + WIDENSTRIDE <= count ; x += WIDENSTRIDE) {
+	    for (j = 0 ; j < WIDENSTRIDE ; ++j)
+		v[j] = src[x + j];
+	    for (j = 0 ; j < WIDENSTRIDE ; ++j)
+		for (i = 0 ; i < 4 ; ++i)
+		    dest[(x + j) * 4 + i] = v[j];
+	}
+	break;
+    }
+    for ( ; x < count ; ++x)
+	for (i = 0 ; i < n ; ++i)
+	    dest[x * n + i] = src[x];
+}
+
+/* Copy the given area of sdlg.screen to the scaled display, with
+ * each pixel enlarged to a square of sdlg.scale pixels on a side. Each
+ * row is widened once and then duplicated. Both surfaces must be
+ * locked.
+ */
+static void scalerect(SDL_Rect const *rect)
+{
+    Uint8      *src;
+    Uint8      *dest;
+    Uint8      *d;
+    Uint32	p;
+    int		bpp, n, x, y, i;
+
+    bpp = sdlg.screen->format->BytesPerPixel;
+    n = sdlg.scale;
+    src = (Uint8*)sdlg.screen->pixels + rect->y * sdlg.screen->pitch
+				      + rect->x * bpp;
+    dest = (Uint8*)displaysurface->pixels
+			+ rect->y * n * displaysurface->pitch
+			+ rect->x * n * bpp;
+    for (y = 0 ; y < rect->h ; ++y) {
+	d = dest;
+	switch (bpp) {
+	  case 1:
+	    for (x = 0 ; x < rect->w ; ++x)
+		for (i = 0, p = src[x] ; i < n ; ++i)
+		    *d++ = (Uint8)p;
+	    break;
+	  case 2:
+	    for (x = 0 ; x < rect->w ; ++x)
+		for (i = 0, p = ((Uint16*)src)[x] ; i < n ; ++i, d += 2)
+		    *(Uint16*)d = (Uint16)p;
+	    break;
+	  case 3:
+	    for (x = 0 ; x < rect->w * 3 ; x += 3)
+		for (i = 0 ; i < n ; ++i, d += 3)
+		    memcpy(d, src + x, 3);
+	    break;
+	  case 4:
+	    widenrow32((Uint32*)d, (Uint32 const*)src, rect->w, n);
+	    break;
+	}
+	for (i = 1 ; i < n ; ++i)
+	    memcpy(dest + i * displaysurface->pitch, dest, rect->w * n * bpp);
+	src += sdlg.screen->pitch;
+	dest += n * displaysurface->pitch;
+    }
+}
+
+/* Clip a rectangle to the bounds of sdlg.screen. FALSE is returned if
+ * nothing is left of it.
+ */
+static int cliptoscreen(SDL_Rect *rect)
+{
+    int	l, t, r, b;
+
+    l = rect->x < 0 ? 0 : rect->x;
+    t = rect->y < 0 ? 0 : rect->y;
+    r = rect->x + rect->w;
+    if (r > sdlg.screen->w)
+	r = sdlg.screen->w;
+    b = rect->y + rect->h;
+    if (b > sdlg.screen->h)
+	b = sdlg.screen->h;
+    if (l >= r || t >= b)
+	return FALSE;
+    rect->x = l;
+    rect->y = t;
+    rect->w = r - l;
+    rect->h = b - t;
     return TRUE;
 }
 
+/* Make the given areas of sdlg.screen visible on the display. If the
+ * display is scaled, the areas are enlarged into the display first,
+ * so that the cost of scaling follows the size of the areas updated.
+ */
+static void updaterects(int count, SDL_Rect *rects)
+{
+    SDL_Rect	rect;
+    int		n;
+
+    if (sdlg.scale == 1) {
+	SDL_UpdateRects(sdlg.screen, count, rects);
+	return;
+    }
+
+    if (SDL_MUSTLOCK(displaysurface))
+	SDL_LockSurface(displaysurface);
+    for (n = 0 ; n < count ; ++n) {
+	rect = rects[n];
+	if (cliptoscreen(&rect))
+	    scalerect(&rect);
+    }
+    if (SDL_MUSTLOCK(displaysurface))
+	SDL_UnlockSurface(displaysurface);
+    for (n = 0 ; n < count ; ++n) {
+	rect = rects[n];
+	if (cliptoscreen(&rect))
+	    SDL_UpdateRect(displaysurface, rect.x * sdlg.scale,
+					   rect.y * sdlg.scale,
+					   rect.w * sdlg.scale,
+					   rect.h * sdlg.scale);
+    }
+}
+
+/* Make a single area of sdlg.screen visible on the display. As with
+ * SDL_UpdateRect(), a rectangle of all zeros indicates the entire
+ * display.
+ */
+static void updaterect(int x, int y, int w, int h)
+{
+    SDL_Rect	rect;
+
+    if (!x && !y && !w && !h) {
+	w = sdlg.screen->w;
+	h = sdlg.screen->h;
+    }
+    rect.x = x;
+    rect.y = y;
+    rect.w = w;
+    rect.h = h;
+    updaterects(1, &rect);
+}
+
 /* Wipe the display.
  */
 void cleardisplay(void)
@@ -278,6 +550,7 @@ void cleardisplay(void)
     SDL_FillRect(sdlg.screen, NULL, bkgndcolor(sdlg.textclr));
     fullredraw = TRUE;
     mapvieworigin = -1;
+    drawnorigin = -1;
 }
 
 /*
@@ -348,8 +621,7 @@ static void displaymsg(int update)
     }
     puttext(&messageloc, msgdisplay.msg, msgdisplay.msglen, f);
     if (update)
-	SDL_UpdateRect(sdlg.screen, messageloc.x, messageloc.y,
-				    messageloc.w, messageloc.h);
+	updaterect(messageloc.x, messageloc.y, messageloc.w, messageloc.h);
 }
 
 /* Change the current message-display message. msecs gives the number
@@ -376,6 +648,122 @@ int setdisplaymsg(char const *msg, int msecs, int bold)
     return TRUE;
 }
 
+/*
+ * Drawing frames in between ticks.
+ */
+
+/* Compute the position of a creature, including the offset of a
+ * creature in the middle of a move.
+ */
+static void getcrposition(creature const *cr, crposition *pos)
+{
+    pos->id = cr->hidden ? 0 : cr->id;
+    pos->x = (cr->pos % CXGRID) * 8;
+    pos->y = (cr->pos / CXGRID) * 8;
+    if (cr->moving > 0) {
+	switch (cr->dir) {
+	  case NORTH:	pos->y += cr->moving;	break;
+	  case WEST:	pos->x += cr->moving;	break;
+	  case SOUTH:	pos->y -= cr->moving;	break;
+	  case EAST:	pos->x -= cr->moving;	break;
+	}
+    }
+}
+
+/* Return TRUE if a move from (xthen, ythen) to (xnow, ynow) is to be
+ * drawn as a motion.
+ */
+static int ismotion(int xnow, int ynow, int xthen, int ythen)
+{
+    if (xnow == xthen && ynow == ythen)
+	return FALSE;
+    return abs(xnow - xthen) < 8 && abs(ynow - ythen) < 8;
+}
+
+/* Record the positions of the creatures and of the view in the given
+ * game state. If the state is of a new tick, the positions of the
+ * previous tick are moved aside first.
+ */
+static void recordpositions(gamestate const *state)
+{
+    creature const     *cr;
+    int			n;
+
+    if (state->game != positionsgame || state->currenttime != positionstime) {
+	havethen = state->game == positionsgame
+				&& state->currenttime == positionstime + 1;
+	memcpy(crthen, crnow, crnowcount * sizeof *crnow);
+	crthencount = havethen ? crnowcount : 0;
+	xviewthen = xviewnow;
+	yviewthen = yviewnow;
+	positionsgame = state->game;
+	positionstime = state->currenttime;
+    }
+
+    n = 0;
+    for (cr = state->creatures ; cr->id ; ++cr) {
+	if (n >= (int)(sizeof crnow / sizeof *crnow))
+	    break;
+	getcrposition(cr, crnow + n);
+	++n;
+    }
+    crnowcount = n;
+    xviewnow = state->xviewpos;
+    yviewnow = state->yviewpos;
+
+    moving = havethen && ismotion(xviewnow, yviewnow, xviewthen, yviewthen);
+    for (n = 0 ; n < crnowcount && n < crthencount && !moving ; ++n)
+	if (crnow[n].id && crnow[n].id == crthen[n].id)
+	    moving = ismotion(crnow[n].x, crnow[n].y,
+			      crthen[n].x, crthen[n].y);
+}
+
+/* Return the distance in pixels from a position now to the position
+ * at the given phase of the motion from then to now, for a tile that
+ * is size pixels across.
+ */
+static int interpolate(int now, int then, int phase, int size)
+{
+    return ((then - now) * (TICK_PHASES - phase) * size)
+						/ (8 * TICK_PHASES);
+}
+
+/* Return the image of the given creature, which is the nth creature
+ * in the list, and its location on the display, with the creature
+ * placed at the given phase of its motion since the last tick.
+ */
+static SDL_Surface *placecreature(SDL_Rect *rect, creature const *cr,
+				  int n, int phase)
+{
+    SDL_Surface	       *s;
+
+    s = getcreatureimage(rect, cr->id, cr->dir, cr->moving, cr->frame);
+    if (moving && n < crnowcount && n < crthencount
+	       && crnow[n].id == crthen[n].id
+	       && ismotion(crnow[n].x, crnow[n].y, crthen[n].x, crthen[n].y)) {
+	rect->x += interpolate(crnow[n].x, crthen[n].x, phase, sdlg.wtile);
+	rect->y += interpolate(crnow[n].y, crthen[n].y, phase, sdlg.htile);
+    }
+    return s;
+}
+
+/* Return the position of the left or top edge of the map view, in
+ * quarter-tiles, for a view centered on viewpos (in eighths of a
+ * tile). visible is the number of tiles visible and size the size of
+ * the map.
+ */
+static int mapviewedge(int viewpos, int visible, int size)
+{
+    int	edge;
+
+    edge = viewpos / 2 - (visible / 2) * 4;
+    if (edge < 0)
+	edge = 0;
+    if (edge > (size - visible) * 4)
+	edge = (size - visible) * 4;
+    return edge;
+}
+
 /*
  * The main display functions.
  */
@@ -426,45 +814,163 @@ static void displayshutter(void)
     SDL_FillRect(sdlg.screen, &rect, bkgndcolor(sdlg.dimtextclr));
 }
 
+/* Create the offscreen surface for the map, in the display's format,
+ * and mark every cell as needing to be drawn.
+ */
+static void createmapsurface(void)
+{
+    mapsurface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+				      CXGRID * sdlg.wtile,
+				      CYGRID * sdlg.htile,
+				      sdlg.screen->format->BitsPerPixel,
+				      sdlg.screen->format->Rmask,
+				      sdlg.screen->format->Gmask,
+				      sdlg.screen->format->Bmask,
+				      sdlg.screen->format->Amask);
+    if (!mapsurface)
+	die("couldn't create surface: %s", SDL_GetError());
+    if (sdlg.screen->format->palette)
+	SDL_SetColors(mapsurface, sdlg.screen->format->palette->colors,
+		      0, sdlg.screen->format->palette->ncolors);
+    memset(drawnmap, 0, sizeof drawnmap);
+    drawnorigin = -1;
+}
+
+/* Mark the map cells that lie under the given rectangle with flag.
+ */
+static void markcells(SDL_Rect const *rect, int xorigin, int yorigin,
+		      int flag)
+{
+    int	l, t, r, b, x, y;
+
+    l = (rect->x - xorigin + CXGRID * sdlg.wtile) / sdlg.wtile - CXGRID;
+    t = (rect->y - yorigin + CYGRID * sdlg.htile) / sdlg.htile - CYGRID;
+    r = (rect->x + rect->w - 1 - xorigin) / sdlg.wtile;
+    b = (rect->y + rect->h - 1 - yorigin) / sdlg.htile;
+    if (l < 0)
+	l = 0;
+    if (t < 0)
+	t = 0;
+    if (r >= CXGRID)
+	r = CXGRID - 1;
+    if (b >= CYGRID)
+	b = CYGRID - 1;
+    for (y = t ; y <= b ; ++y)
+	for (x = l ; x <= r ; ++x)
+	    drawnmap[y * CXGRID + x].covered |= flag;
+}
+
+/* Add a redrawn cell to the list of changed areas, clipped to the map
+ * view. A cell adjoining the previous one in the same row extends its
+ * rectangle instead of adding a new one.
+ */
+static void adddirtyrect(SDL_Rect const *rect)
+{
+    SDL_Rect   *prev;
+    int		l, t, r, b;
+
+    l = rect->x < displayloc.x ? displayloc.x : rect->x;
+    t = rect->y < displayloc.y ? displayloc.y : rect->y;
+    r = rect->x + rect->w;
+    if (r > displayloc.x + displayloc.w)
+	r = displayloc.x + displayloc.w;
+    b = rect->y + rect->h;
+    if (b > displayloc.y + displayloc.h)
+	b = displayloc.y + displayloc.h;
+    if (l >= r || t >= b)
+	return;
+
+    if (dirtycount) {
+	prev = dirtyrects + dirtycount - 1;
+	if (prev->y == t && prev->h == b - t && prev->x + prev->w == l) {
+	    prev->w += r - l;
+	    return;
+	}
+    }
+    dirtyrects[dirtycount].x = l;
+    dirtyrects[dirtycount].y = t;
+    dirtyrects[dirtycount].w = r - l;
+    dirtyrects[dirtycount].h = b - t;
+    ++dirtycount;
+}
+
 /* Render the view of the visible area of the map to the display, with
  * the view position centered on the display as much as possible. The
  * gamestate's map and the list of creatures are consulted to
- * determine what to render.
+ * determine what to render, with moving creatures and the view placed
+ * at the given phase of the current tick. The visible cells whose
+ * contents have changed are first redrawn in mapsurface. If the view
+ * has moved or the display has been cleared, the whole view is then
+ * copied from mapsurface in one blit. Otherwise only the changed
+ * cells, and the cells that are under a creature's image now or were
+ * before, are copied. The creatures are drawn on top, and the changed
+ * areas of the display are recorded in dirtyrects.
  */
-static void displaymapview(gamestate const *state)
+static void displaymapview(gamestate const *state, int phase)
 {
-    SDL_Rect		rect;
+    SDL_Rect		rect, src;
     SDL_Surface	       *s;
     creature const     *cr;
     int			xdisppos, ydisppos;
     int			xorigin, yorigin;
     int			lmap, tmap, rmap, bmap;
-    int			pos, x, y;
+    int			timer, full, changed;
+    int			pos, top, bot, x, y, n;
 
+    drawnphase = phase;
     if (state->statusflags & SF_SHUTTERED) {
 	displayshutter();
+	drawnorigin = -1;
+	dirtyrects[0] = displayloc;
+	dirtycount = 1;
 	return;
     }
 
-    xdisppos = state->xviewpos / 2 - (NXTILES / 2) * 4;
-    ydisppos = state->yviewpos / 2 - (NYTILES / 2) * 4;
-    if (xdisppos < 0)
-	xdisppos = 0;
-    if (ydisppos < 0)
-	ydisppos = 0;
-    if (xdisppos > (CXGRID - NXTILES) * 4)
-	xdisppos = (CXGRID - NXTILES) * 4;
-    if (ydisppos > (CYGRID - NYTILES) * 4)
-	ydisppos = (CYGRID - NYTILES) * 4;
+    if (!mapsurface)
+	createmapsurface();
+
+    xdisppos = mapviewedge(state->xviewpos, NXTILES, CXGRID);
+    ydisppos = mapviewedge(state->yviewpos, NYTILES, CYGRID);
     xorigin = displayloc.x - (xdisppos * sdlg.wtile / 4);
     yorigin = displayloc.y - (ydisppos * sdlg.htile / 4);
+    if (moving && ismotion(xviewnow, yviewnow, xviewthen, yviewthen)) {
+	xorigin -= interpolate(xdisppos * 2,
+			       mapviewedge(xviewthen, NXTILES, CXGRID) * 2,
+			       phase, sdlg.wtile);
+	yorigin -= interpolate(ydisppos * 2,
+			       mapviewedge(yviewthen, NYTILES, CYGRID) * 2,
+			       phase, sdlg.htile);
+    }
 
     mapvieworigin = ydisppos * CXGRID * 4 + xdisppos;
 
-    lmap = xdisppos / 4;
-    tmap = ydisppos / 4;
-    rmap = (xdisppos + 3) / 4 + NXTILES;
-    bmap = (ydisppos + 3) / 4 + NYTILES;
+    timer = (state->statusflags & SF_NOANIMATION) ? -1 : state->currenttime;
+    n = (displayloc.y - yorigin) * CXGRID * sdlg.wtile
+				+ (displayloc.x - xorigin);
+    full = fullredraw || n != drawnorigin;
+    drawnorigin = n;
+    dirtycount = 0;
+
+    lmap = (displayloc.x - xorigin) / sdlg.wtile;
+    tmap = (displayloc.y - yorigin) / sdlg.htile;
+    rmap = (displayloc.x - xorigin + sdlg.wtile - 1) / sdlg.wtile + NXTILES;
+    bmap = (displayloc.y - yorigin + sdlg.htile - 1) / sdlg.htile + NYTILES;
+
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos)
+	drawnmap[pos].covered >>= 1;
+    for (cr = state->creatures ; cr->id ; ++cr) {
+	if (cr->hidden)
+	    continue;
+	x = cr->pos % CXGRID;
+	y = cr->pos / CXGRID;
+	if (x < lmap - 2 || x >= rmap + 2 || y < tmap - 2 || y >= bmap + 2)
+	    continue;
+	rect.x = xorigin + x * sdlg.wtile;
+	rect.y = yorigin + y * sdlg.htile;
+	placecreature(&rect, cr, cr - state->creatures, phase);
+	markcells(&rect, xorigin, yorigin, CELL_COVERING);
+    }
+
     for (y = tmap ; y < bmap ; ++y) {
 	if (y < 0 || y >= CXGRID)
 	    continue;
@@ -472,17 +978,45 @@ static void displaymapview(gamestate const *state)
 	    if (x < 0 || x >= CXGRID)
 		continue;
 	    pos = y * CXGRID + x;
-	    rect.x = xorigin + x * sdlg.wtile;
-	    rect.y = yorigin + y * sdlg.htile;
-	    s = getcellimage(&rect,
-			     state->map[pos].top.id,
-			     state->map[pos].bot.id,
-			     (state->statusflags & SF_NOANIMATION) ?
-						-1 : state->currenttime);
-	    drawclippedtile(&rect, s);
+	    top = state->map[pos].top.id;
+	    bot = state->map[pos].bot.id;
+	    changed = !drawnmap[pos].drawn
+		   || drawnmap[pos].top != top || drawnmap[pos].bot != bot
+		   || (drawnmap[pos].timer != timer
+			&& (iscellanimated(top) || iscellanimated(bot)));
+	    if (changed) {
+		rect.x = x * sdlg.wtile;
+		rect.y = y * sdlg.htile;
+		s = getcellimage(&rect, top, bot, timer);
+		SDL_BlitSurface(s, NULL, mapsurface, &rect);
+		drawnmap[pos].top = top;
+		drawnmap[pos].bot = bot;
+		drawnmap[pos].timer = timer;
+		drawnmap[pos].drawn = TRUE;
+	    }
+	    if (!full && (changed || drawnmap[pos].covered)) {
+		rect.x = xorigin + x * sdlg.wtile;
+		rect.y = yorigin + y * sdlg.htile;
+		rect.w = sdlg.wtile;
+		rect.h = sdlg.htile;
+		adddirtyrect(&rect);
+	    }
 	}
     }
 
+    if (full) {
+	dirtyrects[0] = displayloc;
+	dirtycount = 1;
+    }
+    for (n = 0 ; n < dirtycount ; ++n) {
+	src = dirtyrects[n];
+	src.x -= xorigin;
+	src.y -= yorigin;
+	rect = dirtyrects[n];
+	if (SDL_BlitSurface(mapsurface, &src, sdlg.screen, &rect))
+	    warn("%s", SDL_GetError());
+    }
+
     lmap -= 2;
     tmap -= 2;
     rmap += 2;
@@ -496,7 +1030,7 @@ static void displaymapview(gamestate const *state)
 	    continue;
 	rect.x = xorigin + x * sdlg.wtile;
 	rect.y = yorigin + y * sdlg.htile;
-	s = getcreatureimage(&rect, cr->id, cr->dir, cr->moving, cr->frame);
+	s = placecreature(&rect, cr, cr - state->creatures, phase);
 	drawclippedtile(&rect, s);
     }
 }
@@ -511,6 +1045,7 @@ static void displaymapview(gamestate const *state)
 static void displayinfo(gamestate const *state, int timeleft, int besttime)
 {
     SDL_Rect	rect, rrect;
+    char const *overlay;
     char	buf[512];
     int		n;
 
@@ -586,6 +1121,8 @@ static void displayinfo(gamestate const *state, int timeleft, int besttime)
 	}
     } else if (state->statusflags & SF_SHOWHINT) {
 	puttext(&hintloc, state->hinttext, -1, PT_MULTILINE | PT_CENTER);
+    } else if ((overlay = telemetryoverlay())) {
+	puttext(&hintloc, overlay, -1, PT_MULTILINE | PT_DIM);
     } else {
 	fillrect(&hintloc);
     }
@@ -607,8 +1144,7 @@ static int displayprompticon(int completed)
     src.w = PROMPTICONW;
     src.h = PROMPTICONH;
     SDL_BlitSurface(prompticons, &src, sdlg.screen, &promptloc);
-    SDL_UpdateRect(sdlg.screen, promptloc.x, promptloc.y,
-				promptloc.w, promptloc.h);
+    updaterect(promptloc.x, promptloc.y, promptloc.w, promptloc.h);
     return TRUE;
 }
 
@@ -678,15 +1214,50 @@ void setcolors(long bkgnd, long text, long bold, long dim)
  */
 int displaygame(void const *state, int timeleft, int besttime)
 {
-    displaymapview(state);
+    int	phase;
+
+    phase = beginphase(Phase_MapView);
+    recordpositions(state);
+    displaymapview(state, _sdltickphase());
+    endphase(phase);
+    phase = beginphase(Phase_Info);
     displayinfo(state, timeleft, besttime);
     displaymsg(FALSE);
+    endphase(phase);
+    phase = beginphase(Phase_Update);
     if (fullredraw) {
-	SDL_UpdateRect(sdlg.screen, 0, 0, 0, 0);
+	updaterect(0, 0, 0, 0);
 	fullredraw = FALSE;
     } else {
-	SDL_UpdateRects(sdlg.screen,
-			sizeof locrects / sizeof *locrects, locrects);
+	if (dirtycount)
+	    updaterects(dirtycount, dirtyrects);
+	updaterects(sizeof locrects / sizeof *locrects - 1, locrects + 1);
+    }
+    endphase(phase);
+    _sdlvideoframe(displaysurface);
+    _sdlinputdisplayed();
+    return TRUE;
+}
+
+/* Redraw the map view in between ticks. Nothing is drawn if nothing
+ * is moving, or if the map view is already drawn at the current phase.
+ */
+int displaygameframe(void const *state)
+{
+    int	phase, prev;
+
+    if (!moving)
+	return TRUE;
+    phase = _sdltickphase();
+    if (phase == drawnphase)
+	return TRUE;
+    prev = beginphase(Phase_MapView);
+    displaymapview(state, phase);
+    endphase(prev);
+    if (dirtycount) {
+	prev = beginphase(Phase_Update);
+	updaterects(dirtycount, dirtyrects);
+	endphase(prev);
     }
     return TRUE;
 }
@@ -717,8 +1288,7 @@ int displayendmessage(int basescore, int timescore, long totalscore,
 	puttext(&rect, decimal(basescore, 5), -1, PT_RIGHT | PT_UPDATERECT);
 	puttext(&rect, decimal(fullscore, 5), -1, PT_RIGHT | PT_UPDATERECT);
 	puttext(&rect, decimal(totalscore, 7), -1, PT_RIGHT | PT_UPDATERECT);
-	SDL_UpdateRect(sdlg.screen, hintloc.x, hintloc.y,
-				    hintloc.w, hintloc.h);
+	updaterect(hintloc.x, hintloc.y, hintloc.w, hintloc.h);
     }
     return displayprompticon(completed);
 }
@@ -821,7 +1391,7 @@ int displaytextscroll(char const *title, char const **paragraphs,
 	    thumb.y = area.y + topline * (area.h - thumb.h) / maxtop;
 	    SDL_FillRect(sdlg.screen, &thumb, halfcolor(sdlg.textclr));
 	}
-	SDL_UpdateRect(sdlg.screen, 0, 0, 0, 0);
+	updaterect(0, 0, 0, 0);
 	n = SCROLL_NOP;
     } while ((*inputcallback)(&n));
 
@@ -856,7 +1426,7 @@ int displaytable(char const *title, tablespec const *table, int completed)
     free(cols);
 
     displayprompticon(completed);
-    SDL_UpdateRect(sdlg.screen, 0, 0, 0, 0);
+    updaterect(0, 0, 0, 0);
     return TRUE;
 }
 
@@ -913,7 +1483,7 @@ int displaytiletable(char const *title,
 
     displayprompticon(completed);
 
-    SDL_UpdateRect(sdlg.screen, 0, 0, 0, 0);
+    updaterect(0, 0, 0, 0);
 
     return TRUE;
 }
@@ -923,7 +1493,8 @@ int displaytiletable(char const *title,
  * pointed to by idx. The callback function inputcallback is called
  * repeatedly to determine how to move the selection and when to
  * leave. The row selected when the function returns is returned to
- * the caller through idx.
+ * the caller through idx. If the table produces its rows on demand,
+ * only the rows that are visible are produced.
  */
 int displaylist(char const *title, tablespec const *table, int *idx,
 		int (*inputcallback)(int*))
@@ -988,8 +1559,13 @@ int displaylist(char const *title, tablespec const *table, int *idx,
 	SDL_FillRect(sdlg.screen, &area, bkgndcolor(sdlg.textclr));
 	memcpy(colstmp, cols, table->cols * sizeof *colstmp);
 	drawtablerow(table, colstmp, &n, 0);
-	for (j = 0 ; j < topitem ; ++j)
-	    drawtablerow(table, NULL, &n, 0);
+	if (table->getrow) {
+	    n += topitem;
+	    j = topitem;
+	} else {
+	    for (j = 0 ; j < topitem ; ++j)
+		drawtablerow(table, NULL, &n, 0);
+	}
 	for ( ; j < topitem + linecount && j < itemcount ; ++j)
 	    drawtablerow(table, colstmp, &n, j == index ? PT_HILIGHT : 0);
 	if (itemcount > linecount) {
@@ -998,7 +1574,7 @@ int displaylist(char const *title, tablespec const *table, int *idx,
 		    + topitem * (area.h - thumb.h) / (itemcount - linecount);
 	    SDL_FillRect(sdlg.screen, &thumb, halfcolor(sdlg.textclr));
 	}
-	SDL_UpdateRect(sdlg.screen, 0, 0, 0, 0);
+	updaterect(0, 0, 0, 0);
 
 	n = SCROLL_NOP;
     } while ((*inputcallback)(&n));
@@ -1058,7 +1634,7 @@ int displayinputprompt(char const *prompt, char *input, int maxlen,
 	input[len] = '_';
 	puttext(&inputrect, input, len + 1, PT_CENTER);
 	input[len] = '\0';
-	SDL_UpdateRect(sdlg.screen, area.x, area.y, area.w, area.h);
+	updaterect(area.x, area.y, area.w, area.h);
 	ch = (*inputcallback)();
 	if (ch == '\n' || ch < 0)
 	    break;
@@ -1096,9 +1672,10 @@ int creategamedisplay(void)
 /* Initialize the display with a generic surface capable of rendering
  * text.
  */
-int _sdloutputinitialize(int _fullscreen)
+int _sdloutputinitialize(int _fullscreen, int scale)
 {
     sdlg.windowmapposfunc = _windowmappos;
+    sdlg.scale = scale;
     fullscreen = _fullscreen;
 
     screenw = 640;
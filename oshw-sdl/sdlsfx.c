@@ -11,6 +11,7 @@
 #include	"sdlgen.h"
 #include	"../err.h"
 #include	"../state.h"
+#include	"../telemetry.h"
 
 /* Some generic default settings for the audio output.
  */
@@ -26,8 +27,21 @@ typedef	struct sfxinfo {
     int			pos;		/* how much has been played already */
     int			playing;	/* is the wave currently playing? */
     char const	       *textsfx;	/* the onomatopoeia string */
+    Uint32		filehash;	/* hash value of the wave file */
+    Uint32		filesize;	/* size of the wave file, or zero */
 } sfxinfo;
 
+/* A converted wave stored in the sound cache, identified by the hash
+ * value and size of the wave file it came from.
+ */
+typedef	struct sfxcacheentry {
+    Uint32		hash;		/* hash value of the wave file */
+    Uint32		size;		/* size of the wave file */
+    Uint32		len;		/* size of the converted data */
+    Uint8 const	       *data;		/* the converted data */
+    int			keep;		/* TRUE if a resource uses it */
+} sfxcacheentry;
+
 /* The data needed to talk to the sound output device.
  */
 static SDL_AudioSpec	spec;
@@ -52,6 +66,89 @@ static int		volume = SDL_MIX_MAXVOLUME;
  */
 static int		soundbufsize = 0;
 
+/* The buffer that the sound effects are summed in before being
+ * written to the output, and its size in samples.
+ */
+static Sint32	       *mixbuf = NULL;
+static int		mixbufsize = 0;
+
+/* The first word of a sound cache file. Since the file is written in
+ * the machine's own byte order, this also serves to reject a file
+ * written on a machine with a different byte order.
+ */
+#define	SFXCACHE_SIG		0x43535754UL
+
+/* The version of the sound cache file format.
+ */
+#define	SFXCACHE_VERSION	1
+
+/* The number of words in the header of a sound cache file, and in
+ * each entry of its directory.
+ */
+#define	SFXCACHE_HEADERSIZE	6
+#define	SFXCACHE_ENTRYSIZE	3
+
+/* The sound cache file in use, the waves read from it, and whether
+ * any sounds have been loaded that were not found in it.
+ */
+static char	       *sfxcachefile = NULL;
+static Uint8	       *sfxcachedata = NULL;
+static sfxcacheentry   *sfxcache = NULL;
+static int		sfxcachecount = 0;
+static int		sfxcachedirty = FALSE;
+
+/* A change to the sound effects being played, stamped with the game
+ * tick on which it occurred.
+ */
+typedef	struct sfxevent {
+    int			tick;		/* the tick of the change */
+    short		index;		/* the sound effect, or -1 for all */
+    short		play;		/* TRUE to start, FALSE to stop */
+} sfxevent;
+
+/* The queue of sound effect changes. The main thread is the only
+ * writer of ringhead and the audio thread the only writer of
+ * ringtail, so the two threads never have to lock each other out.
+ */
+#define	SFXRINGSIZE	64
+static sfxevent		ring[SFXRINGSIZE];
+static unsigned volatile	ringhead = 0;
+static unsigned volatile	ringtail = 0;
+
+/* The time spent in the callback, in microseconds, and the number of
+ * calls made to it, when telemetry is being collected. Only the audio
+ * thread writes these, and the main thread reports the increase since
+ * it last looked.
+ */
+static unsigned long volatile	callbacktime = 0;
+static unsigned long volatile	callbackcount = 0;
+static unsigned long		reportedtime = 0;
+static unsigned long		reportedcount = 0;
+
+/* Keep the compiler and the processor from reordering reads and
+ * writes of the queue's contents across an update of its indexes.
+ */
+#ifdef __GNUC__
+#define	memorybarrier()	__sync_synchronize()
+#else
+#define	memorybarrier()
+#endif
+
+/* The continuous sounds that the main thread has last asked to be
+ * played.
+ */
+static unsigned long	continuousplaying = 0;
+
+/* The number of samples that the audio thread has output, and the
+ * mapping of game ticks to that count: synctick's sound effects are
+ * played starting at syncsample. (Both are only used by the audio
+ * thread.)
+ */
+static unsigned long	sampleclock = 0;
+static unsigned long	syncsample = 0;
+static int		synctick = 0;
+static int		synced = FALSE;
+
 
 /* Initialize the textual sound effects.
  */
@@ -107,45 +204,422 @@ static void displaysoundeffects(unsigned long sfx, int display)
     }
 }
 
-/* The callback function that is called by the sound driver to supply
- * the latest sound effects. All the sound effects are checked, and
- * the ones that are being played get another chunk of their sound
- * data mixed into the output buffer. When the end of a sound effect's
- * wave data is reached, the one-shot sounds are changed to be marked
- * as not playing, and the continuous sounds are looped.
+/* The number of samples that the mixing loops handle at a time. The
+ * inner loops have a constant length so that the compiler can turn
+ * them into vector instructions.
  */
-static void sfxcallback(void *data, Uint8 *wave, int len)
+#define	MIXSTRIDE	8
+
+/* Add len bytes of wave data to the mixing buffer, starting at the
+ * given byte offset into the output.
+ */
+static void mixwave(int offset, Uint8 const *wave, int len)
 {
-    int	i, n;
+    Sint16 const       *src;
+    Sint32	       *mix;
+    int			i, j, n;
+
+    src = (Sint16 const*)wave;
+    mix = mixbuf + offset / sizeof *src;
+    n = len / sizeof *src;
+    for (i = 0 ; i + MIXSTRIDE <= n ; i += MIXSTRIDE)
+	for (j = 0 ; j < MIXSTRIDE ; ++j)
+	    mix[i + j] += src[i + j];
+    for ( ; i < n ; ++i)
+	mix[i] += src[i];
+}
 
-    (void)data;
-    memset(wave, spec.silence, len);
+/* Apply the volume to count samples of the mixing buffer, and store
+ * them in the output buffer, clipped to the range of a 16-bit sample.
+ */
+static void clipmix(Sint16 *out, int count)
+{
+    Sint32	v[MIXSTRIDE];
+    int		i, j;
+
+    for (i = 0 ; i + MIXSTRIDE <= count ; i += MIXSTRIDE) {
+	for (j = 0 ; j < MIXSTRIDE ; ++j)
+	    v[j] = (mixbuf[i + j] * volume) / SDL_MIX_MAXVOLUME;
+	for (j = 0 ; j < MIXSTRIDE ; ++j)
+	    v[j] = v[j] < -32768 ? -32768 : v[j];
+	for (j = 0 ; j < MIXSTRIDE ; ++j)
+	    out[i + j] = v[j] > 32767 ? 32767 : v[j];
+    }
+    for ( ; i < count ; ++i) {
+	v[0] = (mixbuf[i] * volume) / SDL_MIX_MAXVOLUME;
+	out[i] = v[0] < -32768 ? -32768 : v[0] > 32767 ? 32767 : v[0];
+    }
+}
+
+/* Add another change to the queue. FALSE is returned if the queue is
+ * full.
+ */
+static int queuesfxevent(int index, int play)
+{
+    unsigned	head;
+
+    head = ringhead;
+    if (((head + 1) & (SFXRINGSIZE - 1)) == ringtail)
+	return FALSE;
+    ring[head].tick = gettickcount();
+    ring[head].index = index;
+    ring[head].play = play;
+    memorybarrier();
+    ringhead = (head + 1) & (SFXRINGSIZE - 1);
+    return TRUE;
+}
+
+/* Return the position in the current buffer, in samples, at which
+ * the given change should be applied. done is how much of the buffer
+ * has already been mixed, and count is its full length. The first
+ * change is placed a little ways ahead, so that later ones, which can
+ * arrive anywhere in the time that one buffer is played, still keep
+ * their spacing. If a change is too far from where it is expected
+ * (because the game was paused, say), the mapping is reset.
+ */
+static int sfxeventpos(sfxevent const *ev, int done, int count)
+{
+    long	pos;
+    int		delay, t;
+
+    delay = spec.freq / TICKS_PER_SECOND;
+    if (delay > count)
+	delay = count;
+
+    t = ev->tick - synctick;
+    if (synced && t >= 0 && t < 60 * TICKS_PER_SECOND) {
+	while (t >= TICKS_PER_SECOND) {
+	    synctick += TICKS_PER_SECOND;
+	    syncsample += spec.freq;
+	    t -= TICKS_PER_SECOND;
+	}
+	pos = (long)(syncsample - sampleclock)
+			+ (long)t * spec.freq / TICKS_PER_SECOND;
+	if (pos >= done && pos < count + 2 * delay)
+	    return (int)pos;
+    }
+
+    synced = TRUE;
+    synctick = ev->tick;
+    syncsample = sampleclock + done + delay;
+    return done + delay;
+}
+
+/* Apply a change to the sound effects being played. One-shot sounds
+ * are restarted from the beginning.
+ */
+static void applysfxevent(sfxevent const *ev)
+{
+    int	i;
+
+    if (ev->index < 0) {
+	for (i = 0 ; i < SND_COUNT ; ++i) {
+	    sounds[i].playing = FALSE;
+	    sounds[i].pos = 0;
+	}
+	synced = FALSE;
+    } else {
+	i = ev->index;
+	sounds[i].playing = ev->play;
+	if (ev->play && i < SND_ONESHOT_COUNT)
+	    sounds[i].pos = 0;
+    }
+}
+
+/* Mix the sound effects that are playing into the mixing buffer, from
+ * sample from up to sample to. FALSE is returned if there was nothing
+ * to mix.
+ */
+static int mixsounds(int from, int to)
+{
+    int	active, i, len, n, off;
+
+    active = FALSE;
+    off = from * sizeof(Sint16);
+    len = (to - from) * sizeof(Sint16);
     for (i = 0 ; i < SND_COUNT ; ++i) {
 	if (!sounds[i].wave)
 	    continue;
 	if (!sounds[i].playing)
 	    if (!sounds[i].pos || i >= SND_ONESHOT_COUNT)
 		continue;
+	active = TRUE;
 	n = sounds[i].len - sounds[i].pos;
 	if (n > len) {
-	    SDL_MixAudio(wave, sounds[i].wave + sounds[i].pos, len, volume);
+	    mixwave(off, sounds[i].wave + sounds[i].pos, len);
 	    sounds[i].pos += len;
 	} else {
-	    SDL_MixAudio(wave, sounds[i].wave + sounds[i].pos, n, volume);
+	    mixwave(off, sounds[i].wave + sounds[i].pos, n);
 	    sounds[i].pos = 0;
 	    if (i < SND_ONESHOT_COUNT) {
 		sounds[i].playing = FALSE;
 	    } else if (sounds[i].playing) {
 		while (len - n >= (int)sounds[i].len) {
-		    SDL_MixAudio(wave + n, sounds[i].wave, sounds[i].len,
-				 volume);
+		    mixwave(off + n, sounds[i].wave, sounds[i].len);
 		    n += sounds[i].len;
 		}
 		sounds[i].pos = len - n;
-		SDL_MixAudio(wave + n, sounds[i].wave, sounds[i].pos, volume);
+		mixwave(off + n, sounds[i].wave, sounds[i].pos);
 	    }
 	}
     }
+    return active;
+}
+
+/* Supply the latest sound effects to the sound driver. The queued
+ * changes are applied at the points in the buffer that correspond to
+ * the ticks they occurred on, and between them all the sound effects
+ * that are playing get another chunk of their sound data summed into
+ * the mixing buffer. When the end of a sound effect's wave data is
+ * reached, the one-shot sounds are changed to be marked as not
+ * playing, and the continuous sounds are looped. Finally, the volume
+ * is applied to the sum and the result is clipped into the output
+ * buffer.
+ */
+static void fillwave(Uint8 *wave, int len)
+{
+    unsigned	tail;
+    int		active, count, done, at;
+
+    count = len / sizeof(Sint16);
+    if (count > mixbufsize) {
+	memset(wave, spec.silence, len);
+	return;
+    }
+    memset(mixbuf, 0, count * sizeof *mixbuf);
+    active = FALSE;
+    for (done = 0 ; ; done = at) {
+	at = count;
+	while ((tail = ringtail) != ringhead) {
+	    memorybarrier();
+	    at = sfxeventpos(&ring[tail], done, count);
+	    if (at > done)
+		break;
+	    applysfxevent(&ring[tail]);
+	    memorybarrier();
+	    ringtail = (tail + 1) & (SFXRINGSIZE - 1);
+	    at = count;
+	}
+	if (at > count)
+	    at = count;
+	if (mixsounds(done, at))
+	    active = TRUE;
+	if (at == count)
+	    break;
+    }
+    sampleclock += count;
+
+    if (!active) {
+	memset(wave, spec.silence, len);
+	return;
+    }
+    clipmix((Sint16*)wave, count);
+}
+
+/* The callback function that is called by the sound driver to supply
+ * the latest sound effects, timing itself if telemetry is being
+ * collected.
+ */
+static void sfxcallback(void *data, Uint8 *wave, int len)
+{
+    unsigned long	start;
+
+    (void)data;
+    if (!_telemetryon) {
+	fillwave(wave, len);
+	return;
+    }
+    start = _sdlgetmicroseconds();
+    fillwave(wave, len);
+    callbacktime += _sdlgetmicroseconds() - start;
+    ++callbackcount;
+}
+
+/* Report the time spent in the callback since the last report.
+ */
+static void reportcallbacktime(void)
+{
+    unsigned long	time, count;
+
+    time = callbacktime;
+    count = callbackcount;
+    addphasetime(Phase_Audio, time - reportedtime, count - reportedcount);
+    reportedtime = time;
+    reportedcount = count;
+}
+
+/*
+ * Caching the converted sounds.
+ */
+
+/* Fill in the header of a sound cache file, which identifies the
+ * format of the sound device.
+ */
+static void makesfxcacheheader(Uint32 *header, int count)
+{
+    header[0] = SFXCACHE_SIG;
+    header[1] = SFXCACHE_VERSION;
+    header[2] = spec.freq;
+    header[3] = spec.format;
+    header[4] = spec.channels;
+    header[5] = count;
+}
+
+/* Read the directory and the wave data of a sound cache file into
+ * memory. FALSE is returned if the file does not exist, is invalid,
+ * or was written for a different sound format.
+ */
+static int readsfxcache(char const *filename)
+{
+    FILE       *fp;
+    Uint32	header[SFXCACHE_HEADERSIZE];
+    Uint32	expected[SFXCACHE_HEADERSIZE];
+    Uint32	entry[SFXCACHE_ENTRYSIZE];
+    Uint32	total, avail;
+    long	filesize;
+    int		count, f, n;
+
+    if (!(fp = fopen(filename, "rb")))
+	return FALSE;
+    if (fseek(fp, 0, SEEK_END) || (filesize = ftell(fp)) < 0
+			       || fseek(fp, 0, SEEK_SET)
+			       || fread(header, sizeof header, 1, fp) != 1
+			       || header[5] > 1024) {
+	fclose(fp);
+	return FALSE;
+    }
+    count = header[5];
+    makesfxcacheheader(expected, count);
+    if (memcmp(header, expected, sizeof header) || !count
+		|| (unsigned long)filesize < sizeof header
+					     + count * sizeof entry) {
+	fclose(fp);
+	return FALSE;
+    }
+    avail = filesize - sizeof header - count * sizeof entry;
+    if (!(sfxcache = malloc(count * sizeof *sfxcache)))
+	memerrexit();
+    f = TRUE;
+    total = 0;
+    for (n = 0 ; n < count ; ++n) {
+	if (fread(entry, sizeof entry, 1, fp) != 1
+			|| entry[2] > avail - total || entry[2] % 2) {
+	    f = FALSE;
+	    break;
+	}
+	sfxcache[n].hash = entry[0];
+	sfxcache[n].size = entry[1];
+	sfxcache[n].len = entry[2];
+	sfxcache[n].keep = FALSE;
+	total += entry[2];
+    }
+    if (f) {
+	if (!(sfxcachedata = malloc(total ? total : 1)))
+	    memerrexit();
+	f = fread(sfxcachedata, 1, total, fp) == total;
+    }
+    fclose(fp);
+    if (!f) {
+	free(sfxcache);
+	free(sfxcachedata);
+	sfxcache = NULL;
+	sfxcachedata = NULL;
+	return FALSE;
+    }
+    total = 0;
+    for (n = 0 ; n < count ; ++n) {
+	sfxcache[n].data = sfxcachedata + total;
+	total += sfxcache[n].len;
+    }
+    sfxcachecount = count;
+    return TRUE;
+}
+
+/* Add a wave to a list of cache entries, unless the list already has
+ * an entry for the same wave file. The new size of the list is
+ * returned.
+ */
+static int addsfxcacheentry(sfxcacheentry *list, int count,
+			    Uint32 hash, Uint32 size,
+			    Uint8 const *data, Uint32 len)
+{
+    int	n;
+
+    for (n = 0 ; n < count ; ++n)
+	if (list[n].hash == hash && list[n].size == size)
+	    return count;
+    list[count].hash = hash;
+    list[count].size = size;
+    list[count].data = data;
+    list[count].len = len;
+    return count + 1;
+}
+
+/* Write a sound cache file holding the waves of all the sounds
+ * currently loaded, along with the waves of the old cache file that
+ * are still used by a resource but are not among them (so that the
+ * sounds of each ruleset can share the one file). Waves that nothing
+ * uses any longer are dropped.
+ */
+static int writesfxcache(char const *filename)
+{
+    FILE	       *fp;
+    sfxcacheentry      *list;
+    Uint32		header[SFXCACHE_HEADERSIZE];
+    Uint32		entry[SFXCACHE_ENTRYSIZE];
+    int			count, f, n;
+
+    if (!(list = malloc((SND_COUNT + sfxcachecount) * sizeof *list)))
+	memerrexit();
+    count = 0;
+    for (n = 0 ; n < SND_COUNT ; ++n)
+	if (sounds[n].wave && sounds[n].filesize)
+	    count = addsfxcacheentry(list, count, sounds[n].filehash,
+				     sounds[n].filesize,
+				     sounds[n].wave, sounds[n].len);
+    for (n = 0 ; n < sfxcachecount ; ++n)
+	if (sfxcache[n].keep)
+	    count = addsfxcacheentry(list, count, sfxcache[n].hash,
+				     sfxcache[n].size,
+				     sfxcache[n].data, sfxcache[n].len);
+
+    if (!(fp = fopen(filename, "wb"))) {
+	free(list);
+	return FALSE;
+    }
+    makesfxcacheheader(header, count);
+    f = fwrite(header, sizeof header, 1, fp) == 1;
+    for (n = 0 ; f && n < count ; ++n) {
+	entry[0] = list[n].hash;
+	entry[1] = list[n].size;
+	entry[2] = list[n].len;
+	f = fwrite(entry, sizeof entry, 1, fp) == 1;
+    }
+    for (n = 0 ; f && n < count ; ++n)
+	f = fwrite(list[n].data, 1, list[n].len, fp) == list[n].len;
+    free(list);
+    if (fclose(fp) || !f) {
+	remove(filename);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/* Replace a sound effect's wave data. hash and size identify the
+ * wave file the data came from, or are zero if it is unknown.
+ */
+static void setsfxwave(int index, Uint8 *wave, Uint32 len,
+		       Uint32 hash, Uint32 size)
+{
+    freesfx(index);
+    SDL_LockAudio();
+    sounds[index].wave = wave;
+    sounds[index].len = len;
+    sounds[index].pos = 0;
+    sounds[index].playing = FALSE;
+    sounds[index].filehash = hash;
+    sounds[index].filesize = size;
+    SDL_UnlockAudio();
 }
 
 /*
@@ -169,6 +643,9 @@ int setaudiosystem(int active)
 	    SDL_PauseAudio(TRUE);
 	    SDL_CloseAudio();
 	    hasaudio = FALSE;
+	    free(mixbuf);
+	    mixbuf = NULL;
+	    mixbufsize = 0;
 	}
 	return TRUE;
     }
@@ -190,10 +667,21 @@ int setaudiosystem(int active)
     des.userdata = NULL;
     for (n = 1 ; n <= des.freq / TICKS_PER_SECOND ; n <<= 1) ;
     des.samples = (n << soundbufsize) >> 2;
-    if (SDL_OpenAudio(&des, &spec) < 0) {
+    /* Without an obtained spec, SDL converts from the desired format
+     * if the device needs another, so the mixer only ever has to
+     * produce 16-bit samples.
+     */
+    if (SDL_OpenAudio(&des, NULL) < 0) {
 	warn("can't access audio output: %s", SDL_GetError());
 	return FALSE;
     }
+    spec = des;
+    ringhead = ringtail = 0;
+    continuousplaying = 0;
+    synced = FALSE;
+    mixbufsize = spec.size / sizeof(Sint16);
+    if (!(mixbuf = malloc(mixbufsize * sizeof *mixbuf)))
+	memerrexit();
     hasaudio = TRUE;
     SDL_PauseAudio(FALSE);
 
@@ -210,6 +698,8 @@ int loadsfxfromfile(int index, char const *filename)
     Uint8	       *wavein;
     Uint8	       *wavecvt;
     Uint32		lengthin;
+    Uint32		hash, size;
+    int			n;
 
     if (!filename) {
 	freesfx(index);
@@ -222,6 +712,20 @@ int loadsfxfromfile(int index, char const *filename)
 	if (!setaudiosystem(TRUE))
 	    return FALSE;
 
+    hash = size = 0;
+    if (sfxcachefile && _sdlhashfile(filename, &hash, &size)) {
+	for (n = 0 ; n < sfxcachecount ; ++n) {
+	    if (sfxcache[n].hash != hash || sfxcache[n].size != size)
+		continue;
+	    if (!(wavecvt = malloc(sfxcache[n].len)))
+		memerrexit();
+	    memcpy(wavecvt, sfxcache[n].data, sfxcache[n].len);
+	    setsfxwave(index, wavecvt, sfxcache[n].len, hash, size);
+	    return TRUE;
+	}
+	sfxcachedirty = TRUE;
+    }
+
     if (!SDL_LoadWAV(filename, &specin, &wavein, &lengthin)) {
 	warn("can't load %s: %s", filename, SDL_GetError());
 	return FALSE;
@@ -244,44 +748,89 @@ int loadsfxfromfile(int index, char const *filename)
 	return FALSE;
     }
 
-    freesfx(index);
-    SDL_LockAudio();
-    sounds[index].wave = convert.buf;
-    sounds[index].len = convert.len * convert.len_ratio;
-    sounds[index].pos = 0;
-    sounds[index].playing = FALSE;
-    SDL_UnlockAudio();
+    setsfxwave(index, convert.buf, convert.len * convert.len_ratio,
+	       hash, size);
+    return TRUE;
+}
 
+/* Start using a sound cache file.
+ */
+int opensfxcache(char const *filename)
+{
+    closesfxcache();
+    if (!filename || !hasaudio)
+	return FALSE;
+    if (!(sfxcachefile = malloc(strlen(filename) + 1)))
+	memerrexit();
+    strcpy(sfxcachefile, filename);
+    sfxcachedirty = FALSE;
+    readsfxcache(filename);
     return TRUE;
 }
 
+/* Mark the cached wave converted from the given file as still in use,
+ * so that it is kept when the cache file is rewritten. Nothing is done
+ * unless the cache is going to be rewritten.
+ */
+void keepsfxcachefile(char const *filename)
+{
+    Uint32	hash, size;
+    int		n;
+
+    if (!sfxcachefile || !sfxcachedirty || !sfxcachecount)
+	return;
+    if (!_sdlhashfile(filename, &hash, &size))
+	return;
+    for (n = 0 ; n < sfxcachecount ; ++n)
+	if (sfxcache[n].hash == hash && sfxcache[n].size == size)
+	    sfxcache[n].keep = TRUE;
+}
+
+/* Stop using the sound cache file, after updating it if necessary.
+ */
+void closesfxcache(void)
+{
+    if (sfxcachefile && sfxcachedirty)
+	writesfxcache(sfxcachefile);
+    free(sfxcachefile);
+    free(sfxcache);
+    free(sfxcachedata);
+    sfxcachefile = NULL;
+    sfxcache = NULL;
+    sfxcachedata = NULL;
+    sfxcachecount = 0;
+    sfxcachedirty = FALSE;
+}
+
 /* Select the sounds effects to be played. sfx is a bitmask of sound
  * effect indexes. Any continuous sounds that are not included in sfx
  * are stopped. One-shot sounds that are included in sfx are
- * restarted.
+ * restarted. The changes are queued for the audio thread, so the
+ * caller never has to wait on it. If the queue is full, one-shot
+ * sounds are dropped, and changes to continuous sounds are tried
+ * again on the next call.
  */
 void playsoundeffects(unsigned long sfx)
 {
     unsigned long	flag;
     int			i;
 
+    if (_telemetryon && hasaudio)
+	reportcallbacktime();
     if (!hasaudio || !volume) {
 	displaysoundeffects(sfx, TRUE);
 	return;
     }
 
-    SDL_LockAudio();
     for (i = 0, flag = 1 ; i < SND_COUNT ; ++i, flag <<= 1) {
-	if (sfx & flag) {
-	    sounds[i].playing = TRUE;
-	    if (sounds[i].pos && i < SND_ONESHOT_COUNT)
-		sounds[i].pos = 0;
-	} else {
-	    if (i >= SND_ONESHOT_COUNT)
-		sounds[i].playing = FALSE;
+	if (i < SND_ONESHOT_COUNT) {
+	    if (sfx & flag)
+		queuesfxevent(i, TRUE);
+	} else if ((sfx ^ continuousplaying) & flag) {
+	    if (queuesfxevent(i, (sfx & flag) != 0))
+		continuousplaying ^= flag;
 	}
     }
-    SDL_UnlockAudio();
 }
 
 /* If action is negative, stop playing all sounds immediately.
@@ -295,12 +844,18 @@ void setsoundeffects(int action)
 	return;
 
     if (action < 0) {
-	SDL_LockAudio();
-	for (i = 0 ; i < SND_COUNT ; ++i) {
-	    sounds[i].playing = FALSE;
-	    sounds[i].pos = 0;
+	if (queuesfxevent(-1, FALSE)) {
+	    continuousplaying = 0;
+	} else {
+	    SDL_LockAudio();
+	    ringhead = ringtail = 0;
+	    for (i = 0 ; i < SND_COUNT ; ++i) {
+		sounds[i].playing = FALSE;
+		sounds[i].pos = 0;
+	    }
+	    continuousplaying = 0;
+	    SDL_UnlockAudio();
 	}
-	SDL_UnlockAudio();
     } else {
 	SDL_PauseAudio(!action);
     }
@@ -316,6 +871,7 @@ void freesfx(int index)
 	sounds[index].wave = NULL;
 	sounds[index].pos = 0;
 	sounds[index].playing = FALSE;
+	sounds[index].filesize = 0;
 	SDL_UnlockAudio();
     }
 }
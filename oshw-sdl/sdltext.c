@@ -12,6 +12,37 @@
 #include	"sdlgen.h"
 #include	"../err.h"
 
+/* The number of rendered lines of text kept in the cache.
+ */
+#define	TEXTCACHESIZE	128
+
+/* The number of rows at each end of a table, and the number of rows
+ * in between, that are measured when the table produces its rows on
+ * demand.
+ */
+#define	MEASUREDENDROWS	128
+#define	MEASUREDMIDROWS	256
+
+/* An entry in the cache of rendered lines of text. The pixels hold
+ * h scanlines in the screen's format, each being the left padding,
+ * the text, and the right padding, in that order.
+ */
+typedef	struct textcacheentry {
+    unsigned char      *text;		/* a copy of the text */
+    int			len;		/* the length of the text */
+    Uint32		clr[3];		/* the colors used to render it */
+    short		l, w, r;	/* the widths of the three parts */
+    short		bpp;		/* the bytes per pixel */
+    Uint32		hash;		/* the hash value of the above */
+    unsigned char      *pixels;		/* the rendered pixels */
+} textcacheentry;
+
+/* The cache of rendered lines of text. The cache is two-way set
+ * associative, and the more recently used entry of a set comes
+ * first.
+ */
+static textcacheentry	textcache[TEXTCACHESIZE];
+
 /* Accept a bitmap as an 8-bit SDL surface and from it extract the
  * glyphs of a font. (See the documentation included in the Tile World
  * distribution for specifics regarding the bitmap layout.)
@@ -216,36 +247,146 @@ static void *drawtextscanline32(Uint32 *scanline, int w, int y, Uint32 *clr,
 				unsigned char const *text, int len)
 {
     unsigned char const	       *glyph;
-    int				n, x;
+    int				n, x, gw;
 
-    for (n = 0 ; n < len ; ++n) {
+    for (n = 0 ; n < len && w ; ++n) {
+	gw = sdlg.font.w[text[n]];
 	glyph = sdlg.font.bits[text[n]];
-	glyph += y * sdlg.font.w[text[n]];
-	for (x = 0 ; w && x < sdlg.font.w[text[n]] ; ++x, --w)
+	glyph += y * gw;
+	if (gw > w)
+	    gw = w;
+	for (x = 0 ; x < gw ; ++x)
 	    scanline[x] = clr[glyph[x]];
-	scanline += x;
+	scanline += gw;
+	w -= gw;
     }
     while (w--)
 	*scanline++ = clr[0];
     return scanline;
 }
 
+/*
+ * The cache of rendered text.
+ */
+
+/* Empty the cache of rendered text.
+ */
+static void freetextcache(void)
+{
+    int	n;
+
+    for (n = 0 ; n < TEXTCACHESIZE ; ++n) {
+	free(textcache[n].text);
+	free(textcache[n].pixels);
+    }
+    memset(textcache, 0, sizeof textcache);
+}
+
+/* Return TRUE if the cache entry holds the given line of text.
+ */
+static int matchtextcacheentry(textcacheentry const *entry, Uint32 hash,
+			       unsigned char const *text, int len,
+			       Uint32 const *clr, int l, int w, int r)
+{
+    return entry->pixels && entry->hash == hash && entry->len == len
+			 && entry->l == l && entry->w == w && entry->r == r
+			 && entry->bpp == sdlg.screen->format->BytesPerPixel
+			 && entry->clr[0] == clr[0] && entry->clr[1] == clr[1]
+			 && entry->clr[2] == clr[2]
+			 && (!len || !memcmp(entry->text, text, len));
+}
+
+/* Return the pixels of a line of text with l pixels of padding on
+ * the left, w pixels of text, and r pixels of padding on the right.
+ * The pixels are taken from the cache if they are there; otherwise
+ * the less recently used entry of their set is replaced with a newly
+ * rendered line.
+ */
+static unsigned char const *getrenderedtext(unsigned char const *text,
+					    int len, Uint32 *clr,
+					    int l, int w, int r)
+{
+    textcacheentry     *entry;
+    textcacheentry	temp;
+    unsigned char      *p;
+    Uint32		hash;
+    int			bpp, pitch, n, y;
+
+    hash = 2166136261UL;
+    for (n = 0 ; n < len ; ++n)
+	hash = (hash ^ text[n]) * 16777619UL;
+    hash ^= (Uint32)(l * 7 + w * 3 + r) ^ clr[1];
+    entry = textcache + (hash % (TEXTCACHESIZE / 2)) * 2;
+    if (matchtextcacheentry(entry, hash, text, len, clr, l, w, r))
+	return entry[0].pixels;
+
+    if (!matchtextcacheentry(entry + 1, hash, text, len, clr, l, w, r)) {
+	bpp = sdlg.screen->format->BytesPerPixel;
+	pitch = (l + w + r) * bpp;
+	free(entry[1].pixels);
+	entry[1].pixels = NULL;
+	xalloc(entry[1].pixels, pitch * sdlg.font.h + 1);
+	xalloc(entry[1].text, len + 1);
+	if (len)
+	    memcpy(entry[1].text, text, len);
+	entry[1].len = len;
+	entry[1].clr[0] = clr[0];
+	entry[1].clr[1] = clr[1];
+	entry[1].clr[2] = clr[2];
+	entry[1].l = l;
+	entry[1].w = w;
+	entry[1].r = r;
+	entry[1].bpp = bpp;
+	entry[1].hash = hash;
+	p = entry[1].pixels;
+	for (y = 0 ; y < sdlg.font.h ; ++y, p += pitch) {
+	    switch (bpp) {
+	      case 1:
+		drawtextscanline8(p, l, y, clr, NULL, 0);
+		drawtextscanline8(p + l, w, y, clr, text, len);
+		drawtextscanline8(p + l + w, r, y, clr, NULL, 0);
+		break;
+	      case 2:
+		drawtextscanline16((Uint16*)p, l, y, clr, NULL, 0);
+		drawtextscanline16((Uint16*)p + l, w, y, clr, text, len);
+		drawtextscanline16((Uint16*)p + l + w, r, y, clr, NULL, 0);
+		break;
+	      case 3:
+		drawtextscanline24(p, l, y, clr, NULL, 0);
+		drawtextscanline24(p + l * 3, w, y, clr, text, len);
+		drawtextscanline24(p + (l + w) * 3, r, y, clr, NULL, 0);
+		break;
+	      case 4:
+		drawtextscanline32((Uint32*)p, l, y, clr, NULL, 0);
+		drawtextscanline32((Uint32*)p + l, w, y, clr, text, len);
+		drawtextscanline32((Uint32*)p + l + w, r, y, clr, NULL, 0);
+		break;
+	    }
+	}
+    }
+    temp = entry[0];
+    entry[0] = entry[1];
+    entry[1] = temp;
+    return entry[0].pixels;
+}
+
 /*
  * The main font-rendering functions.
  */
 
 /* Draw a single line of text to the screen at the position given by
  * rect. The bitflags in the final argument control the placement of
- * text within rect and what colors to use.
+ * text within rect and what colors to use. The rendered line is
+ * copied from the cache of rendered text.
  */
 static void drawtext(SDL_Rect *rect, unsigned char const *text,
 		     int len, int flags)
 {
-    Uint32     *clr;
-    void       *p;
-    void       *q;
-    int		l, r;
-    int		pitch, bpp, n, w, y;
+    Uint32		       *clr;
+    unsigned char const	       *src;
+    unsigned char	       *p;
+    int				l, r;
+    int				pitch, bpp, n, w, y;
 
     if (len < 0)
 	len = text ? strlen((char const*)text) : 0;
@@ -286,33 +427,15 @@ static void drawtext(SDL_Rect *rect, unsigned char const *text,
     else
 	clr = sdlg.textclr.c;
 
+    src = getrenderedtext(text, len, clr, l, w, r);
     pitch = sdlg.screen->pitch;
     bpp = sdlg.screen->format->BytesPerPixel;
     p = (unsigned char*)sdlg.screen->pixels + rect->y * pitch + rect->x * bpp;
+    n = (l + w + r) * bpp;
     for (y = 0 ; y < sdlg.font.h && y < rect->h ; ++y) {
-	switch (bpp) {
-	  case 1:
-	    q = drawtextscanline8(p, l, y, clr, NULL, 0);
-	    q = drawtextscanline8(q, w, y, clr, text, len);
-	    q = drawtextscanline8(q, r, y, clr, NULL, 0);
-	    break;
-	  case 2:
-	    q = drawtextscanline16(p, l, y, clr, NULL, 0);
-	    q = drawtextscanline16(q, w, y, clr, text, len);
-	    q = drawtextscanline16(q, r, y, clr, NULL, 0);
-	    break;
-	  case 3:
-	    q = drawtextscanline24(p, l, y, clr, NULL, 0);
-	    q = drawtextscanline24(q, w, y, clr, text, len);
-	    q = drawtextscanline24(q, r, y, clr, NULL, 0);
-	    break;
-	  case 4:
-	    q = drawtextscanline32(p, l, y, clr, NULL, 0);
-	    q = drawtextscanline32(q, w, y, clr, text, len);
-	    q = drawtextscanline32(q, r, y, clr, NULL, 0);
-	    break;
-	}
-	p = (unsigned char*)p + pitch;
+	memcpy(p, src, n);
+	src += n;
+	p += pitch;
     }
 
     if (flags & PT_UPDATERECT) {
@@ -410,6 +533,25 @@ static void _puttext(SDL_Rect *rect, char const *text, int len, int flags)
 	SDL_UnlockSurface(sdlg.screen);
 }
 
+/* Return the row of the table to measure after row j. A table that
+ * produces its rows on demand and has too many of them to measure
+ * them all quickly is measured from the rows at either end plus an
+ * even sample of the rows in between.
+ */
+static int nextmeasuredrow(tablespec const *table, int j)
+{
+    int	last;
+
+    last = table->rows - MEASUREDENDROWS;
+    if (!table->getrow || table->rows <= 2 * MEASUREDENDROWS
+					 + MEASUREDMIDROWS)
+	return j + 1;
+    if (j < MEASUREDENDROWS || j >= last)
+	return j + 1;
+    j += (last - MEASUREDENDROWS) / MEASUREDMIDROWS;
+    return j < last ? j : last;
+}
+
 /* Lay out the columns of the given table so that the entire table
  * fits within area (horizontally; no attempt is made to make it fit
  * vertically). Return an array of rectangles, one per column. This
@@ -419,12 +561,16 @@ static void _puttext(SDL_Rect *rect, char const *text, int len, int flags)
 static SDL_Rect *_measuretable(SDL_Rect const *area, tablespec const *table)
 {
     SDL_Rect		       *colsizes;
+    char const		      **cells;
+    char const * const	       *row;
     unsigned char const	       *p;
     int				sep, mlindex, mlwidth, diff;
-    int				i, j, n, i0, c, w, x;
+    int				i, j, k, n, i0, c, w, x;
 
     if (!(colsizes = malloc(table->cols * sizeof *colsizes)))
 	memerrexit();
+    if (!(cells = malloc(table->cols * sizeof *cells)))
+	memerrexit();
     for (i = 0 ; i < table->cols ; ++i) {
 	colsizes[i].x = 0;
 	colsizes[i].y = area->y;
@@ -435,15 +581,18 @@ static SDL_Rect *_measuretable(SDL_Rect const *area, tablespec const *table)
     mlindex = -1;
     mlwidth = 0;
     n = 0;
-    for (j = 0 ; j < table->rows ; ++j) {
-	for (i = 0 ; i < table->cols ; ++n) {
-	    c = table->items[n][0] - '0';
+    for (j = 0 ; j < table->rows ; j = nextmeasuredrow(table, j)) {
+	if (table->getrow)
+	    n = j;
+	row = gettablerow(table, &n, cells);
+	for (i = 0, k = 0 ; i < table->cols ; ++k) {
+	    c = row[k][0] - '0';
 	    if (c == 1) {
 		w = 0;
-		p = (unsigned char const*)table->items[n];
+		p = (unsigned char const*)row[k];
 		for (p += 2 ; *p ; ++p)
 		    w += sdlg.font.w[*p];
-		if (table->items[n][1] == '!') {
+		if (row[k][1] == '!') {
 		    if (w > mlwidth || mlindex != i)
 			mlwidth = w;
 		    mlindex = i;
@@ -471,12 +620,16 @@ static SDL_Rect *_measuretable(SDL_Rect const *area, tablespec const *table)
 
     if (diff > 0) {
 	n = 0;
-	for (j = 0 ; j < table->rows && diff > 0 ; ++j) {
-	    for (i = 0 ; i < table->cols ; ++n) {
-		c = table->items[n][0] - '0';
-		if (c > 1 && table->items[n][1] != '!') {
+	for (j = 0 ; j < table->rows && diff > 0
+		   ; j = nextmeasuredrow(table, j)) {
+	    if (table->getrow)
+		n = j;
+	    row = gettablerow(table, &n, cells);
+	    for (i = 0, k = 0 ; i < table->cols ; ++k) {
+		c = row[k][0] - '0';
+		if (c > 1 && row[k][1] != '!') {
 		    w = sep;
-		    p = (unsigned char const*)table->items[n];
+		    p = (unsigned char const*)row[k];
 		    for (p += 2 ; *p ; ++p)
 			w += sdlg.font.w[*p];
 		    for (i0 = i ; i0 < i + c ; ++i0)
@@ -519,6 +672,7 @@ static SDL_Rect *_measuretable(SDL_Rect const *area, tablespec const *table)
 	colsizes[i].w = 0;
     }
 
+    free(cells);
     return colsizes;
 }
 
@@ -529,21 +683,30 @@ static int _drawtablerow(tablespec const *table, SDL_Rect *cols,
 			 int *row, int flags)
 {
     SDL_Rect			rect;
+    char const		      **cells;
+    char const * const	       *items;
     unsigned char const	       *p;
     int				c, f, n, i, y;
 
     if (!cols) {
-	for (i = 0 ; i < table->cols ; i += table->items[(*row)++][0] - '0') ;
+	if (table->getrow)
+	    ++*row;
+	else
+	    for (i = 0 ; i < table->cols ;
+			 i += table->items[(*row)++][0] - '0') ;
 	return TRUE;
     }
 
+    if (!(cells = malloc(table->cols * sizeof *cells)))
+	memerrexit();
+    items = gettablerow(table, row, cells);
+
     if (SDL_MUSTLOCK(sdlg.screen))
 	SDL_LockSurface(sdlg.screen);
 
     y = cols[0].y;
-    n = *row;
-    for (i = 0 ; i < table->cols ; ++n) {
-	p = (unsigned char const*)table->items[n];
+    for (i = 0, n = 0 ; i < table->cols ; ++n) {
+	p = (unsigned char const*)items[n];
 	c = p[0] - '0';
 	rect = cols[i];
 	i += c;
@@ -565,7 +728,7 @@ static int _drawtablerow(tablespec const *table, SDL_Rect *cols,
     if (SDL_MUSTLOCK(sdlg.screen))
 	SDL_UnlockSurface(sdlg.screen);
 
-    *row = n;
+    free(cells);
     for (i = 0 ; i < table->cols ; ++i) {
 	cols[i].h -= y - cols[i].y;
 	cols[i].y = y;
@@ -578,6 +741,7 @@ static int _drawtablerow(tablespec const *table, SDL_Rect *cols,
  */
 void freefont(void)
 {
+    freetextcache();
     if (sdlg.font.h) {
 	free(sdlg.font.memory);
 	sdlg.font.memory = NULL;
@@ -201,9 +201,28 @@ static int		surfacesallocated = 0;
  */
 static tilemap		tileptr[NTILES];
 
-/* An internal buffer surface.
+/* The number of entries in the cache of composed cell images. The
+ * cache is two-way set-associative, so this must be an even number.
  */
-static SDL_Surface     *opaquetile = NULL;
+#define	CELLCACHESIZE	256
+
+/* The cache of composed cell images. A cell whose top tile is
+ * transparent is drawn by compositing the top tile over the bottom
+ * tile, and the result is kept here, identified by the two tiles and
+ * their animation frames. Each pair of entries forms a set, and the
+ * first entry of a set is always the more recently used one, so that
+ * the second entry is the one replaced on a miss. An entry with a
+ * NULL image has not been used yet.
+ */
+typedef	struct cellcacheentry {
+    SDL_Surface	       *image;		/* the composed image */
+    unsigned char	top;		/* the top tile */
+    unsigned char	bot;		/* the bottom tile */
+    unsigned char	ntop;		/* the top tile's animation frame */
+    unsigned char	nbot;		/* the bottom tile's animation frame */
+} cellcacheentry;
+
+static cellcacheentry	cellcache[CELLCACHESIZE];
 
 /* Create a fresh surface. If transparency is true, the surface is
  * created with 32-bit pixels, so as to ensure a complete alpha
@@ -280,8 +299,7 @@ static int settilesize(int w, int h)
     sdlg.wtile = w;
     sdlg.htile = h;
     sdlg.cptile = w * h;
-    opaquetile = newsurface(w, h, FALSE);
-    remembersurface(opaquetile);
+    memset(cellcache, 0, sizeof cellcache);
     return TRUE;
 }
 
@@ -354,17 +372,58 @@ static SDL_Surface *_getcreatureimage(SDL_Rect *rect,
     return s;
 }
 
+/* Return the composed image of the top tile over the bottom tile,
+ * using the given animation frames. The image is taken from the cache
+ * if it is there; otherwise the least recently used entry of its set
+ * is replaced with a newly composed image.
+ */
+static SDL_Surface *getcomposedcell(int top, int bot, int nt, int nb)
+{
+    cellcacheentry     *entry;
+    cellcacheentry	temp;
+
+    entry = cellcache + (((top * 37 + bot * 11 + nt * 5 + nb) * 2)
+						% CELLCACHESIZE);
+    if (entry[0].image && entry[0].top == top && entry[0].bot == bot
+		       && entry[0].ntop == nt && entry[0].nbot == nb)
+	return entry[0].image;
+
+    if (!(entry[1].image && entry[1].top == top && entry[1].bot == bot
+			 && entry[1].ntop == nt && entry[1].nbot == nb)) {
+	if (!entry[1].image) {
+	    entry[1].image = newsurface(sdlg.wtile, sdlg.htile, FALSE);
+	    remembersurface(entry[1].image);
+	}
+	if (tileptr[bot].opaque[nb]) {
+	    SDL_BlitSurface(tileptr[bot].opaque[nb], NULL,
+			    entry[1].image, NULL);
+	} else {
+	    SDL_BlitSurface(tileptr[Empty].opaque[0], NULL,
+			    entry[1].image, NULL);
+	    addtransparenttile(entry[1].image, bot, nb);
+	}
+	addtransparenttile(entry[1].image, top, nt);
+	entry[1].top = top;
+	entry[1].bot = bot;
+	entry[1].ntop = nt;
+	entry[1].nbot = nb;
+    }
+    temp = entry[0];
+    entry[0] = entry[1];
+    entry[1] = temp;
+    return entry[0].image;
+}
+
 /* Return an image of a cell with the given tiles. If the top tile is
- * transparent, the appropriate composite image is constructed in the
- * overlay buffer. (If the top tile is opaque but has transparent
- * pixels, the image returned is constructed in a private surface). If
- * rect is not NULL, the width and height fields are filled in.
+ * transparent, the appropriate composite image is taken from the
+ * cache of composed cells. (If the top tile is opaque but has
+ * transparent pixels, it is composed over an empty tile.) If rect is
+ * not NULL, the width and height fields are filled in.
  */
 static SDL_Surface *_getcellimage(SDL_Rect *rect,
 				  int top, int bot, int timerval)
 {
-    SDL_Surface	       *dest;
-    int			nt, nb;
+    int	nt, nb;
 
     if (!tileptr[top].celcount)
 	die("map element %02X has no suitable image", top);
@@ -378,24 +437,20 @@ static SDL_Surface *_getcellimage(SDL_Rect *rect,
     if (bot == Nothing || bot == Empty || !tileptr[top].transp[0]) {
 	if (tileptr[top].opaque[nt])
 	    return tileptr[top].opaque[nt];
-	SDL_BlitSurface(tileptr[Empty].opaque[0], NULL, opaquetile, NULL);
-	addtransparenttile(opaquetile, top, nt);
-	return opaquetile;
+	return getcomposedcell(top, Empty, nt, 0);
     }
 
     if (!tileptr[bot].celcount)
 	die("map element %02X has no suitable image", bot);
     nb = (timerval + 1) % tileptr[bot].celcount;
-    dest = tileptr[Overlay_Buffer].opaque[0];
-    if (tileptr[bot].opaque[nb]) {
-	SDL_BlitSurface(tileptr[bot].opaque[nb], NULL, dest, NULL);
-    } else {
-	SDL_BlitSurface(tileptr[Empty].opaque[0], NULL, dest, NULL);
-	addtransparenttile(dest, bot, nb);
-    }
-    addtransparenttile(dest, top, nt);
+    return getcomposedcell(top, bot, nt, nb);
+}
 
-    return dest;
+/* Return TRUE if the given cell tile has more than one image.
+ */
+static int _iscellanimated(int id)
+{
+    return tileptr[id].celcount > 1;
 }
 
 /*
@@ -446,6 +501,138 @@ static SDL_Surface *extractopaquetile(SDL_Surface *src,
     return dest;
 }
 
+/* Return a buffer of w * h flags, one per pixel of the given area of
+ * the surface, which are non-zero for the pixels that have the color
+ * key. The rows are scanned with a separate loop for each pixel size,
+ * so that the pixel format is not consulted for every pixel. (The
+ * surface must be locked before calling this function.) The caller
+ * must free the returned buffer.
+ */
+static Uint8 *getkeymask(SDL_Surface *s, int xpos, int ypos, int w, int h,
+			 Uint32 key)
+{
+    Uint8	       *mask = NULL;
+    Uint8	       *m;
+    Uint8 const	       *row;
+    Uint8		k0, k1, k2;
+    int			x, y;
+
+    xalloc(mask, w * h);
+    m = mask;
+    row = (Uint8*)s->pixels + ypos * s->pitch
+			    + xpos * s->format->BytesPerPixel;
+    switch (s->format->BytesPerPixel) {
+      case 1:
+	for (y = 0 ; y < h ; ++y, row += s->pitch, m += w)
+	    for (x = 0 ; x < w ; ++x)
+		m[x] = row[x] == key;
+	break;
+      case 2:
+	for (y = 0 ; y < h ; ++y, row += s->pitch, m += w)
+	    for (x = 0 ; x < w ; ++x)
+		m[x] = ((Uint16 const*)row)[x] == key;
+	break;
+      case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	k0 = (Uint8)(key >> 16);
+	k1 = (Uint8)(key >> 8);
+	k2 = (Uint8)key;
+#else
+	k0 = (Uint8)key;
+	k1 = (Uint8)(key >> 8);
+	k2 = (Uint8)(key >> 16);
+#endif
+	for (y = 0 ; y < h ; ++y, row += s->pitch, m += w)
+	    for (x = 0 ; x < w ; ++x)
+		m[x] = (row[x * 3] == k0) & (row[x * 3 + 1] == k1)
+					  & (row[x * 3 + 2] == k2);
+	break;
+      case 4:
+	for (y = 0 ; y < h ; ++y, row += s->pitch, m += w)
+	    for (x = 0 ; x < w ; ++x)
+		m[x] = ((Uint32 const*)row)[x] == key;
+	break;
+      default:
+	memset(mask, 0, w * h);
+	break;
+    }
+    return mask;
+}
+
+/* Set the pixels of the given 32-bit surface that are flagged in mask
+ * to the color transp. (The surface must be locked before calling
+ * this function.)
+ */
+static void maskpixels(SDL_Surface *s, Uint8 const *mask, Uint32 transp)
+{
+    Uint8      *row;
+    int		x, y;
+
+    row = (Uint8*)s->pixels;
+    for (y = 0 ; y < s->h ; ++y, row += s->pitch, mask += s->w)
+	for (x = 0 ; x < s->w ; ++x)
+	    if (mask[x])
+		((Uint32*)row)[x] = transp;
+}
+
+/* Replace the pixels of dest that are flagged in mask with the
+ * corresponding pixels of bkgnd, which must have the same pixel size
+ * and be at least as large. If bkgnd is NULL, the pixels are cleared
+ * instead. (Both surfaces must be locked before calling this
+ * function.)
+ */
+static void restorepixels(SDL_Surface *dest, Uint8 const *mask,
+			  SDL_Surface *bkgnd)
+{
+    Uint8	       *row;
+    Uint8 const	       *brow;
+    int			x, y;
+
+    row = (Uint8*)dest->pixels;
+    if (!bkgnd) {
+	for (y = 0 ; y < dest->h ; ++y, row += dest->pitch, mask += dest->w)
+	    for (x = 0 ; x < dest->w ; ++x)
+		if (mask[x])
+		    memset(row + x * dest->format->BytesPerPixel, 0,
+			   dest->format->BytesPerPixel);
+	return;
+    }
+    brow = (Uint8 const*)bkgnd->pixels;
+    switch (dest->format->BytesPerPixel) {
+      case 1:
+	for (y = 0 ; y < dest->h ; ++y, row += dest->pitch,
+				  brow += bkgnd->pitch, mask += dest->w)
+	    for (x = 0 ; x < dest->w ; ++x)
+		if (mask[x])
+		    row[x] = brow[x];
+	break;
+      case 2:
+	for (y = 0 ; y < dest->h ; ++y, row += dest->pitch,
+				  brow += bkgnd->pitch, mask += dest->w)
+	    for (x = 0 ; x < dest->w ; ++x)
+		if (mask[x])
+		    ((Uint16*)row)[x] = ((Uint16 const*)brow)[x];
+	break;
+      case 3:
+	for (y = 0 ; y < dest->h ; ++y, row += dest->pitch,
+				  brow += bkgnd->pitch, mask += dest->w)
+	    for (x = 0 ; x < dest->w ; ++x)
+		if (mask[x]) {
+		    row[x * 3] = brow[x * 3];
+		    row[x * 3 + 1] = brow[x * 3 + 1];
+		    row[x * 3 + 2] = brow[x * 3 + 2];
+		}
+	break;
+      case 4:
+	for (y = 0 ; y < dest->h ; ++y, row += dest->pitch,
+				  brow += bkgnd->pitch, mask += dest->w)
+	    for (x = 0 ; x < dest->w ; ++x)
+		if (mask[x])
+		    ((Uint32*)row)[x] = ((Uint32 const*)brow)[x];
+	break;
+    }
+}
+
 /* Create a new surface containing a single tile with transparent
  * pixels, as indicated by the given color key.
  */
@@ -456,17 +643,27 @@ static SDL_Surface *extractkeyedtile(SDL_Surface *src,
     SDL_Surface	       *dest;
     SDL_Surface	       *temp;
     SDL_Rect		rect;
+    Uint8	       *mask;
 
     dest = newsurface(wimg, himg, TRUE);
-    SDL_FillRect(dest, NULL, SDL_MapRGBA(dest->format,
-					 0, 0, 0, SDL_ALPHA_TRANSPARENT));
-    SDL_SetColorKey(src, SDL_SRCCOLORKEY, transpclr);
     rect.x = ximg;
     rect.y = yimg;
     rect.w = dest->w;
     rect.h = dest->h;
     SDL_BlitSurface(src, &rect, dest, NULL);
-    SDL_SetColorKey(src, 0, 0);
+
+    if (SDL_MUSTLOCK(src))
+	SDL_LockSurface(src);
+    if (SDL_MUSTLOCK(dest))
+	SDL_LockSurface(dest);
+    mask = getkeymask(src, ximg, yimg, dest->w, dest->h, transpclr);
+    maskpixels(dest, mask, SDL_MapRGBA(dest->format,
+				       0, 0, 0, SDL_ALPHA_TRANSPARENT));
+    free(mask);
+    if (SDL_MUSTLOCK(src))
+	SDL_UnlockSurface(src);
+    if (SDL_MUSTLOCK(dest))
+	SDL_UnlockSurface(dest);
 
     temp = dest;
     dest = SDL_DisplayFormatAlpha(temp);
@@ -487,19 +684,45 @@ static SDL_Surface *extractemptytile(SDL_Surface *src,
 {
     SDL_Surface	       *dest;
     SDL_Surface	       *temp;
+    SDL_Surface	       *empty;
     SDL_Rect		rect;
+    Uint8	       *mask;
 
     dest = newsurface(wimg, himg, FALSE);
-
-    if (tileptr[Empty].opaque[0])
-	SDL_BlitSurface(tileptr[Empty].opaque[0], NULL, dest, NULL);
-    SDL_SetColorKey(src, SDL_SRCCOLORKEY, transpclr);
     rect.x = ximg;
     rect.y = yimg;
     rect.w = dest->w;
     rect.h = dest->h;
     SDL_BlitSurface(src, &rect, dest, NULL);
-    SDL_SetColorKey(src, 0, 0);
+
+    empty = tileptr[Empty].opaque[0];
+    if (empty && (empty->w < dest->w || empty->h < dest->h
+			|| empty->format->BytesPerPixel
+					!= dest->format->BytesPerPixel)) {
+	temp = newsurface(dest->w, dest->h, FALSE);
+	SDL_BlitSurface(empty, NULL, temp, NULL);
+	empty = temp;
+    } else {
+	temp = NULL;
+    }
+
+    if (SDL_MUSTLOCK(src))
+	SDL_LockSurface(src);
+    if (SDL_MUSTLOCK(dest))
+	SDL_LockSurface(dest);
+    if (empty && SDL_MUSTLOCK(empty))
+	SDL_LockSurface(empty);
+    mask = getkeymask(src, ximg, yimg, dest->w, dest->h, transpclr);
+    restorepixels(dest, mask, empty);
+    free(mask);
+    if (empty && SDL_MUSTLOCK(empty))
+	SDL_UnlockSurface(empty);
+    if (SDL_MUSTLOCK(src))
+	SDL_UnlockSurface(src);
+    if (SDL_MUSTLOCK(dest))
+	SDL_UnlockSurface(dest);
+    if (temp)
+	SDL_FreeSurface(temp);
 
     temp = dest;
     dest = SDL_DisplayFormat(temp);
@@ -519,9 +742,7 @@ static SDL_Surface *extractmaskedtile(SDL_Surface *src,
     SDL_Surface	       *dest;
     SDL_Surface	       *temp;
     SDL_Rect		rect;
-    unsigned char      *s, *d;
-    Uint32		transp, black;
-    int			x, y;
+    Uint8	       *mask;
 
     rect.x = ximg;
     rect.y = yimg;
@@ -530,24 +751,15 @@ static SDL_Surface *extractmaskedtile(SDL_Surface *src,
     dest = newsurface(rect.w, rect.h, TRUE);
     SDL_BlitSurface(src, &rect, dest, NULL);
 
-    black = SDL_MapRGB(src->format, 0, 0, 0);
-    transp = SDL_MapRGBA(dest->format, 0, 0, 0, SDL_ALPHA_TRANSPARENT);
-
     if (SDL_MUSTLOCK(src))
 	SDL_LockSurface(src);
     if (SDL_MUSTLOCK(dest))
 	SDL_LockSurface(dest);
-    d = (Uint8*)dest->pixels;
-    s = (Uint8*)src->pixels + ymask * src->pitch
-			    + xmask * src->format->BytesPerPixel;
-    for (y = 0 ; y < dest->h ; ++y) {
-	for (x = 0 ; x < dest->w ; ++x) {
-	    if (pixelat(src, xmask + x, ymask + y) == black)
-		((Uint32*)d)[x] = transp;
-	}
-	s += src->pitch;
-	d += dest->pitch;
-    }
+    mask = getkeymask(src, xmask, ymask, dest->w, dest->h,
+		      SDL_MapRGB(src->format, 0, 0, 0));
+    maskpixels(dest, mask, SDL_MapRGBA(dest->format,
+				       0, 0, 0, SDL_ALPHA_TRANSPARENT));
+    free(mask);
     if (SDL_MUSTLOCK(src))
 	SDL_UnlockSurface(src);
     if (SDL_MUSTLOCK(dest))
@@ -1038,6 +1250,231 @@ static int initlargetileset(SDL_Surface *tiles)
     return FALSE;
 }
 
+/*
+ * Caching the extracted tile images.
+ */
+
+/* The first word of a tile cache file. Since the file is written in
+ * the machine's own byte order, this also serves to reject a file
+ * written on a machine with a different byte order.
+ */
+#define	TILECACHE_SIG		0x54435754UL
+
+/* The version of the tile cache file format.
+ */
+#define	TILECACHE_VERSION	1
+
+/* The number of words in the header of a tile cache file.
+ */
+#define	TILECACHE_HEADERSIZE	12
+
+/* Fill in the header of a tile cache file, which identifies the
+ * tileset file and the display's pixel format.
+ */
+static void maketilecacheheader(Uint32 *header, Uint32 hash, Uint32 size)
+{
+    header[0] = TILECACHE_SIG;
+    header[1] = TILECACHE_VERSION;
+    header[2] = size;
+    header[3] = hash;
+    header[4] = sdlg.screen->format->BitsPerPixel;
+    header[5] = sdlg.screen->format->Rmask;
+    header[6] = sdlg.screen->format->Gmask;
+    header[7] = sdlg.screen->format->Bmask;
+    header[8] = sdlg.screen->format->Amask;
+    header[9] = sdlg.wtile;
+    header[10] = sdlg.htile;
+    header[11] = surfacesused;
+}
+
+/* Return the index of the given surface in the heap, or -1 if the
+ * surface is NULL or absent.
+ */
+static int surfaceindex(SDL_Surface const *s)
+{
+    int	n;
+
+    if (s)
+	for (n = 0 ; n < surfacesused ; ++n)
+	    if (surfaceheap[n] == s)
+		return n;
+    return -1;
+}
+
+/* Write the current tile images to a cache file, identified by the
+ * given hash and size of the tileset file. Each surface on the heap
+ * is stored with its format and pixels, followed by the tile
+ * directory with the surfaces given as indexes into the heap.
+ */
+static int writetilecache(char const *filename, Uint32 hash, Uint32 size)
+{
+    FILE	       *fp;
+    SDL_Surface	       *s;
+    Uint32		header[TILECACHE_HEADERSIZE];
+    Uint32		info[6];
+    Sint32		idx[34];
+    int			f, m, n, y;
+
+    if (!(fp = fopen(filename, "wb")))
+	return FALSE;
+    maketilecacheheader(header, hash, size);
+    f = fwrite(header, sizeof header, 1, fp) == 1;
+    for (n = 0 ; f && n < surfacesused ; ++n) {
+	s = surfaceheap[n];
+	info[0] = s->w;
+	info[1] = s->h;
+	info[2] = s->format->BitsPerPixel;
+	info[3] = s->format->Rmask;
+	info[4] = s->format->Gmask;
+	info[5] = s->format->Bmask;
+	f = fwrite(info, sizeof info, 1, fp) == 1;
+	info[0] = s->format->Amask;
+	info[1] = s->flags & SDL_SRCALPHA;
+	f = f && fwrite(info, sizeof *info, 2, fp) == 2;
+	if (SDL_MUSTLOCK(s))
+	    SDL_LockSurface(s);
+	for (y = 0 ; f && y < s->h ; ++y)
+	    f = fwrite((Uint8*)s->pixels + y * s->pitch,
+		       s->w * s->format->BytesPerPixel, 1, fp) == 1;
+	if (SDL_MUSTLOCK(s))
+	    SDL_UnlockSurface(s);
+    }
+    for (n = 0 ; f && n < NTILES ; ++n) {
+	idx[0] = tileptr[n].celcount;
+	idx[1] = tileptr[n].transpsize;
+	for (m = 0 ; m < 16 ; ++m) {
+	    idx[2 + m] = surfaceindex(tileptr[n].opaque[m]);
+	    idx[18 + m] = surfaceindex(tileptr[n].transp[m]);
+	    if ((tileptr[n].opaque[m] && idx[2 + m] < 0)
+			|| (tileptr[n].transp[m] && idx[18 + m] < 0))
+		f = FALSE;
+	}
+	f = f && fwrite(idx, sizeof idx, 1, fp) == 1;
+    }
+    if (fclose(fp) || !f) {
+	remove(filename);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/* Return TRUE if the pixel format of a surface stored in a cache file
+ * is one that this module creates: either the screen's own format, or
+ * 32-bit pixels with each channel in a separate byte.
+ */
+static int validcacheformat(Uint32 const *info)
+{
+    SDL_PixelFormat const      *fmt = sdlg.screen->format;
+    Uint32			used;
+    int				n;
+
+    if (info[2] == fmt->BitsPerPixel && info[3] == fmt->Rmask
+				     && info[4] == fmt->Gmask
+				     && info[5] == fmt->Bmask
+				     && info[6] == fmt->Amask)
+	return TRUE;
+    if (info[2] != 32)
+	return FALSE;
+    used = 0;
+    for (n = 3 ; n < 7 ; ++n) {
+	if (info[n] != 0xFF000000 && info[n] != 0x00FF0000
+				  && info[n] != 0x0000FF00
+				  && info[n] != 0x000000FF)
+	    return FALSE;
+	if (used & info[n])
+	    return FALSE;
+	used |= info[n];
+    }
+    return TRUE;
+}
+
+/* Replace the current tile images with those stored in a cache file.
+ * FALSE is returned if the file does not exist, is invalid, or does
+ * not match the given hash and size of the tileset file and the
+ * display's current pixel format.
+ */
+static int readtilecache(char const *filename, Uint32 hash, Uint32 size)
+{
+    FILE	       *fp;
+    SDL_Surface	       *s;
+    Uint32		header[TILECACHE_HEADERSIZE];
+    Uint32		expected[TILECACHE_HEADERSIZE];
+    Uint32		info[8];
+    Sint32		idx[34];
+    int			count, f, m, n, y;
+
+    if (!(fp = fopen(filename, "rb")))
+	return FALSE;
+    if (fread(header, sizeof header, 1, fp) != 1
+		|| header[9] % 4 || header[10] % 4
+		|| !header[9] || !header[10]) {
+	fclose(fp);
+	return FALSE;
+    }
+    maketilecacheheader(expected, hash, size);
+    expected[9] = header[9];
+    expected[10] = header[10];
+    if (memcmp(header, expected, sizeof header - sizeof *header)
+		|| header[11] > 65536) {
+	fclose(fp);
+	return FALSE;
+    }
+    freetileset();
+    count = header[11];
+    settilesize(header[9], header[10]);
+
+    f = TRUE;
+    for (n = 0 ; f && n < count ; ++n) {
+	if (fread(info, sizeof info, 1, fp) != 1 || info[0] > 4096
+						 || info[1] > 4096
+						 || !validcacheformat(info)) {
+	    f = FALSE;
+	    break;
+	}
+	s = SDL_CreateRGBSurface(SDL_SWSURFACE, info[0], info[1], info[2],
+				 info[3], info[4], info[5], info[6]);
+	if (!s) {
+	    f = FALSE;
+	    break;
+	}
+	remembersurface(s);
+	if (s->format->palette && sdlg.screen->format->palette)
+	    SDL_SetColors(s, sdlg.screen->format->palette->colors,
+			  0, sdlg.screen->format->palette->ncolors);
+	if (SDL_MUSTLOCK(s))
+	    SDL_LockSurface(s);
+	for (y = 0 ; f && y < s->h ; ++y)
+	    f = fread((Uint8*)s->pixels + y * s->pitch,
+		      s->w * s->format->BytesPerPixel, 1, fp) == 1;
+	if (SDL_MUSTLOCK(s))
+	    SDL_UnlockSurface(s);
+	if (info[7])
+	    SDL_SetAlpha(s, SDL_SRCALPHA | SDL_RLEACCEL, 0);
+    }
+    for (n = 0 ; f && n < NTILES ; ++n) {
+	if (fread(idx, sizeof idx, 1, fp) != 1 || idx[0] < 0 || idx[0] > 16) {
+	    f = FALSE;
+	    break;
+	}
+	tileptr[n].celcount = idx[0];
+	tileptr[n].transpsize = idx[1];
+	for (m = 0 ; m < 16 ; ++m) {
+	    if (idx[2 + m] >= count || idx[18 + m] >= count) {
+		f = FALSE;
+		break;
+	    }
+	    tileptr[n].opaque[m] = idx[2 + m] < 0 ? NULL
+						  : surfaceheap[idx[2 + m]];
+	    tileptr[n].transp[m] = idx[18 + m] < 0 ? NULL
+						   : surfaceheap[idx[18 + m]];
+	}
+    }
+    fclose(fp);
+    if (!f)
+	freetileset();
+    return f;
+}
+
 /*
  * The exported functions.
  */
@@ -1059,20 +1496,32 @@ void freetileset(void)
     sdlg.wtile = 0;
     sdlg.htile = 0;
     sdlg.cptile = 0;
-    opaquetile = NULL;
+    memset(cellcache, 0, sizeof cellcache);
     freerememberedsurfaces();
 }
 
 /* Load the set of tile images stored in the given bitmap. Error
  * messages will be displayed if complain is TRUE. The return value is
  * TRUE if the tiles were successfully identified and loaded into
- * memory.
+ * memory. If cachefilename is not NULL, the tiles are taken from that
+ * file when it holds the images extracted from this bitmap for the
+ * current display format; otherwise the cache file is rewritten after
+ * the tiles are extracted. (The cache is not used with a palette
+ * display, as the bitmap's palette is needed to set up the display.)
  */
-int loadtileset(char const *filename, int complain)
+int loadtileset(char const *filename, char const *cachefilename,
+		int complain)
 {
     SDL_Surface	       *tiles = NULL;
+    Uint32		hash, size;
     int			f, w, h;
 
+    if (sdlg.screen->format->palette
+		|| !_sdlhashfile(filename, &hash, &size))
+	cachefilename = NULL;
+    if (cachefilename && readtilecache(cachefilename, hash, size))
+	return TRUE;
+
     tiles = SDL_LoadBMP(filename);
     if (!tiles) {
 	if (complain)
@@ -1104,6 +1553,8 @@ int loadtileset(char const *filename, int complain)
     }
 
     SDL_FreeSurface(tiles);
+    if (f && cachefilename)
+	writetilecache(cachefilename, hash, size);
     return f;
 }
 
@@ -1113,5 +1564,6 @@ int _sdltileinitialize(void)
 {
     sdlg.getcreatureimagefunc = _getcreatureimage;
     sdlg.getcellimagefunc = _getcellimage;
+    sdlg.iscellanimatedfunc = _iscellanimated;
     return TRUE;
 }
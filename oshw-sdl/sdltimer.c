@@ -4,35 +4,144 @@
  * License. No warranty. See COPYING for details.
  */
 
+#include	<stdio.h>
 #include	<stdlib.h>
+#include	<time.h>
+#include	<errno.h>
 #include	"SDL.h"
 #include	"sdlgen.h"
 
+/* Use the POSIX monotonic clock when it is available, and SDL's
+ * millisecond counter otherwise.
+ */
+#if defined CLOCK_MONOTONIC && !defined WIN32
+#define	USE_MONOTONIC_CLOCK
+#endif
+
+/* How long before a tick the program stops sleeping and spins
+ * instead, in microseconds. Waking up from a sleep is never exact,
+ * so the last stretch is done by polling the clock.
+ */
+#define	SPINTIME	1000
+
+/* How often the program wakes up while sleeping to collect input
+ * events, in microseconds, so that the events are timestamped close
+ * to when they happened.
+ */
+#define	INPUTPOLLTIME	4000
+
 /* By default, a second of game time lasts for 1000 milliseconds of
  * real time.
  */
-static int	mspertick = 1000 / TICKS_PER_SECOND;
+static unsigned long	uspertick = 1000000 / TICKS_PER_SECOND;
 
 /* The tick counter.
  */
 static int	utick = 0;
 
-/* The time of the next tick.
+/* The state of the timer.
+ */
+enum { Timer_Stopped, Timer_Paused, Timer_Running };
+static int	timerstate = Timer_Stopped;
+
+/* The time of the next tick, in microseconds. While the timer is
+ * paused, this holds the time remaining until the next tick instead.
+ * Times are compared by their difference, so that the counter may
+ * safely wrap around.
+ */
+static unsigned long	nexttickat = 0;
+
+/* The most ticks that the timer will fall behind before giving up on
+ * the missed ticks. A negative value means no limit.
  */
-static int	nexttickat = 0;
+static int	maxcatchup = -1;
+
+/* The time between frames drawn in between ticks, in microseconds,
+ * or zero if frames are only drawn on ticks, and the time of the last
+ * frame. Every tick counts as a frame.
+ */
+static unsigned long	usperframe = 0;
+static unsigned long	lastframeat = 0;
 
 /* A histogram of how many milliseconds the program spends sleeping
- * per tick.
+ * per tick, and a histogram in units of LATEUNIT microseconds of how
+ * late the program wakes up for a tick.
  */
-static int	showhistogram = FALSE;
-static unsigned	hist[100];
+#define	LATEUNIT	10
+static int		showhistogram = FALSE;
+static unsigned		hist[100];
+static unsigned		latehist[1000];
+static unsigned long	maxlateness = 0;
+static unsigned long	missedticks = 0;
+
+/* Return the current time in microseconds.
+ */
+unsigned long _sdlgetmicroseconds(void)
+{
+#ifdef USE_MONOTONIC_CLOCK
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+#else
+    return SDL_GetTicks() * 1000UL;
+#endif
+}
+
+/* Sleep until the given time, as returned by _sdlgetmicroseconds().
+ * The program sleeps until shortly before the time, waking up
+ * periodically to collect input events, and then spins.
+ */
+static void sleepuntil(unsigned long when)
+{
+    long	us;
+#ifdef USE_MONOTONIC_CLOCK
+    struct timespec	ts;
+#endif
+
+    for (;;) {
+	us = (long)(when - _sdlgetmicroseconds()) - SPINTIME;
+	if (us <= 0)
+	    break;
+	if (us > INPUTPOLLTIME)
+	    us = INPUTPOLLTIME;
+#ifdef USE_MONOTONIC_CLOCK
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_nsec += us * 1000;
+	if (ts.tv_nsec >= 1000000000) {
+	    ts.tv_nsec -= 1000000000;
+	    ++ts.tv_sec;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+								== EINTR) ;
+#else
+	SDL_Delay(us / 1000);
+#endif
+	eventupdate(FALSE);
+    }
+    while ((long)(when - _sdlgetmicroseconds()) > 0) ;
+}
 
 /* Set the length (in real time) of a second of game time. A value of
  * zero selects the default length of one second.
  */
 void settimersecond(int ms)
 {
-    mspertick = (ms ? ms : 1000) / TICKS_PER_SECOND;
+    uspertick = (ms ? ms : 1000) * 1000UL / TICKS_PER_SECOND;
+}
+
+/* Set the number of missed ticks that the timer will make up.
+ */
+void settimercatchup(int maxticks)
+{
+    maxcatchup = maxticks;
+}
+
+/* Set the number of frames per second to draw in between ticks.
+ */
+void setframerate(int fps)
+{
+    usperframe = fps > 0 ? 1000000UL / fps : 0;
 }
 
 /* Change the current timer setting. If action is positive, the timer
@@ -44,16 +153,20 @@ void settimersecond(int ms)
 void settimer(int action)
 {
     if (action < 0) {
-	nexttickat = 0;
+	timerstate = Timer_Stopped;
 	utick = 0;
     } else if (action > 0) {
-	if (nexttickat < 0)
-	    nexttickat = SDL_GetTicks() - nexttickat;
+	if (timerstate == Timer_Paused)
+	    nexttickat += _sdlgetmicroseconds();
 	else
-	    nexttickat = SDL_GetTicks() + mspertick;
+	    nexttickat = _sdlgetmicroseconds() + uspertick;
+	lastframeat = nexttickat - uspertick;
+	timerstate = Timer_Running;
     } else {
-	if (nexttickat > 0)
-	    nexttickat = SDL_GetTicks() - nexttickat;
+	if (timerstate == Timer_Running) {
+	    nexttickat -= _sdlgetmicroseconds();
+	    timerstate = Timer_Paused;
+	}
     }
 }
 
@@ -65,30 +178,50 @@ int gettickcount(void)
 }
 
 /* Put the program to sleep until the next timer tick. If we've
- * already missed a timer tick, then wait for the next one.
+ * already missed a timer tick, return immediately so that the caller
+ * can catch up, unless we have fallen too far behind, in which case
+ * the missed ticks are given up on. The time of each tick is
+ * computed from the previous one rather than from the time of
+ * waking, so that errors do not accumulate.
  */
 int waitfortick(void)
 {
-    int	ms;
+    unsigned long	now;
+    long		us;
+    int			n;
 
-    ms = nexttickat - SDL_GetTicks();
-    if (showhistogram)
-	if (ms < (int)(sizeof hist / sizeof *hist))
-	    ++hist[ms >= 0 ? ms + 1 : 0];
+    now = _sdlgetmicroseconds();
+    us = (long)(nexttickat - now);
+    if (showhistogram) {
+	n = us >= 0 ? us / 1000 + 1 : 0;
+	if (n < (int)(sizeof hist / sizeof *hist))
+	    ++hist[n];
+    }
 
-    if (ms <= 0) {
-	++utick;
-	nexttickat += mspertick;
+    ++utick;
+    lastframeat = nexttickat;
+    if (us <= 0) {
+	++missedticks;
+	if (maxcatchup >= 0 && -us >= (long)(maxcatchup * uspertick))
+	    nexttickat = now + uspertick;
+	else
+	    nexttickat += uspertick;
 	return FALSE;
     }
 
-    while (ms < 0)
-	ms += mspertick;
+    sleepuntil(nexttickat);
 
-    SDL_Delay(ms);
+    if (showhistogram) {
+	us = (long)(_sdlgetmicroseconds() - nexttickat);
+	if ((unsigned long)us > maxlateness)
+	    maxlateness = us;
+	n = us / LATEUNIT;
+	if (n >= (int)(sizeof latehist / sizeof *latehist))
+	    n = sizeof latehist / sizeof *latehist - 1;
+	++latehist[n];
+    }
 
-    ++utick;
-    nexttickat += mspertick;
+    nexttickat += uspertick;
     return TRUE;
 }
 
@@ -99,6 +232,98 @@ int advancetick(void)
     return ++utick;
 }
 
+/* Return TRUE if the time of the next tick has been reached.
+ */
+int istickdue(void)
+{
+    return timerstate == Timer_Running
+	&& (long)(nexttickat - _sdlgetmicroseconds()) <= 0;
+}
+
+/* Return the current time in microseconds.
+ */
+unsigned long getmicroseconds(void)
+{
+    return _sdlgetmicroseconds();
+}
+
+/* Return TRUE if frames are being drawn in between ticks. This
+ * requires the timer to be running, and the frame rate to leave room
+ * for at least one frame in between.
+ */
+static int drawingframes(void)
+{
+    return usperframe && usperframe + usperframe / 2 <= uspertick
+		      && timerstate == Timer_Running;
+}
+
+/* Put the program to sleep until it is time to draw the next frame
+ * in between ticks. FALSE is returned without sleeping if the next
+ * tick would arrive first, or too soon after the frame for the frame
+ * to be drawn without delaying the tick.
+ */
+int waitforframe(void)
+{
+    unsigned long	when, now;
+
+    if (!drawingframes())
+	return FALSE;
+    when = lastframeat + usperframe;
+    now = _sdlgetmicroseconds();
+    if ((long)(when - now) < 0)
+	when = now;
+    if ((long)(nexttickat - when) < (long)(usperframe / 2))
+	return FALSE;
+    sleepuntil(when);
+    lastframeat = when;
+    return TRUE;
+}
+
+/* Return how far the current time is between the last tick and the
+ * next one, in TICK_PHASES steps. TICK_PHASES is returned whenever
+ * frames are not being drawn in between ticks.
+ */
+int _sdltickphase(void)
+{
+    long	us;
+
+    if (!drawingframes())
+	return TICK_PHASES;
+    us = (long)(uspertick - (nexttickat - _sdlgetmicroseconds()));
+    if (us <= 0)
+	return 0;
+    if (us >= (long)uspertick)
+	return TICK_PHASES;
+    return (int)((us * TICK_PHASES) / (long)uspertick);
+}
+
+/* Display the given percentiles of the lateness histogram.
+ */
+static void showlateness(unsigned long total)
+{
+    static int const	percentiles[] = { 500, 900, 990, 999 };
+    unsigned long	n;
+    int			i, j;
+
+    printf("Lateness of wakeups (us)\n");
+    n = 0;
+    j = 0;
+    for (i = 0 ; i < (int)(sizeof latehist / sizeof *latehist) ; ++i) {
+	n += latehist[i];
+	for ( ; j < (int)(sizeof percentiles / sizeof *percentiles) ; ++j) {
+	    if (n * 1000 < total * percentiles[j])
+		break;
+	    if (i == sizeof latehist / sizeof *latehist - 1)
+		printf("%4.1f%%: >%d\n", percentiles[j] / 10.0,
+						i * LATEUNIT);
+	    else
+		printf("%4.1f%%: <%d\n", percentiles[j] / 10.0,
+						(i + 1) * LATEUNIT);
+	}
+    }
+    printf(" max: %lu\n", maxlateness);
+}
+
 /* At shutdown time, display the histogram data on stdout.
  */
 static void shutdown(void)
@@ -119,7 +344,13 @@ static void shutdown(void)
 	    for (i = 1 ; i < (int)(sizeof hist / sizeof *hist) ; ++i)
 		if (hist[i])
 		    printf("%3d: %.1f%%\n", i - 1, (hist[i] * 100.0) / n);
+	    printf("Missed ticks: %lu of %lu\n", missedticks, n);
 	}
+	n = 0;
+	for (i = 0 ; i < (int)(sizeof latehist / sizeof *latehist) ; ++i)
+	    n += latehist[i];
+	if (n)
+	    showlateness(n);
     }
 }
 
@@ -0,0 +1,355 @@
+/* sdlvideo.c: Writing the game display to a video file.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"SDL.h"
+#include	"sdlgen.h"
+#include	"../err.h"
+
+/* The formats that a video can be written in: a series of PPM images,
+ * or a YUV4MPEG2 stream with 4:2:0 chroma subsampling.
+ */
+enum { Video_PPM, Video_Y4M };
+
+/* The number of frames that can wait to be written.
+ */
+#define	FRAMEQUEUESIZE	8
+
+/* The name of the video file, or NULL if no video is being written,
+ * and the file itself, once it has been opened.
+ */
+static char const      *videofilename = NULL;
+static FILE	       *videofp = NULL;
+
+/* The format of the video, and the size and pixel format of its
+ * frames, which are taken from the first frame.
+ */
+static int		videoformat = Video_PPM;
+static int		videow, videoh;
+static SDL_PixelFormat	videopixels;
+
+/* The frames waiting to be written, as copies of the display's pixels,
+ * with the rows packed together. The queue is shared with the writing
+ * thread, and framelock protects it. frameready is signalled when a
+ * frame is added, and framedone when one is taken off.
+ */
+static Uint8	       *framequeue[FRAMEQUEUESIZE];
+static int		framehead = 0;
+static int		frametail = 0;
+static int		finishing = FALSE;
+static SDL_mutex       *framelock = NULL;
+static SDL_cond	       *frameready = NULL;
+static SDL_cond	       *framedone = NULL;
+static SDL_Thread      *videothread = NULL;
+
+/* The buffers that a frame is converted into before it is written:
+ * the frame as 24-bit RGB, and the frame as YUV planes.
+ */
+static Uint8	       *rgbbuf = NULL;
+static Uint8	       *yuvbuf = NULL;
+
+/* TRUE if the video could not be written in full. This is shared
+ * with the writing thread, and is protected by framelock when the
+ * lock exists.
+ */
+static int		writeerror = FALSE;
+
+/*
+ * Converting and writing frames.
+ */
+
+/* Convert a frame from the display's pixel format to 24-bit RGB.
+ */
+static void framergb(Uint8 const *src, Uint8 *dest)
+{
+    _sdlpixelstorgb(src, videow * videoh, &videopixels, dest);
+}
+
+/* Convert a frame from 24-bit RGB to YUV planes, using the BT.601
+ * coefficients. Each chroma sample is computed from the average color
+ * of a 2x2 block of pixels.
+ */
+static void frameyuv(Uint8 const *rgb, Uint8 *yuv)
+{
+    Uint8 const	       *p;
+    Uint8	       *u, *v;
+    int			r, g, b;
+    int			x, y, n;
+
+    n = videow * videoh;
+    for (p = rgb ; n ; --n, p += 3)
+	*yuv++ = ((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16;
+
+    u = yuv;
+    v = yuv + (videow / 2) * (videoh / 2);
+    for (y = 0 ; y < videoh / 2 ; ++y) {
+	p = rgb + 2 * y * videow * 3;
+	for (x = 0 ; x < videow / 2 ; ++x, p += 6) {
+	    r = p[0] + p[3] + p[videow * 3] + p[videow * 3 + 3];
+	    g = p[1] + p[4] + p[videow * 3 + 1] + p[videow * 3 + 4];
+	    b = p[2] + p[5] + p[videow * 3 + 2] + p[videow * 3 + 5];
+	    *u++ = (-38 * r - 74 * g + 112 * b + (128 << 10) + 512) >> 10;
+	    *v++ = (112 * r - 94 * g - 18 * b + (128 << 10) + 512) >> 10;
+	}
+    }
+}
+
+/* Return TRUE if a write error has occurred.
+ */
+static int getwriteerror(void)
+{
+    int	f;
+
+    if (framelock)
+	SDL_LockMutex(framelock);
+    f = writeerror;
+    if (framelock)
+	SDL_UnlockMutex(framelock);
+    return f;
+}
+
+/* Record that a write error has occurred.
+ */
+static void setwriteerror(void)
+{
+    if (framelock)
+	SDL_LockMutex(framelock);
+    writeerror = TRUE;
+    if (framelock)
+	SDL_UnlockMutex(framelock);
+}
+
+/* Convert a frame and write it to the video file.
+ */
+static void writeframe(Uint8 const *pixels)
+{
+    int	size;
+
+    if (getwriteerror())
+	return;
+    framergb(pixels, rgbbuf);
+    if (videoformat == Video_Y4M) {
+	frameyuv(rgbbuf, yuvbuf);
+	size = videow * videoh + 2 * (videow / 2) * (videoh / 2);
+	fputs("FRAME\n", videofp);
+	fwrite(yuvbuf, size, 1, videofp);
+    } else {
+	fprintf(videofp, "P6\n%d %d\n255\n", videow, videoh);
+	fwrite(rgbbuf, videow * videoh * 3, 1, videofp);
+    }
+    if (ferror(videofp)) {
+	warn("%s: write error", videofilename);
+	setwriteerror();
+    }
+}
+
+/* The body of the writing thread. Frames are taken off the queue and
+ * written until the queue is empty and the video is finished.
+ */
+static int videothreadbody(void *data)
+{
+    (void)data;
+    SDL_LockMutex(framelock);
+    for (;;) {
+	while (frametail == framehead && !finishing)
+	    SDL_CondWait(frameready, framelock);
+	if (frametail == framehead)
+	    break;
+	SDL_UnlockMutex(framelock);
+	writeframe(framequeue[frametail]);
+	SDL_LockMutex(framelock);
+	frametail = (frametail + 1) % FRAMEQUEUESIZE;
+	SDL_CondSignal(framedone);
+    }
+    SDL_UnlockMutex(framelock);
+    return 0;
+}
+
+/* Open the video file and prepare to write frames the size and format
+ * of the given surface. The frames are written by a separate thread
+ * if one can be created.
+ */
+static int openvideo(SDL_Surface const *surface)
+{
+    char const *ext;
+    int		size, n;
+
+    videow = surface->w & ~1;
+    videoh = surface->h & ~1;
+    videopixels = *surface->format;
+    ext = strrchr(videofilename, '.');
+    videoformat = ext && !strcmp(ext, ".y4m") ? Video_Y4M : Video_PPM;
+
+    if (!strcmp(videofilename, "-"))
+	videofp = stdout;
+    else
+	videofp = fopen(videofilename, "wb");
+    if (!videofp) {
+	errmsg(videofilename, "cannot open for writing");
+	writeerror = TRUE;
+	return FALSE;
+    }
+    if (videoformat == Video_Y4M)
+	fprintf(videofp, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+			 videow, videoh, TICKS_PER_SECOND);
+
+    size = videow * videoh * surface->format->BytesPerPixel;
+    for (n = 0 ; n < FRAMEQUEUESIZE ; ++n)
+	if (!(framequeue[n] = malloc(size)))
+	    memerrexit();
+    if (!(rgbbuf = malloc(videow * videoh * 3))
+		|| !(yuvbuf = malloc(videow * videoh * 3 / 2)))
+	memerrexit();
+
+    framelock = SDL_CreateMutex();
+    frameready = SDL_CreateCond();
+    framedone = SDL_CreateCond();
+    if (framelock && frameready && framedone)
+	videothread = SDL_CreateThread(videothreadbody, NULL);
+    if (!videothread)
+	warn("couldn't create video thread: %s", SDL_GetError());
+    return TRUE;
+}
+
+/*
+ * Exported functions.
+ */
+
+/* Convert count pixels in the given pixel format to 24-bit RGB.
+ */
+void _sdlpixelstorgb(Uint8 const *src, int count, SDL_PixelFormat *fmt,
+		     Uint8 *dest)
+{
+    Uint32	pixel;
+    int		n;
+
+    n = count;
+    if (fmt->BytesPerPixel == 4) {
+	for ( ; n ; --n, src += 4) {
+	    pixel = *(Uint32 const*)src;
+	    *dest++ = ((pixel & fmt->Rmask) >> fmt->Rshift) << fmt->Rloss;
+	    *dest++ = ((pixel & fmt->Gmask) >> fmt->Gshift) << fmt->Gloss;
+	    *dest++ = ((pixel & fmt->Bmask) >> fmt->Bshift) << fmt->Bloss;
+	}
+	return;
+    }
+
+    for ( ; n ; --n, src += fmt->BytesPerPixel, dest += 3) {
+	switch (fmt->BytesPerPixel) {
+	  case 1:
+	    pixel = *src;
+	    break;
+	  case 2:
+	    pixel = *(Uint16 const*)src;
+	    break;
+	  default:
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+	    pixel = src[0] | (src[1] << 8) | (src[2] << 16);
+#else
+	    pixel = (src[0] << 16) | (src[1] << 8) | src[2];
+#endif
+	    break;
+	}
+	SDL_GetRGB(pixel, fmt, dest, dest + 1, dest + 2);
+    }
+}
+
+/* Add the contents of the given surface to the video as a frame. If
+ * the writing thread has fallen behind, wait for room in the queue.
+ */
+void _sdlvideoframe(SDL_Surface *surface)
+{
+    Uint8      *dest;
+    Uint8      *src;
+    int		rowsize, y;
+
+    if (!videofilename || getwriteerror())
+	return;
+    if (!videofp && !openvideo(surface))
+	return;
+
+    if (videothread) {
+	SDL_LockMutex(framelock);
+	while ((framehead + 1) % FRAMEQUEUESIZE == frametail)
+	    SDL_CondWait(framedone, framelock);
+	SDL_UnlockMutex(framelock);
+    }
+
+    if (SDL_MUSTLOCK(surface))
+	SDL_LockSurface(surface);
+    dest = framequeue[framehead];
+    src = surface->pixels;
+    rowsize = videow * surface->format->BytesPerPixel;
+    for (y = 0 ; y < videoh ; ++y, src += surface->pitch, dest += rowsize)
+	memcpy(dest, src, rowsize);
+    if (SDL_MUSTLOCK(surface))
+	SDL_UnlockSurface(surface);
+
+    if (!videothread) {
+	writeframe(framequeue[framehead]);
+	return;
+    }
+    SDL_LockMutex(framelock);
+    framehead = (framehead + 1) % FRAMEQUEUESIZE;
+    SDL_CondSignal(frameready);
+    SDL_UnlockMutex(framelock);
+}
+
+/* Write the game display to the given file as a video instead of
+ * showing it on the screen.
+ */
+int setvideoexport(char const *filename)
+{
+    videofilename = filename;
+    SDL_putenv("SDL_VIDEODRIVER=dummy");
+    return TRUE;
+}
+
+/* Wait for the remaining frames to be written, and close the file.
+ */
+int finishvideoexport(void)
+{
+    int	n;
+
+    if (!videofp)
+	return !getwriteerror();
+
+    if (videothread) {
+	SDL_LockMutex(framelock);
+	finishing = TRUE;
+	SDL_CondSignal(frameready);
+	SDL_UnlockMutex(framelock);
+	SDL_WaitThread(videothread, NULL);
+	videothread = NULL;
+    }
+    if (framelock)
+	SDL_DestroyMutex(framelock);
+    if (frameready)
+	SDL_DestroyCond(frameready);
+    if (framedone)
+	SDL_DestroyCond(framedone);
+    framelock = NULL;
+    frameready = framedone = NULL;
+
+    if (videofp == stdout ? fflush(videofp) : fclose(videofp)) {
+	if (!writeerror)
+	    warn("%s: write error", videofilename);
+	writeerror = TRUE;
+    }
+    videofp = NULL;
+    videofilename = NULL;
+
+    for (n = 0 ; n < FRAMEQUEUESIZE ; ++n) {
+	free(framequeue[n]);
+	framequeue[n] = NULL;
+    }
+    free(rgbbuf);
+    free(yuvbuf);
+    rgbbuf = yuvbuf = NULL;
+    return !writeerror;
+}
@@ -0,0 +1,73 @@
+/* ttygen.h: The internal shared definitions of the terminal OS/hardware
+ * layer.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_ttygen_h_
+#define	_ttygen_h_
+
+#include	"../gen.h"
+#include	"../oshw.h"
+
+/*
+ * Values global to this module. All the globals are placed in here,
+ * in order to minimize pollution of the main module's namespace.
+ */
+
+typedef	struct oshwglobals
+{
+    int			fd;		/* the terminal, for input/output */
+    int			active;		/* TRUE if terminal is in raw mode */
+    short		width;		/* width of the terminal in cells */
+    short		height;		/* height of the terminal in cells */
+} oshwglobals;
+
+/* oshw's structure of globals.
+ */
+extern oshwglobals ttyg;
+
+/* Process all pending input. If wait is TRUE and no input is
+ * currently pending, the function blocks until some arrives. The
+ * display is redrawn if the terminal has been resized meanwhile.
+ */
+extern void _ttyeventupdate(int wait);
+
+/* Decode the given bytes read from the terminal into keystrokes.
+ * TRUE is returned if the bytes end partway through an escape
+ * sequence. In that case the function should be called again with the
+ * bytes that follow, or with a count of zero if nothing more arrives
+ * shortly, which causes the partial sequence to be taken as keys in
+ * their own right.
+ */
+extern int _ttyinputbytes(unsigned char const *buf, int len);
+
+/* Return the current time in microseconds. Only the difference
+ * between two return values is meaningful.
+ */
+extern unsigned long _ttygetmicroseconds(void);
+
+/* Put the terminal back in the state it was found in. It is safe to
+ * call this function more than once.
+ */
+extern void _ttyrestore(void);
+
+/* Forget what is showing on the terminal, so that the next update
+ * redraws all of it. This is needed after something other than this
+ * module has written to the terminal, or after it has been resized.
+ */
+extern void _ttyinvalidate(void);
+
+/* Send the changes to the display to the terminal, if there are any.
+ */
+extern void _ttyflush(void);
+
+/* The initialization functions for the various modules.
+ */
+extern int _ttytimerinitialize(int showhistogram);
+extern int _ttyinputinitialize(void);
+extern int _ttyoutputinitialize(void);
+extern int _ttysfxinitialize(int silence);
+
+#endif
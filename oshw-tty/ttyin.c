@@ -0,0 +1,478 @@
+/* ttyin.c: Reading the keyboard.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"ttygen.h"
+#include	"../defs.h"
+
+/* The keys that arrive as escape sequences, numbered after the
+ * single-byte keys.
+ */
+enum {
+    TTYK_UP = 256,
+    TTYK_LEFT,
+    TTYK_DOWN,
+    TTYK_RIGHT,
+    TTYK_SHIFT_UP,
+    TTYK_SHIFT_LEFT,
+    TTYK_SHIFT_DOWN,
+    TTYK_SHIFT_RIGHT,
+    TTYK_HOME,
+    TTYK_SHIFT_HOME,
+    TTYK_END,
+    TTYK_PAGEUP,
+    TTYK_PAGEDOWN,
+    TTYK_BACKTAB,
+    TTYK_F1,
+    TTYK_F10,
+    TTYK_ESCAPE,
+    TTYK_UNKNOWN
+};
+
+/* Structure describing a mapping of a key to a game command.
+ */
+typedef	struct keycmdmap {
+    int		key;		/* the key's byte or TTYK_* value */
+    int		cmd;		/* the command */
+} keycmdmap;
+
+/* The longest escape sequence that is recognized.
+ */
+#define	MAXSEQLEN	16
+
+/* Bytes received that may be the start of an escape sequence.
+ */
+static unsigned char	pending[MAXSEQLEN];
+static int		pendinglen = 0;
+
+/* The keys that have been decoded but not yet returned, in order of
+ * arrival.
+ */
+#define	KEYQUEUESIZE	64
+static short		keyqueue[KEYQUEUESIZE];
+static int		keyqueuehead = 0;
+static int		keyqueuetail = 0;
+
+/* The number of polls for which the last direction key is still
+ * considered active. A terminal sends keys without any notice of
+ * when they are released, so in keyboard behavior mode a direction
+ * key stays active for the two polls that follow it, as a key that
+ * is tapped would with a real keyboard.
+ */
+static int		linger = 0;
+
+/* TRUE if direction keys are to be treated as always repeating.
+ */
+static int		joystickstyle = FALSE;
+
+/* The complete list of key commands recognized by the game while
+ * playing. The shifted and control keys arrive as their own bytes.
+ */
+static keycmdmap const gamekeycmds[] = {
+    { TTYK_UP,			CmdNorth },
+    { TTYK_LEFT,		CmdWest },
+    { TTYK_DOWN,		CmdSouth },
+    { TTYK_RIGHT,		CmdEast },
+    { '8',			CmdNorth },
+    { '4',			CmdWest },
+    { '2',			CmdSouth },
+    { '6',			CmdEast },
+    { 'q',			CmdQuitLevel },
+    { TTYK_ESCAPE,		CmdQuitLevel },
+    { '\020',			CmdPrevLevel },
+    { '\022',			CmdSameLevel },
+    { '\016',			CmdNextLevel },
+    { 'g',			CmdGotoLevel },
+    { '\007',			CmdGotoLevel },
+    { 'Q',			CmdQuit },
+    { TTYK_PAGEUP,		CmdPrev10 },
+    { 'p',			CmdPrev },
+    { 'r',			CmdSame },
+    { 'n',			CmdNext },
+    { TTYK_PAGEDOWN,		CmdNext10 },
+    { '\b',			CmdPauseGame },
+    { '\177',			CmdPauseGame },
+    { '?',			CmdHelp },
+    { TTYK_F1,			CmdHelp },
+    { 'o',			CmdStepping },
+    { 'O',			CmdSubStepping },
+    { 'f',			CmdRndSlideDir },
+    { '\t',			CmdPlayback },
+    { TTYK_BACKTAB,		CmdCheckSolution },
+    { '\030',			CmdReplSolution },
+    { '\013',			CmdKillSolution },
+    { 's',			CmdSeeScores },
+    { '\023',			CmdSeeSolutionFiles },
+    { 'V',			CmdVolumeUp },
+    { 'v',			CmdVolumeDown },
+    { '=',			CmdFaster },
+    { '+',			CmdFaster },
+    { '-',			CmdSlower },
+    { '\r',			CmdProceed },
+    { '\n',			CmdProceed },
+    { ' ',			CmdProceed },
+    { 'd',			CmdDebugCmd1 },
+    { 'D',			CmdDebugCmd2 },
+    { TTYK_SHIFT_UP,		CmdCheatNorth },
+    { TTYK_SHIFT_LEFT,		CmdCheatWest },
+    { TTYK_SHIFT_DOWN,		CmdCheatSouth },
+    { TTYK_SHIFT_RIGHT,		CmdCheatEast },
+    { TTYK_SHIFT_HOME,		CmdCheatHome },
+    { TTYK_F10,			CmdCheatStuff },
+    { '\003',			CmdQuit },
+    { 0, 0 }
+};
+
+/* The list of key commands recognized when the program is obtaining
+ * input from the user. Letters are handled separately.
+ */
+static keycmdmap const inputkeycmds[] = {
+    { TTYK_UP,			CmdNorth },
+    { TTYK_LEFT,		CmdWest },
+    { TTYK_DOWN,		CmdSouth },
+    { TTYK_RIGHT,		CmdEast },
+    { '\b',			CmdWest },
+    { '\177',			CmdWest },
+    { ' ',			CmdEast },
+    { '\r',			CmdProceed },
+    { '\n',			CmdProceed },
+    { TTYK_ESCAPE,		CmdQuitLevel },
+    { '\003',			CmdQuit },
+    { 0, 0 }
+};
+
+/* The current map of key commands.
+ */
+static keycmdmap const *keycmds = gamekeycmds;
+
+/*
+ * Decoding the bytes from the terminal.
+ */
+
+/* Add a key to the queue. A key that is the same as the last one
+ * still waiting in the queue is dropped, so that the keys repeated
+ * by the terminal while a key is held down do not pile up faster
+ * than the game can use them. If the queue is full, the oldest key
+ * is lost.
+ */
+static void addkey(int key)
+{
+    int	next;
+
+    if (keyqueuehead != keyqueuetail) {
+	if (keyqueue[(keyqueuehead + KEYQUEUESIZE - 1) % KEYQUEUESIZE]
+								== key)
+	    return;
+    }
+    next = (keyqueuehead + 1) % KEYQUEUESIZE;
+    if (next == keyqueuetail)
+	keyqueuetail = (keyqueuetail + 1) % KEYQUEUESIZE;
+    keyqueue[keyqueuehead] = key;
+    keyqueuehead = next;
+}
+
+/* Return the key for a cursor key's final character, which is
+ * modified by the shift key if shift is TRUE.
+ */
+static int cursorkey(int ch, int shift)
+{
+    switch (ch) {
+      case 'A':	return shift ? TTYK_SHIFT_UP : TTYK_UP;
+      case 'B':	return shift ? TTYK_SHIFT_DOWN : TTYK_DOWN;
+      case 'C':	return shift ? TTYK_SHIFT_RIGHT : TTYK_RIGHT;
+      case 'D':	return shift ? TTYK_SHIFT_LEFT : TTYK_LEFT;
+      case 'H':	return shift ? TTYK_SHIFT_HOME : TTYK_HOME;
+      case 'F':	return TTYK_END;
+      case 'P':	return TTYK_F1;
+      case 'M':	return '\r';
+    }
+    return TTYK_UNKNOWN;
+}
+
+/* Decode a control sequence, which is an escape and a left bracket
+ * followed by the numeric parameters and the final character at
+ * seq[len - 1]. The xterm style of reporting a shifted key through
+ * a second parameter of 2 is recognized.
+ */
+static int decodecsi(unsigned char const *seq, int len)
+{
+    int	params[2] = { 0, 0 };
+    int	n, i;
+
+    n = 0;
+    for (i = 2 ; i < len - 1 ; ++i) {
+	if (seq[i] >= '0' && seq[i] <= '9') {
+	    if (n < 2)
+		params[n] = params[n] * 10 + seq[i] - '0';
+	} else if (seq[i] == ';') {
+	    ++n;
+	} else {
+	    return TTYK_UNKNOWN;
+	}
+    }
+
+    switch (seq[len - 1]) {
+      case 'Z':
+	return TTYK_BACKTAB;
+      case '~':
+	switch (params[0]) {
+	  case 1: case 7:	return params[1] == 2 ? TTYK_SHIFT_HOME
+						      : TTYK_HOME;
+	  case 4: case 8:	return TTYK_END;
+	  case 5:		return TTYK_PAGEUP;
+	  case 6:		return TTYK_PAGEDOWN;
+	  case 11:		return TTYK_F1;
+	  case 21:		return TTYK_F10;
+	}
+	return TTYK_UNKNOWN;
+    }
+    return cursorkey(seq[len - 1], params[1] == 2);
+}
+
+/* Decode the bytes read from the terminal, adding their keys to the
+ * queue. An escape sequence that has not been received in full is
+ * kept until the rest of it arrives, or until the function is called
+ * with no bytes, in which case its bytes are keys by themselves. A
+ * lone escape byte is the escape key. An escape followed by a byte
+ * that does not start a sequence is taken as the two keys.
+ */
+int _ttyinputbytes(unsigned char const *buf, int len)
+{
+    int	n, i;
+
+    if (!len) {
+	for (i = 0 ; i < pendinglen ; ++i)
+	    addkey(pending[i] == '\033' ? TTYK_ESCAPE : pending[i]);
+	pendinglen = 0;
+	return FALSE;
+    }
+
+    while (len || pendinglen) {
+	while (len && pendinglen < MAXSEQLEN) {
+	    pending[pendinglen++] = *buf++;
+	    --len;
+	}
+	if (pending[0] != '\033') {
+	    addkey(pending[0]);
+	    n = 1;
+	} else if (pendinglen < 2) {
+	    return TRUE;
+	} else if (pending[1] == '[') {
+	    for (n = 2 ; n < pendinglen ; ++n)
+		if (pending[n] >= 0x40 && pending[n] <= 0x7E)
+		    break;
+	    if (n == pendinglen) {
+		if (pendinglen < MAXSEQLEN)
+		    return TRUE;
+		addkey(TTYK_UNKNOWN);
+	    } else {
+		++n;
+		addkey(decodecsi(pending, n));
+	    }
+	} else if (pending[1] == 'O') {
+	    if (pendinglen < 3)
+		return TRUE;
+	    addkey(cursorkey(pending[2], FALSE));
+	    n = 3;
+	} else {
+	    addkey(TTYK_ESCAPE);
+	    n = 1;
+	}
+	pendinglen -= n;
+	memmove(pending, pending + n, pendinglen);
+    }
+    return FALSE;
+}
+
+/* Return the command that the given key is mapped to, or zero if the
+ * key has no command.
+ */
+static int keycommand(int key)
+{
+    keycmdmap const    *kc;
+
+    if (keycmds == inputkeycmds && key < 128) {
+	if (key >= 'a' && key <= 'z')
+	    return key;
+	if (key >= 'A' && key <= 'Z')
+	    return key - 'A' + 'a';
+    }
+    for (kc = keycmds ; kc->key ; ++kc)
+	if (kc->key == key)
+	    return kc->cmd;
+    return 0;
+}
+
+/* Discard all of the keys waiting to be returned.
+ */
+static void flushkeys(void)
+{
+    _ttyeventupdate(FALSE);
+    keyqueuehead = keyqueuetail = 0;
+    linger = 0;
+}
+
+/*
+ * Exported functions.
+ */
+
+/* Wait for any key to be pressed, ignoring any keys that were pressed
+ * before the function was called. Return FALSE if the key pressed is
+ * suggestive of a desire to quit.
+ */
+int anykey(void)
+{
+    int	key;
+
+    flushkeys();
+    while (keyqueuehead == keyqueuetail)
+	_ttyeventupdate(TRUE);
+    key = keyqueue[keyqueuetail];
+    keyqueuetail = (keyqueuetail + 1) % KEYQUEUESIZE;
+    return key != 'q' && key != 'Q' && key != TTYK_ESCAPE;
+}
+
+/* Return the command associated with the next key waiting, if any.
+ * If no key is waiting and wait is TRUE, block until a key with an
+ * associated command arrives. Each poll returns one key, so keys that
+ * arrive in quick succession are returned by successive polls. In
+ * keyboard behavior mode, the function can return CmdPreserve,
+ * indicating that if the key command from the previous poll has not
+ * been processed, it should still be considered active.
+ */
+int input(int wait)
+{
+    int	cmd, key;
+
+    for (;;) {
+	_ttyeventupdate(wait && keyqueuehead == keyqueuetail);
+	while (keyqueuehead != keyqueuetail) {
+	    key = keyqueue[keyqueuetail];
+	    keyqueuetail = (keyqueuetail + 1) % KEYQUEUESIZE;
+	    cmd = keycommand(key);
+	    if (!cmd)
+		continue;
+	    linger = 0;
+	    if (!joystickstyle && keycmds == gamekeycmds
+			       && cmd <= CmdKeyMoveLast)
+		linger = 2;
+	    return cmd;
+	}
+	if (!wait)
+	    break;
+    }
+    if (linger) {
+	--linger;
+	return CmdPreserve;
+    }
+    return 0;
+}
+
+/* The terminal decides whether keys repeat.
+ */
+int setkeyboardrepeat(int enable)
+{
+    (void)enable;
+    return TRUE;
+}
+
+/* Turn joystick behavior mode on or off. In joystick-behavior mode,
+ * a direction key is active only for the poll that returns it. In
+ * keyboard-behavior mode, it remains active for two more polls.
+ */
+int setkeyboardarrowsrepeat(int enable)
+{
+    joystickstyle = enable;
+    flushkeys();
+    return TRUE;
+}
+
+/* Turn input mode on or off. When input mode is on, the input key
+ * command map is used instead of the game key command map.
+ */
+int setkeyboardinputmode(int enable)
+{
+    keycmds = enable ? inputkeycmds : gamekeycmds;
+    return TRUE;
+}
+
+/* Initialization.
+ */
+int _ttyinputinitialize(void)
+{
+    return TRUE;
+}
+
+/* Online help texts for the keyboard commands.
+ */
+tablespec const *keyboardhelp(int which)
+{
+    static char *ingame_items[] = {
+	"1-arrows", "1-move Chip",
+	"1-2 4 6 8", "1-also move Chip",
+	"1-q Esc", "1-quit the current game",
+	"1-Bkspc", "1-pause the game",
+	"1-Ctrl-R", "1-restart the current level",
+	"1-Ctrl-P", "1-jump to the previous level",
+	"1-Ctrl-N", "1-jump to the next level",
+	"1-+ -", "1-change the speed of a playback",
+	"1-Q Ctrl-C", "1-exit the program"
+    };
+    static tablespec const keyhelp_ingame = { 9, 2, 4, 1,
+					      ingame_items, NULL, NULL };
+
+    static char *twixtgame_items[] = {
+	"1-p", "1-jump to the previous level",
+	"1-n", "1-jump to the next level",
+	"1-PgUp", "1-skip back ten levels",
+	"1-PgDn", "1-skip ahead ten levels",
+	"1-g", "1-go to a level using a password",
+	"1-s", "1-see the scores for each level",
+	"1-Tab", "1-playback saved solution",
+	"1-Shift-Tab", "1-verify saved solution",
+	"1-Ctrl-X", "1-replace existing solution",
+	"1-Ctrl-K", "1-delete existing solution",
+	"1-Ctrl-S", "1-see the available solution files",
+	"1-o", "1-toggle between even-step and odd-step offset",
+	"1-O", "1-increment stepping offset (Lynx only)",
+	"1-q", "1-return to the file list",
+	"1-Q Ctrl-C", "1-exit the program"
+    };
+    static tablespec const keyhelp_twixtgame = { 15, 2, 2, 1,
+						 twixtgame_items, NULL, NULL };
+
+    static char *scorelist_items[] = {
+	"1-up down", "1-move selection",
+	"1-PgUp PgDn", "1-scroll selection",
+	"1-Enter Space", "1-select level",
+	"1-Ctrl-S", "1-change solution file",
+	"1-q", "1-return to the last level",
+	"1-Q Ctrl-C", "1-exit the program"
+    };
+    static tablespec const keyhelp_scorelist = { 6, 2, 2, 1,
+						 scorelist_items, NULL, NULL };
+
+    static char *scroll_items[] = {
+	"1-up down", "1-move selection",
+	"1-PgUp PgDn", "1-scroll selection",
+	"1-Enter Space", "1-select",
+	"1-q Esc", "1-cancel",
+	"1-Q Ctrl-C", "1-exit the program"
+    };
+    static tablespec const keyhelp_scroll = { 5, 2, 2, 1,
+					      scroll_items, NULL, NULL };
+
+    switch (which) {
+      case KEYHELP_INGAME:	return &keyhelp_ingame;
+      case KEYHELP_TWIXTGAMES:	return &keyhelp_twixtgame;
+      case KEYHELP_SCORELIST:	return &keyhelp_scorelist;
+      case KEYHELP_FILELIST:	return &keyhelp_scroll;
+    }
+
+    return NULL;
+}
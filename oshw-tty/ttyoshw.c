@@ -0,0 +1,318 @@
+/* ttyoshw.c: Top-level terminal management functions.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<errno.h>
+#include	<signal.h>
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	<termios.h>
+#include	<poll.h>
+#include	"ttygen.h"
+#include	"../err.h"
+
+/* Values global to this library.
+ */
+oshwglobals	ttyg;
+
+/* How long to wait for the rest of an escape sequence before deciding
+ * that the escape key was pressed by itself, in milliseconds.
+ */
+#define	ESCAPEWAIT	25
+
+/* The terminal's settings before the program changed them.
+ */
+static struct termios	savedtermios;
+
+/* The messages reported while the terminal was showing the display.
+ */
+static char		savedmsgs[8192];
+static size_t		savedmsgslen = 0;
+
+/* Set when the terminal has been resized and the display not yet
+ * redrawn to match.
+ */
+static volatile sig_atomic_t	resized = FALSE;
+
+/* Note that the terminal has changed size.
+ */
+static void sigwinch(int sig)
+{
+    (void)sig;
+    resized = TRUE;
+}
+
+/* Restore the terminal when the program is killed by a signal. The
+ * handler is reset by then, so raising the signal again lets it take
+ * its usual course.
+ */
+static void sigfatal(int sig)
+{
+    _ttyrestore();
+    raise(sig);
+}
+
+/* Write a string directly to the terminal.
+ */
+static void ttywrite(char const *str)
+{
+    size_t	len;
+    ssize_t	n;
+
+    len = strlen(str);
+    while (len) {
+	n = write(ttyg.fd, str, len);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	str += n;
+	len -= n;
+    }
+}
+
+/* Read all the bytes waiting on the terminal and pass them to the
+ * input module. If wait is TRUE and nothing is waiting, block until
+ * something is. When the bytes end in the middle of an escape
+ * sequence, the rest of it is given a moment to arrive before the
+ * bytes are taken as keys in their own right.
+ */
+void _ttyeventupdate(int wait)
+{
+    struct pollfd	pfd;
+    unsigned char	buf[256];
+    int			timeout, n;
+
+    pfd.fd = ttyg.fd;
+    pfd.events = POLLIN;
+    timeout = wait ? -1 : 0;
+    for (;;) {
+	if (resized) {
+	    resized = FALSE;
+	    _ttyinvalidate();
+	    _ttyflush();
+	}
+	n = poll(&pfd, 1, timeout);
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n <= 0) {
+	    if (timeout == ESCAPEWAIT)
+		_ttyinputbytes(NULL, 0);
+	    break;
+	}
+	n = read(ttyg.fd, buf, sizeof buf);
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n <= 0) {
+	    if (n == 0)
+		exit(EXIT_SUCCESS);
+	    break;
+	}
+	timeout = _ttyinputbytes(buf, n) ? ESCAPEWAIT : 0;
+    }
+}
+
+/* Set the terminal's title to the program's name and subtitle, if the
+ * terminal is showing the display.
+ */
+void setsubtitle(char const *subtitle)
+{
+    char	buf[512];
+
+    if (!ttyg.active)
+	return;
+    if (subtitle && *subtitle)
+	sprintf(buf, "\033]0;Tile World - %.480s\007", subtitle);
+    else
+	strcpy(buf, "\033]0;Tile World\007");
+    ttywrite(buf);
+}
+
+/* Start a background task. The display is only updated from the main
+ * thread, so there is no reason to start another one; the task is
+ * run to completion right away.
+ */
+void *startbackgroundtask(int (*func)(void*), void *data)
+{
+    int	       *result;
+
+    if (!(result = malloc(sizeof *result)))
+	memerrexit();
+    *result = (*func)(data);
+    return result;
+}
+
+/* Tasks are never run on a separate thread.
+ */
+int onbackgroundtask(void const *task)
+{
+    (void)task;
+    return FALSE;
+}
+
+/* Return the result of a background task.
+ */
+int waitforbackgroundtask(void *task)
+{
+    int	result;
+
+    result = *(int*)task;
+    free(task);
+    return result;
+}
+
+/* Ring the bell already.
+ */
+void ding(void)
+{
+    if (ttyg.active)
+	ttywrite("\a");
+    else
+	fputc('\a', stderr);
+}
+
+/* Display a formatted message on stderr. While the terminal is
+ * showing the display, the message is shown in the display's message
+ * area instead, and saved to be written on stderr when the terminal
+ * is restored. A fatal error restores the terminal first.
+ */
+void usermessage(int action, char const *prefix,
+		 char const *cfile, unsigned long lineno,
+		 char const *fmt, va_list args)
+{
+    char	buf[1024];
+    int		n;
+
+    if (action == NOTIFY_DIE)
+	_ttyrestore();
+    n = sprintf(buf, "%s: ", action == NOTIFY_DIE ? "FATAL" :
+			     action == NOTIFY_ERR ? "error" : "warning");
+    if (cfile)
+	n += sprintf(buf + n, "[%.256s:%lu] ", cfile, lineno);
+    if (prefix)
+	n += sprintf(buf + n, "%.256s: ", prefix);
+    if (fmt)
+	vsnprintf(buf + n, sizeof buf - n, fmt, args);
+
+    if (!ttyg.active) {
+	fprintf(stderr, "%s\n", buf);
+	fflush(stderr);
+	return;
+    }
+    n = strlen(buf);
+    if (savedmsgslen + n + 1 < sizeof savedmsgs) {
+	memcpy(savedmsgs + savedmsgslen, buf, n);
+	savedmsgslen += n;
+	savedmsgs[savedmsgslen++] = '\n';
+    }
+    setdisplaymsg(buf, 4000, 1000);
+}
+
+/* Return the terminal to its original settings, show the cursor, and
+ * leave the alternate screen. Then the messages that were reported in
+ * the meantime are written out.
+ */
+void _ttyrestore(void)
+{
+    if (!ttyg.active)
+	return;
+    ttyg.active = FALSE;
+    ttywrite("\033[0m\033[?25h\033[?1049l");
+    tcsetattr(ttyg.fd, TCSAFLUSH, &savedtermios);
+    if (savedmsgslen) {
+	fwrite(savedmsgs, 1, savedmsgslen, stderr);
+	fflush(stderr);
+	savedmsgslen = 0;
+    }
+}
+
+/* Put the terminal into raw mode, switch to the alternate screen, and
+ * hide the cursor. Keys are read a byte at a time, without echoing,
+ * and Ctrl-C, Ctrl-S and the like are passed through as input.
+ */
+static int rawmode(void)
+{
+    struct termios	t;
+
+    if (tcgetattr(ttyg.fd, &savedtermios)) {
+	errmsg("/dev/tty", "cannot get terminal settings: %s",
+			   strerror(errno));
+	return FALSE;
+    }
+    t = savedtermios;
+    t.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    t.c_oflag &= ~OPOST;
+    t.c_cflag |= CS8;
+    t.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    if (tcsetattr(ttyg.fd, TCSAFLUSH, &t)) {
+	errmsg("/dev/tty", "cannot set terminal settings: %s",
+			   strerror(errno));
+	return FALSE;
+    }
+    ttyg.active = TRUE;
+    ttywrite("\033[?1049h\033[?25l\033[H\033[2J");
+    return TRUE;
+}
+
+/* Open the terminal, set it up, and then initialize the other modules
+ * of the library.
+ */
+int oshwinitialize(int silence, int soundbufsize,
+		   int showhistogram, int fullscreen, int scale)
+{
+    static int const	fatalsigs[] = { SIGHUP, SIGINT, SIGQUIT, SIGTERM };
+    struct sigaction	sa;
+    int			n;
+
+    (void)soundbufsize;
+    (void)fullscreen;
+    (void)scale;
+
+    ttyg.fd = open("/dev/tty", O_RDWR | O_NOCTTY);
+    if (ttyg.fd < 0) {
+	errmsg("/dev/tty", "cannot open terminal: %s", strerror(errno));
+	return FALSE;
+    }
+    if (!rawmode())
+	return FALSE;
+
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = sigwinch;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, NULL);
+    sa.sa_handler = sigfatal;
+    sa.sa_flags = SA_RESETHAND;
+    for (n = 0 ; n < (int)(sizeof fatalsigs / sizeof *fatalsigs) ; ++n)
+	sigaction(fatalsigs[n], &sa, NULL);
+
+    setsubtitle(NULL);
+
+    if (!_ttytimerinitialize(showhistogram)
+		|| !_ttyinputinitialize()
+		|| !_ttyoutputinitialize()
+		|| !_ttysfxinitialize(silence)) {
+	_ttyrestore();
+	return FALSE;
+    }
+
+    /* Registered last, so that the terminal is restored before the
+     * other modules write anything out at exit.
+     */
+    atexit(_ttyrestore);
+    return TRUE;
+}
+
+/* The real main().
+ */
+int main(int argc, char *argv[])
+{
+    return tworld(argc, argv);
+}
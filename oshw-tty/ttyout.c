@@ -0,0 +1,1771 @@
+/* ttyout.c: Creating the program's displays on a terminal.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<ctype.h>
+#include	<errno.h>
+#include	<unistd.h>
+#include	<sys/ioctl.h>
+#include	"ttygen.h"
+#include	"../err.h"
+#include	"../state.h"
+#include	"../telemetry.h"
+
+/* The dimensions of the visible area of the map (in tiles), and the
+ * number of character cells across that one tile takes up.
+ */
+#define	NXTILES		9
+#define	NYTILES		9
+#define	TILEW		2
+
+/* The size of the terminal assumed when it cannot be determined.
+ */
+#define	DEFAULTWIDTH	80
+#define	DEFAULTHEIGHT	24
+
+/* The eight colors of the terminal, in the order of their SGR numbers.
+ */
+enum { BLACK, RED, GREEN, YELLOW, BLUE, MAGENTA, CYAN, WHITE };
+
+/* A cell's attributes are its foreground and background colors, plus
+ * a bold or a faint rendering, packed into one byte.
+ */
+#define	ATTR(fg, bg)	((fg) | ((bg) << 3))
+#define	A_BOLD		0x40
+#define	A_DIM		0x80
+#define	fgcolor(a)	((a) & 7)
+#define	bgcolor(a)	(((a) >> 3) & 7)
+#define	intensity(a)	((a) & (A_BOLD | A_DIM))
+
+/* TRUE if two cells look the same on the terminal. Blank cells differ
+ * only if their backgrounds do.
+ */
+#define	samecell(c1, c2)	((c1)->ch == (c2)->ch			\
+				 && ((c1)->attr == (c2)->attr		\
+				     || ((c1)->ch == ' '		\
+					 && bgcolor((c1)->attr)		\
+					    == bgcolor((c2)->attr))))
+
+/* Flags to the puttext function.
+ */
+#define	PT_CENTER	0x0100		/* center the text horizontally */
+#define	PT_RIGHT	0x0200		/* right-align the text */
+#define	PT_MULTILINE	0x0400		/* span lines & break at whitespace */
+#define	PT_UPDATERECT	0x0800		/* return the unused area in rect */
+#define	PT_CALCSIZE	0x1000		/* determine area needed for text */
+#define	PT_DIM		0x2000		/* draw using the dim text color */
+#define	PT_HILIGHT	0x4000		/* draw using the bold text color */
+#define PT_SKIPLINES(n)	((n) & 0x00FF)	/* don't render the first n lines */
+
+/* Erase a rectangle.
+ */
+#define	fillrect(r)		(puttext((r), NULL, 0, PT_MULTILINE))
+
+/* The number of rows at each end of a table, and the number of rows
+ * in between, that are measured when the table produces its rows on
+ * demand.
+ */
+#define	MEASUREDENDROWS	128
+#define	MEASUREDMIDROWS	256
+
+/* One character cell of the display.
+ */
+typedef	struct ttycell {
+    unsigned char	ch;		/* the character, in ISO-8859-1 */
+    unsigned char	attr;		/* the colors and intensity */
+} ttycell;
+
+/* A rectangle of character cells.
+ */
+typedef	struct ttyrect {
+    int			x, y;		/* the upper-left corner */
+    int			w, h;		/* the size */
+} ttyrect;
+
+/* The appearance of a tile. A creature's text has a single character,
+ * which is paired with an arrow showing its direction if dirchar is
+ * TRUE, and repeated otherwise. A background of BLACK stands for the
+ * display's background color, and lets the color of the tile beneath
+ * show through.
+ */
+typedef	struct tileglyph {
+    char const	       *text;		/* the characters */
+    unsigned char	attr;		/* the colors and intensity */
+    unsigned char	dirchar;	/* TRUE if the direction is shown */
+} tileglyph;
+
+/* Structure for holding information about the message display.
+ */
+typedef	struct msgdisplayinfo {
+    char		msg[256];	/* text of the message */
+    unsigned int	msglen;		/* length of the message */
+    unsigned long	until;		/* when to erase the message */
+    unsigned long	bolduntil;	/* when to dim the message */
+} msgdisplayinfo;
+
+/* The floor tiles.
+ */
+static tileglyph const floorglyphs[] = {
+    /* Nothing */		{ "  ", ATTR(WHITE, BLACK), 0 },
+    /* Empty */			{ "  ", ATTR(WHITE, BLACK), 0 },
+    /* Slide_North */		{ "^^", ATTR(GREEN, BLACK), 0 },
+    /* Slide_West */		{ "<<", ATTR(GREEN, BLACK), 0 },
+    /* Slide_South */		{ "vv", ATTR(GREEN, BLACK), 0 },
+    /* Slide_East */		{ ">>", ATTR(GREEN, BLACK), 0 },
+    /* Slide_Random */		{ "<>", ATTR(GREEN, BLACK) | A_BOLD, 0 },
+    /* Ice */			{ "  ", ATTR(WHITE, CYAN), 0 },
+    /* IceWall_Northwest */	{ "/^", ATTR(WHITE, CYAN) | A_BOLD, 0 },
+    /* IceWall_Northeast */	{ "^\\", ATTR(WHITE, CYAN) | A_BOLD, 0 },
+    /* IceWall_Southwest */	{ "\\_", ATTR(WHITE, CYAN) | A_BOLD, 0 },
+    /* IceWall_Southeast */	{ "_/", ATTR(WHITE, CYAN) | A_BOLD, 0 },
+    /* Gravel */		{ "..", ATTR(WHITE, BLACK), 0 },
+    /* Dirt */			{ "%%", ATTR(YELLOW, BLACK), 0 },
+    /* Water */			{ "~~", ATTR(WHITE, BLUE), 0 },
+    /* Fire */			{ "^^", ATTR(YELLOW, RED) | A_BOLD, 0 },
+    /* Bomb */			{ "@@", ATTR(RED, BLACK) | A_BOLD, 0 },
+    /* Beartrap */		{ "><", ATTR(YELLOW, BLACK), 0 },
+    /* Burglar */		{ "$$", ATTR(MAGENTA, BLACK) | A_BOLD, 0 },
+    /* HintButton */		{ "??", ATTR(CYAN, BLACK) | A_BOLD, 0 },
+    /* Button_Blue */		{ "()", ATTR(BLUE, BLACK) | A_BOLD, 0 },
+    /* Button_Green */		{ "()", ATTR(GREEN, BLACK) | A_BOLD, 0 },
+    /* Button_Red */		{ "()", ATTR(RED, BLACK) | A_BOLD, 0 },
+    /* Button_Brown */		{ "()", ATTR(YELLOW, BLACK), 0 },
+    /* Teleport */		{ "{}", ATTR(CYAN, BLUE) | A_BOLD, 0 },
+    /* Wall */			{ "  ", ATTR(WHITE, WHITE), 0 },
+    /* Wall_North */		{ "\"\"", ATTR(WHITE, BLACK) | A_BOLD, 0 },
+    /* Wall_West */		{ "| ", ATTR(WHITE, BLACK) | A_BOLD, 0 },
+    /* Wall_South */		{ "__", ATTR(WHITE, BLACK) | A_BOLD, 0 },
+    /* Wall_East */		{ " |", ATTR(WHITE, BLACK) | A_BOLD, 0 },
+    /* Wall_Southeast */	{ "_|", ATTR(WHITE, BLACK) | A_BOLD, 0 },
+    /* HiddenWall_Perm */	{ "  ", ATTR(WHITE, BLACK), 0 },
+    /* HiddenWall_Temp */	{ "  ", ATTR(WHITE, BLACK), 0 },
+    /* BlueWall_Real */		{ "##", ATTR(BLUE, BLACK) | A_BOLD, 0 },
+    /* BlueWall_Fake */		{ "##", ATTR(BLUE, BLACK) | A_BOLD, 0 },
+    /* SwitchWall_Open */	{ "..", ATTR(GREEN, BLACK) | A_BOLD, 0 },
+    /* SwitchWall_Closed */	{ "##", ATTR(GREEN, BLACK) | A_BOLD, 0 },
+    /* PopupWall */		{ "++", ATTR(WHITE, BLACK), 0 },
+    /* CloneMachine */		{ "[]", ATTR(WHITE, MAGENTA) | A_BOLD, 0 },
+    /* Door_Red */		{ "][", ATTR(BLACK, RED), 0 },
+    /* Door_Blue */		{ "][", ATTR(BLACK, BLUE), 0 },
+    /* Door_Yellow */		{ "][", ATTR(BLACK, YELLOW), 0 },
+    /* Door_Green */		{ "][", ATTR(BLACK, GREEN), 0 },
+    /* Socket */		{ "[]", ATTR(YELLOW, BLACK) | A_BOLD, 0 },
+    /* Exit */			{ "::", ATTR(WHITE, BLUE) | A_BOLD, 0 },
+    /* ICChip */		{ "<>", ATTR(YELLOW, BLACK) | A_BOLD, 0 },
+    /* Key_Red */		{ "-o", ATTR(RED, BLACK) | A_BOLD, 0 },
+    /* Key_Blue */		{ "-o", ATTR(BLUE, BLACK) | A_BOLD, 0 },
+    /* Key_Yellow */		{ "-o", ATTR(YELLOW, BLACK) | A_BOLD, 0 },
+    /* Key_Green */		{ "-o", ATTR(GREEN, BLACK) | A_BOLD, 0 },
+    /* Boots_Ice */		{ "b:", ATTR(CYAN, BLACK) | A_BOLD, 0 },
+    /* Boots_Slide */		{ "b>", ATTR(GREEN, BLACK) | A_BOLD, 0 },
+    /* Boots_Fire */		{ "b^", ATTR(RED, BLACK) | A_BOLD, 0 },
+    /* Boots_Water */		{ "b~", ATTR(BLUE, BLACK) | A_BOLD, 0 },
+    /* Block_Static */		{ "[]", ATTR(BLACK, YELLOW), 0 },
+    /* Drowned_Chip */		{ "@~", ATTR(YELLOW, BLUE) | A_BOLD, 0 },
+    /* Burned_Chip */		{ "@^", ATTR(YELLOW, RED) | A_BOLD, 0 },
+    /* Bombed_Chip */		{ "@*", ATTR(YELLOW, RED) | A_BOLD, 0 },
+    /* Exited_Chip */		{ "@:", ATTR(YELLOW, BLUE) | A_BOLD, 0 },
+    /* Exit_Extra_1 */		{ "::", ATTR(CYAN, BLUE) | A_BOLD, 0 },
+    /* Exit_Extra_2 */		{ "::", ATTR(WHITE, BLUE), 0 },
+    /* Overlay_Buffer */	{ "??", ATTR(MAGENTA, BLACK), 0 },
+    /* Floor_Reserved2 */	{ "??", ATTR(MAGENTA, BLACK), 0 },
+    /* Floor_Reserved1 */	{ "??", ATTR(MAGENTA, BLACK), 0 }
+};
+
+/* The creatures, indexed by their tile ID without the direction.
+ */
+static tileglyph const creatureglyphs[] = {
+    /* Chip */			{ "@", ATTR(YELLOW, BLACK) | A_BOLD, 1 },
+    /* Block */			{ "[", ATTR(BLACK, YELLOW), 0 },
+    /* Tank */			{ "T", ATTR(BLUE, BLACK) | A_BOLD, 1 },
+    /* Ball */			{ "O", ATTR(MAGENTA, BLACK) | A_BOLD, 0 },
+    /* Glider */		{ "G", ATTR(CYAN, BLACK) | A_BOLD, 1 },
+    /* Fireball */		{ "*", ATTR(RED, BLACK) | A_BOLD, 0 },
+    /* Walker */		{ "W", ATTR(WHITE, BLACK) | A_BOLD, 1 },
+    /* Blob */			{ "%", ATTR(GREEN, BLACK) | A_BOLD, 0 },
+    /* Teeth */			{ "M", ATTR(RED, BLACK) | A_BOLD, 1 },
+    /* Bug */			{ "B", ATTR(RED, BLACK), 1 },
+    /* Paramecium */		{ "P", ATTR(MAGENTA, BLACK), 1 },
+    /* Swimming_Chip */		{ "@", ATTR(YELLOW, BLUE) | A_BOLD, 1 },
+    /* Pushing_Chip */		{ "@", ATTR(YELLOW, BLACK) | A_BOLD, 1 },
+    /* Entity_Reserved2 */	{ "?", ATTR(MAGENTA, BLACK), 0 },
+    /* Entity_Reserved1 */	{ "?", ATTR(MAGENTA, BLACK), 0 }
+};
+
+/* The animations.
+ */
+static tileglyph const animationglyphs[] = {
+    /* Water_Splash */		{ "~", ATTR(WHITE, BLUE) | A_BOLD, 0 },
+    /* Bomb_Explosion */	{ "*", ATTR(YELLOW, RED) | A_BOLD, 0 },
+    /* Entity_Explosion */	{ "*", ATTR(RED, BLACK) | A_BOLD, 0 },
+    /* Animation_Reserved1 */	{ "?", ATTR(MAGENTA, BLACK), 0 }
+};
+
+/* The display as it is to be shown, and as the terminal is currently
+ * showing it. Each update sends only the cells that differ between
+ * the two. If showninvalid is TRUE, the terminal's contents are
+ * unknown, and it is cleared before everything is sent again.
+ */
+static ttycell	       *composed = NULL;
+static ttycell	       *shown = NULL;
+static int		showninvalid = TRUE;
+
+/* The position of the terminal's cursor, or -1 if it is unknown, and
+ * the attributes that it is currently writing with, or -1 if they are
+ * unknown.
+ */
+static int		cursorx = -1, cursory = -1;
+static int		cursorattr = -1;
+
+/* The bytes to be written to the terminal in the next update.
+ */
+static char	       *outbuf = NULL;
+static int		outlen = 0;
+static int		outsize = 0;
+
+/* The attributes used to render text, and the display's background.
+ */
+static int		textattr = ATTR(WHITE, BLACK);
+static int		boldattr = ATTR(YELLOW, BLACK) | A_BOLD;
+static int		dimattr = ATTR(WHITE, BLACK) | A_DIM;
+static int		bkgndcolor = BLACK;
+
+/* The message display.
+ */
+static msgdisplayinfo	msgdisplay;
+
+/* Coordinates specifying the placement of the various screen elements.
+ */
+static ttyrect		displayloc = { 1, 1, NXTILES * TILEW, NYTILES };
+static ttyrect		frameloc = { 0, 0, NXTILES * TILEW + 2, NYTILES + 2 };
+static ttyrect		titleloc = { 0, 12, NXTILES * TILEW + 2, 3 };
+static ttyrect		infoloc = { 22, 1, 40, 6 };
+static ttyrect		rinfoloc = { 30, 4, 6, 2 };
+static ttyrect		invloc = { 22, 8, 4 * TILEW, 2 };
+static ttyrect		hintloc = { 22, 11, 56, 10 };
+static ttyrect		rscoreloc = { 68, 13, 10, 4 };
+static ttyrect		messageloc = { 0, 22, 80, 1 };
+static ttyrect		promptloc = { 72, 23, 8, 1 };
+
+/*
+ * Sending the display to the terminal.
+ */
+
+/* Append the given bytes to the output.
+ */
+static void outbytes(char const *bytes, int len)
+{
+    if (outlen + len > outsize) {
+	outsize = outsize ? 2 * outsize : 4096;
+	while (outlen + len > outsize)
+	    outsize *= 2;
+	if (!(outbuf = realloc(outbuf, outsize)))
+	    memerrexit();
+    }
+    memcpy(outbuf + outlen, bytes, len);
+    outlen += len;
+}
+
+/* Append a string to the output.
+ */
+static void outstr(char const *str)
+{
+    outbytes(str, strlen(str));
+}
+
+/* Return the number of bytes needed to send the given character.
+ * Characters outside of ASCII are sent in UTF-8.
+ */
+static int charbytes(int ch)
+{
+    return ch >= 0x80 ? 2 : 1;
+}
+
+/* Append a cell's character to the output. Control characters are
+ * replaced with a question mark.
+ */
+static void outchar(int ch)
+{
+    char	buf[2];
+
+    if (ch < 0x20 || ch == 0x7F) {
+	outbytes("?", 1);
+    } else if (ch >= 0x80) {
+	buf[0] = 0xC0 | (ch >> 6);
+	buf[1] = 0x80 | (ch & 0x3F);
+	outbytes(buf, 2);
+    } else {
+	buf[0] = ch;
+	outbytes(buf, 1);
+    }
+}
+
+/* Return the number of digits in a positive number.
+ */
+static int numlen(int n)
+{
+    int	len;
+
+    for (len = 1 ; n >= 10 ; n /= 10)
+	++len;
+    return len;
+}
+
+/* Return the number of bytes needed to move the cursor right by n
+ * cells by writing out the cells in between again, or a large value
+ * if doing so would require changing attributes.
+ */
+static int rewritecost(int x, int y, int n)
+{
+    ttycell const      *cell;
+    ttycell		cur;
+    int			cost = 0;
+
+    if (cursorattr < 0)
+	return 1000;
+    cur.attr = cursorattr;
+    cell = shown + y * ttyg.width + x;
+    for ( ; n ; --n, ++cell) {
+	cur.ch = cell->ch;
+	if (!samecell(cell, &cur))
+	    return 1000;
+	cost += charbytes(cell->ch);
+    }
+    return cost;
+}
+
+/* Move the cursor to (x, y), choosing whichever escape sequence (or
+ * plain characters) needs the fewest bytes to get there.
+ */
+static void movecursor(int x, int y)
+{
+    char	buf[32];
+    int		cost, best, i;
+
+    if (cursory == y && cursorx == x)
+	return;
+
+    best = 4 + numlen(y + 1) + numlen(x + 1);
+    if (cursory == y && cursorx >= 0 && x > cursorx) {
+	cost = x - cursorx == 1 ? 3 : 3 + numlen(x - cursorx);
+	if (rewritecost(cursorx, y, x - cursorx) <= cost
+			&& rewritecost(cursorx, y, x - cursorx) <= best) {
+	    for (i = cursorx ; i < x ; ++i)
+		outchar(shown[y * ttyg.width + i].ch);
+	} else if (cost <= best) {
+	    if (x - cursorx == 1)
+		outstr("\033[C");
+	    else {
+		sprintf(buf, "\033[%dC", x - cursorx);
+		outstr(buf);
+	    }
+	} else {
+	    sprintf(buf, "\033[%d;%dH", y + 1, x + 1);
+	    outstr(buf);
+	}
+    } else if (cursory == y && cursorx >= 0 && x < cursorx
+			    && 3 + numlen(cursorx - x) < best) {
+	sprintf(buf, "\033[%dD", cursorx - x);
+	outstr(buf);
+    } else if (cursory >= 0 && y == cursory + 1 && x == 0) {
+	outstr("\r\n");
+    } else if (x == 0 && y == 0) {
+	outstr("\033[H");
+    } else {
+	sprintf(buf, "\033[%d;%dH", y + 1, x + 1);
+	outstr(buf);
+    }
+    cursorx = x;
+    cursory = y;
+}
+
+/* Change the attributes that the terminal writes with, sending only
+ * the parts that differ from the current ones.
+ */
+static void setattr(int attr)
+{
+    char	buf[32];
+    char       *p;
+
+    if (attr == cursorattr)
+	return;
+    p = buf;
+    p += sprintf(p, "\033[");
+    if (cursorattr < 0) {
+	p += sprintf(p, "0;");
+	cursorattr = ATTR(WHITE, BLACK) ^ 0x3F;
+    }
+    if (intensity(attr) != intensity(cursorattr)) {
+	if (intensity(cursorattr))
+	    p += sprintf(p, "22;");
+	if (attr & A_BOLD)
+	    p += sprintf(p, "1;");
+	else if (attr & A_DIM)
+	    p += sprintf(p, "2;");
+    }
+    if (fgcolor(attr) != fgcolor(cursorattr))
+	p += sprintf(p, "%d;", 30 + fgcolor(attr));
+    if (bgcolor(attr) != bgcolor(cursorattr))
+	p += sprintf(p, "%d;", 40 + bgcolor(attr));
+    p[-1] = 'm';
+    outstr(buf);
+    cursorattr = attr;
+}
+
+/* Write out the output, all at once.
+ */
+static void sendoutput(void)
+{
+    char const *p;
+    int		n;
+
+    p = outbuf;
+    while (outlen > 0) {
+	n = write(ttyg.fd, p, outlen);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	p += n;
+	outlen -= n;
+    }
+    outlen = 0;
+}
+
+/* Send the cells of the display that have changed since the last
+ * update to the terminal. The terminal's cursor is left wherever the
+ * last change was made. A cell written in the last column may leave
+ * the cursor waiting to wrap around, so its position is forgotten.
+ */
+void _ttyflush(void)
+{
+    ttycell const      *from;
+    ttycell	       *to;
+    int			x, y, n;
+
+    if (!composed || !ttyg.active)
+	return;
+
+    if (showninvalid) {
+	cursorattr = -1;
+	setattr(ATTR(WHITE, bkgndcolor));
+	outstr("\033[H\033[2J");
+	cursorx = cursory = 0;
+	n = ttyg.width * ttyg.height;
+	for (to = shown ; n ; --n, ++to) {
+	    to->ch = ' ';
+	    to->attr = ATTR(WHITE, bkgndcolor);
+	}
+	showninvalid = FALSE;
+    }
+
+    from = composed;
+    to = shown;
+    for (y = 0 ; y < ttyg.height ; ++y) {
+	for (x = 0 ; x < ttyg.width ; ++x, ++from, ++to) {
+	    if (samecell(from, to))
+		continue;
+	    movecursor(x, y);
+	    setattr(from->attr);
+	    outchar(from->ch);
+	    *to = *from;
+	    cursorx = x + 1 < ttyg.width ? x + 1 : -1;
+	}
+    }
+    sendoutput();
+}
+
+/* Determine the size of the terminal, and resize the display to match
+ * if necessary. Then forget what the terminal is showing, so that the
+ * next update sends all of the display.
+ */
+void _ttyinvalidate(void)
+{
+    struct winsize	ws;
+    ttycell	       *buf;
+    int			w, h, y, n;
+
+    w = DEFAULTWIDTH;
+    h = DEFAULTHEIGHT;
+    if (ioctl(ttyg.fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col && ws.ws_row) {
+	w = ws.ws_col;
+	h = ws.ws_row;
+    }
+    if (!composed || w != ttyg.width || h != ttyg.height) {
+	if (!(buf = malloc(w * h * sizeof *buf)))
+	    memerrexit();
+	for (n = 0 ; n < w * h ; ++n) {
+	    buf[n].ch = ' ';
+	    buf[n].attr = ATTR(WHITE, bkgndcolor);
+	}
+	if (composed) {
+	    n = w < ttyg.width ? w : ttyg.width;
+	    for (y = 0 ; y < h && y < ttyg.height ; ++y)
+		memcpy(buf + y * w, composed + y * ttyg.width,
+		       n * sizeof *buf);
+	    free(composed);
+	}
+	composed = buf;
+	free(shown);
+	if (!(shown = malloc(w * h * sizeof *shown)))
+	    memerrexit();
+	ttyg.width = w;
+	ttyg.height = h;
+    }
+    showninvalid = TRUE;
+    cursorx = cursory = -1;
+    cursorattr = -1;
+}
+
+/*
+ * Composing the display.
+ */
+
+/* Set a cell of the display, if it lies within the display.
+ */
+static void putcell(int x, int y, int ch, int attr)
+{
+    ttycell    *cell;
+
+    if (x < 0 || y < 0 || x >= ttyg.width || y >= ttyg.height)
+	return;
+    cell = composed + y * ttyg.width + x;
+    cell->ch = ch;
+    cell->attr = attr;
+}
+
+/* Return the attributes for text drawn with the given flags.
+ */
+static int textflagsattr(int flags)
+{
+    if (flags & PT_HILIGHT)
+	return boldattr;
+    if (flags & PT_DIM)
+	return dimattr;
+    return textattr;
+}
+
+/* Draw one line of text at the top of rect, erasing the rest of the
+ * line, and aligned according to flags. The text is clipped to the
+ * width of rect.
+ */
+static void drawtext(ttyrect *rect, unsigned char const *text, int len,
+		     int flags)
+{
+    int	attr, x, n;
+
+    if (flags & PT_CALCSIZE) {
+	rect->w = len;
+	rect->h = 1;
+	return;
+    }
+    if (rect->h <= 0)
+	return;
+
+    if (len > rect->w)
+	len = rect->w;
+    x = 0;
+    if (flags & PT_RIGHT)
+	x = rect->w - len;
+    else if (flags & PT_CENTER)
+	x = (rect->w - len) / 2;
+    attr = textflagsattr(flags);
+    for (n = 0 ; n < rect->w ; ++n)
+	putcell(rect->x + n, rect->y,
+		n >= x && n < x + len ? text[n - x] : ' ', attr);
+
+    if (flags & PT_UPDATERECT) {
+	++rect->y;
+	--rect->h;
+    }
+}
+
+/* Find the end of the first line of text when it is broken up on
+ * whitespace to fit in the given width. The length of the line is
+ * returned, and the length of the line plus the whitespace following
+ * it is stored in next.
+ */
+static int breakline(unsigned char const *text, int len, int width,
+		     int *next)
+{
+    int	brk, n;
+
+    brk = -1;
+    for (n = 0 ; n < len ; ++n) {
+	if (text[n] == '\n') {
+	    *next = n + 1;
+	    return n;
+	}
+	if (isspace(text[n]))
+	    brk = n;
+	else if (n >= width)
+	    break;
+    }
+    if (n == len) {
+	*next = len;
+	return len;
+    }
+    if (brk < 0) {
+	*next = n > 0 ? n : 1;
+	return *next;
+    }
+    for (n = brk ; n < len && text[n] == ' ' ; ++n) ;
+    *next = n;
+    return brk;
+}
+
+/* Draw one or more lines of text at the position given by rect. The
+ * text is broken up on whitespace whenever possible.
+ */
+static void drawmultilinetext(ttyrect *rect, unsigned char const *text,
+			      int len, int flags)
+{
+    ttyrect	area;
+    int		skip, lines, linelen, next;
+
+    if (flags & PT_CALCSIZE) {
+	for (lines = 0 ; len > 0 ; ++lines) {
+	    breakline(text, len, rect->w, &next);
+	    text += next;
+	    len -= next;
+	}
+	rect->h = lines;
+	return;
+    }
+
+    area = *rect;
+    skip = flags & PT_SKIPLINES(0xFF);
+    while (len > 0 && area.h > 0) {
+	linelen = breakline(text, len, rect->w, &next);
+	if (skip)
+	    --skip;
+	else
+	    drawtext(&area, text, linelen, flags | PT_UPDATERECT);
+	text += next;
+	len -= next;
+    }
+    if (flags & PT_UPDATERECT) {
+	*rect = area;
+    } else {
+	while (area.h > 0)
+	    drawtext(&area, NULL, 0, PT_UPDATERECT);
+    }
+}
+
+/* Display a line (or more) of text. The text is clipped to area if
+ * necessary. len specifies the number of characters to render; -1 can
+ * be used if text is NUL-terminated. flags is some combination of the
+ * PT_* flags. When the PT_CALCSIZE flag is set, no drawing is done;
+ * instead the w and h fields of area area changed to define the
+ * smallest rectangle that encloses the text that would have been
+ * rendered. (If PT_MULTILINE is also set, only the h field is
+ * changed.) If PT_UPDATERECT is set instead, then the h field is
+ * changed, so as to exclude the rectangle that was drawn in.
+ */
+static void puttext(ttyrect *area, char const *text, int len, int flags)
+{
+    if (len < 0)
+	len = text ? strlen(text) : 0;
+    if (flags & PT_MULTILINE)
+	drawmultilinetext(area, (unsigned char const*)text, len, flags);
+    else
+	drawtext(area, (unsigned char const*)text, len, flags);
+}
+
+/* Store the glyph of a tile in out, which receives the two characters
+ * and the attributes. dir is the direction of a creature, when id
+ * does not include it.
+ */
+static void gettileglyph(int id, int dir, ttycell *out)
+{
+    tileglyph const    *g;
+    int			d;
+
+    if (isanimation(id)) {
+	g = animationglyphs + (id - Water_Splash);
+	d = -1;
+    } else if (iscreature(id)) {
+	g = creatureglyphs + ((id - Chip) >> 2);
+	d = dir ? diridx(dir) : id & 3;
+    } else if (id < (int)(sizeof floorglyphs / sizeof *floorglyphs)) {
+	g = floorglyphs + id;
+	d = -1;
+    } else {
+	g = floorglyphs + Overlay_Buffer;
+	d = -1;
+    }
+
+    out[0].attr = out[1].attr = g->attr;
+    if (d < 0) {
+	out[0].ch = g->text[0];
+	out[1].ch = g->text[1] ? g->text[1] : g->text[0];
+    } else if (!g->dirchar) {
+	out[0].ch = out[1].ch = g->text[0];
+    } else {
+	switch (d) {
+	  case 0: out[0].ch = g->text[0]; out[1].ch = '^';	   break;
+	  case 1: out[0].ch = '<';	   out[1].ch = g->text[0]; break;
+	  case 2: out[0].ch = g->text[0]; out[1].ch = 'v';	   break;
+	  case 3: out[0].ch = g->text[0]; out[1].ch = '>';	   break;
+	}
+    }
+}
+
+/* Draw a tile's glyph at (x, y). A glyph without a background of its
+ * own takes on the background given by bkgnd, which can be -1 to use
+ * the display's background.
+ */
+static void drawglyph(int x, int y, ttycell const *glyph, int bkgnd)
+{
+    int	attr, n;
+
+    for (n = 0 ; n < TILEW ; ++n) {
+	attr = glyph[n].attr;
+	if (bgcolor(attr) == BLACK)
+	    attr = (attr & ~ATTR(0, 7))
+		 | ATTR(0, bkgnd >= 0 ? bkgnd : bkgndcolor);
+	putcell(x + n, y, glyph[n].ch, attr);
+    }
+}
+
+/* Draw a generic tile image at (x, y).
+ */
+static void drawtile(int x, int y, int id)
+{
+    ttycell	glyph[TILEW];
+
+    gettileglyph(id, NIL, glyph);
+    drawglyph(x, y, glyph, -1);
+}
+
+/* Draw a box around the inside edge of rect.
+ */
+static void drawbox(ttyrect const *rect, int attr)
+{
+    int	x, y;
+
+    for (x = rect->x + 1 ; x < rect->x + rect->w - 1 ; ++x) {
+	putcell(x, rect->y, '-', attr);
+	putcell(x, rect->y + rect->h - 1, '-', attr);
+    }
+    for (y = rect->y + 1 ; y < rect->y + rect->h - 1 ; ++y) {
+	putcell(rect->x, y, '|', attr);
+	putcell(rect->x + rect->w - 1, y, '|', attr);
+    }
+    putcell(rect->x, rect->y, '+', attr);
+    putcell(rect->x + rect->w - 1, rect->y, '+', attr);
+    putcell(rect->x, rect->y + rect->h - 1, '+', attr);
+    putcell(rect->x + rect->w - 1, rect->y + rect->h - 1, '+', attr);
+}
+
+/*
+ * Message display function.
+ */
+
+/* Return the current time in milliseconds.
+ */
+static unsigned long getmilliseconds(void)
+{
+    return _ttygetmicroseconds() / 1000;
+}
+
+/* Refresh the message-display message. If update is TRUE, the
+ * terminal is updated immediately.
+ */
+static void displaymsg(int update)
+{
+    int	f;
+
+    if (!composed)
+	return;
+    if ((long)(msgdisplay.until - getmilliseconds()) < 0) {
+	*msgdisplay.msg = '\0';
+	msgdisplay.msglen = 0;
+	f = 0;
+    } else {
+	f = PT_CENTER;
+	if ((long)(msgdisplay.bolduntil - getmilliseconds()) < 0)
+	    f |= PT_DIM;
+	else
+	    f |= PT_HILIGHT;
+    }
+    puttext(&messageloc, msgdisplay.msg, msgdisplay.msglen, f);
+    if (update)
+	_ttyflush();
+}
+
+/* Change the current message-display message. msecs gives the number
+ * of milliseconds to display the message, and bold specifies the
+ * number of milliseconds to display the message highlighted.
+ */
+int setdisplaymsg(char const *msg, int msecs, int bold)
+{
+    if (!msg || !*msg) {
+	*msgdisplay.msg = '\0';
+	msgdisplay.msglen = 0;
+	msgdisplay.until = getmilliseconds() - 1;
+	msgdisplay.bolduntil = msgdisplay.until;
+    } else {
+	msgdisplay.msglen = strlen(msg);
+	if (msgdisplay.msglen >= sizeof msgdisplay.msg)
+	    msgdisplay.msglen = sizeof msgdisplay.msg - 1;
+	memcpy(msgdisplay.msg, msg, msgdisplay.msglen);
+	msgdisplay.msg[msgdisplay.msglen] = '\0';
+	msgdisplay.until = getmilliseconds() + msecs;
+	msgdisplay.bolduntil = getmilliseconds() + bold;
+    }
+    displaymsg(TRUE);
+    return TRUE;
+}
+
+/*
+ * The main display functions.
+ */
+
+/* Create a string representing a decimal number.
+ */
+static char const *decimal(long number, int places)
+{
+    static char	buf[32];
+
+    sprintf(buf, "%0*ld", places, number);
+    return buf;
+}
+
+/* Return the position of the left or top edge of the map view, in
+ * tiles, for a view centered on viewpos (in eighths of a tile).
+ * visible is the number of tiles visible and size the size of the
+ * map.
+ */
+static int mapviewedge(int viewpos, int visible, int size)
+{
+    int	edge;
+
+    edge = (viewpos + 4) / 8 - visible / 2;
+    if (edge < 0)
+	edge = 0;
+    if (edge > size - visible)
+	edge = size - visible;
+    return edge;
+}
+
+/* Render the view of the visible area of the map, with the view
+ * position centered on the display as much as possible. Each cell
+ * shows its top tile, on the background of its bottom tile if the top
+ * tile has none of its own, and the creatures are shown in the cells
+ * that they are moving into. Only the cells of the display whose
+ * contents have changed will be sent to the terminal.
+ */
+static void displaymapview(gamestate const *state)
+{
+    ttycell		glyph[TILEW], bot[TILEW];
+    creature const     *cr;
+    int			xdisp, ydisp, x, y, pos;
+
+    drawbox(&frameloc, dimattr);
+    if (state->statusflags & SF_SHUTTERED) {
+	for (y = 0 ; y < displayloc.h ; ++y)
+	    for (x = 0 ; x < displayloc.w ; ++x)
+		putcell(displayloc.x + x, displayloc.y + y, '/', dimattr);
+	return;
+    }
+
+    xdisp = mapviewedge(state->xviewpos, NXTILES, CXGRID);
+    ydisp = mapviewedge(state->yviewpos, NYTILES, CYGRID);
+
+    for (y = 0 ; y < NYTILES ; ++y) {
+	for (x = 0 ; x < NXTILES ; ++x) {
+	    pos = (ydisp + y) * CXGRID + xdisp + x;
+	    gettileglyph(state->map[pos].bot.id, NIL, bot);
+	    gettileglyph(state->map[pos].top.id, NIL, glyph);
+	    drawglyph(displayloc.x + x * TILEW, displayloc.y + y, glyph,
+		      bgcolor(bot[0].attr) == BLACK ? -1
+						   : bgcolor(bot[0].attr));
+	}
+    }
+
+    for (cr = state->creatures ; cr->id ; ++cr) {
+	if (cr->hidden)
+	    continue;
+	x = cr->pos % CXGRID - xdisp;
+	y = cr->pos / CXGRID - ydisp;
+	if (x < 0 || x >= NXTILES || y < 0 || y >= NYTILES)
+	    continue;
+	pos = cr->pos;
+	gettileglyph(state->map[pos].top.id, NIL, bot);
+	if (bgcolor(bot[0].attr) == BLACK)
+	    gettileglyph(state->map[pos].bot.id, NIL, bot);
+	gettileglyph(cr->id, cr->dir, glyph);
+	drawglyph(displayloc.x + x * TILEW, displayloc.y + y, glyph,
+		  bgcolor(bot[0].attr) == BLACK ? -1 : bgcolor(bot[0].attr));
+    }
+}
+
+/* Render all the various nuggets of data that comprise the
+ * information display. timeleft and besttime supply the current timer
+ * value and the player's best recorded time as measured in seconds.
+ * The level's title, number, password, and hint, the count of chips
+ * needed, and the keys and boots in possession are all used as well
+ * in creating the display.
+ */
+static void displayinfo(gamestate const *state, int timeleft, int besttime)
+{
+    ttyrect	rect, rrect;
+    char const *overlay;
+    char	buf[512];
+    int		n;
+
+    puttext(&titleloc, state->game->name, -1, PT_MULTILINE | PT_CENTER);
+
+    rect = infoloc;
+
+    if (state->game->number) {
+	sprintf(buf, "Level %d", state->game->number);
+	puttext(&rect, buf, -1, PT_UPDATERECT);
+    } else
+	puttext(&rect, "", 0, PT_UPDATERECT);
+
+    if (*state->game->passwd) {
+	sprintf(buf, "Password: %s", state->game->passwd);
+	puttext(&rect, buf, -1, PT_UPDATERECT);
+    } else
+	puttext(&rect, "", 0, PT_UPDATERECT);
+
+    puttext(&rect, "", 0, PT_UPDATERECT);
+
+    puttext(&rect, "Chips", 5, PT_UPDATERECT);
+    puttext(&rect, "Time", 4, PT_UPDATERECT);
+    rrect = rinfoloc;
+    rrect.h = 1;
+    puttext(&rrect, decimal(state->chipsneeded, 0), -1, PT_RIGHT);
+    ++rrect.y;
+    if (timeleft == TIME_NIL)
+	puttext(&rrect, "---", -1, PT_RIGHT);
+    else
+	puttext(&rrect, decimal(timeleft, 0), -1, PT_RIGHT);
+    if (state->stepping) {
+	if (state->stepping < 4)
+	    sprintf(buf, "   (+%d)", state->stepping);
+	else if (state->stepping > 4)
+	    sprintf(buf, "   (odd+%d)", state->stepping & 3);
+	else
+	    sprintf(buf, "   (odd)");
+	rrect.x += rrect.w;
+	rrect.w = infoloc.x + infoloc.w - rrect.x;
+	puttext(&rrect, buf, -1, 0);
+    }
+
+    if (besttime != TIME_NIL) {
+	if (timeleft == TIME_NIL)
+	    sprintf(buf, "(Best time: %d)", besttime);
+	else
+	    sprintf(buf, "Best time: %d", besttime);
+	n = (state->game->sgflags & SGF_REPLACEABLE) ? PT_DIM : 0;
+	puttext(&rect, buf, -1, PT_UPDATERECT | n);
+    }
+    fillrect(&rect);
+
+    for (n = 0 ; n < 4 ; ++n) {
+	drawtile(invloc.x + n * TILEW, invloc.y,
+		 state->keys[n] ? Key_Red + n : Empty);
+	drawtile(invloc.x + n * TILEW, invloc.y + 1,
+		 state->boots[n] ? Boots_Ice + n : Empty);
+    }
+
+    if (state->statusflags & SF_INVALID) {
+	puttext(&hintloc, "This level cannot be played.", -1, PT_MULTILINE);
+    } else if (state->currenttime < 0 && state->game->unsolvable) {
+	if (*state->game->unsolvable) {
+	    sprintf(buf, "This level is reported to be unsolvable: %s.",
+			 state->game->unsolvable);
+	    puttext(&hintloc, buf, -1, PT_MULTILINE);
+	} else {
+	    puttext(&hintloc, "This level is reported to be unsolvable.", -1,
+			      PT_MULTILINE);
+	}
+    } else if (state->statusflags & SF_SHOWHINT) {
+	puttext(&hintloc, state->hinttext, -1, PT_MULTILINE | PT_CENTER);
+    } else if ((overlay = telemetryoverlay())) {
+	puttext(&hintloc, overlay, -1, PT_MULTILINE | PT_DIM);
+    } else {
+	fillrect(&hintloc);
+    }
+
+    fillrect(&promptloc);
+}
+
+/* Display a prompt in the lower right-hand corner. completed is -1,
+ * 0, or +1, depending on which prompt is being requested.
+ */
+static int displayprompticon(int completed)
+{
+    ttyrect	rect;
+
+    rect.x = ttyg.width - promptloc.w;
+    rect.y = ttyg.height - 1;
+    rect.w = promptloc.w;
+    rect.h = 1;
+    puttext(&rect, completed > 0 ? "[more]" : completed < 0 ? "[back]"
+							    : "[done]",
+	    -1, PT_RIGHT | PT_DIM);
+    return TRUE;
+}
+
+/* Draw a title at the bottom of the display.
+ */
+static void displaytitle(char const *title)
+{
+    ttyrect	rect;
+
+    rect.x = 1;
+    rect.y = ttyg.height - 1;
+    rect.w = ttyg.width - promptloc.w - 2;
+    rect.h = 1;
+    puttext(&rect, title, -1, 0);
+}
+
+/*
+ * Tables.
+ */
+
+/* Return the row of the table to measure after row j. A table that
+ * produces its rows on demand and has too many of them to measure
+ * them all quickly is measured from the rows at either end plus an
+ * even sample of the rows in between.
+ */
+static int nextmeasuredrow(tablespec const *table, int j)
+{
+    int	last;
+
+    last = table->rows - MEASUREDENDROWS;
+    if (!table->getrow || table->rows <= 2 * MEASUREDENDROWS
+					 + MEASUREDMIDROWS)
+	return j + 1;
+    if (j < MEASUREDENDROWS || j >= last)
+	return j + 1;
+    j += (last - MEASUREDENDROWS) / MEASUREDMIDROWS;
+    return j < last ? j : last;
+}
+
+/* Lay out the columns of the given table so that the entire table
+ * fits within area (horizontally; no attempt is made to make it fit
+ * vertically). Return an array of rectangles, one per column. This is
+ * the same algorithm as used by the SDL layer, with every character
+ * one cell wide.
+ */
+static ttyrect *measuretable(ttyrect const *area, tablespec const *table)
+{
+    ttyrect		       *colsizes;
+    char const		      **cells;
+    char const * const	       *row;
+    int				sep, mlindex, mlwidth, diff;
+    int				i, j, k, n, i0, c, w, x;
+
+    if (!(colsizes = malloc(table->cols * sizeof *colsizes)))
+	memerrexit();
+    if (!(cells = malloc(table->cols * sizeof *cells)))
+	memerrexit();
+    for (i = 0 ; i < table->cols ; ++i) {
+	colsizes[i].x = 0;
+	colsizes[i].y = area->y;
+	colsizes[i].w = 0;
+	colsizes[i].h = area->h;
+    }
+
+    mlindex = -1;
+    mlwidth = 0;
+    n = 0;
+    for (j = 0 ; j < table->rows ; j = nextmeasuredrow(table, j)) {
+	if (table->getrow)
+	    n = j;
+	row = gettablerow(table, &n, cells);
+	for (i = 0, k = 0 ; i < table->cols ; ++k) {
+	    c = row[k][0] - '0';
+	    if (c == 1) {
+		w = strlen(row[k] + 2);
+		if (row[k][1] == '!') {
+		    if (w > mlwidth || mlindex != i)
+			mlwidth = w;
+		    mlindex = i;
+		} else {
+		    if (w > colsizes[i].w)
+			colsizes[i].w = w;
+		}
+	    }
+	    i += c;
+	}
+    }
+
+    sep = table->sep;
+    w = -sep;
+    for (i = 0 ; i < table->cols ; ++i)
+	w += colsizes[i].w + sep;
+    diff = area->w - w;
+    if (diff < 0 && table->collapse >= 0) {
+	w = -diff;
+	if (colsizes[table->collapse].w < w)
+	    w = colsizes[table->collapse].w - 1;
+	colsizes[table->collapse].w -= w;
+	diff += w;
+    }
+
+    if (diff > 0) {
+	n = 0;
+	for (j = 0 ; j < table->rows && diff > 0
+		   ; j = nextmeasuredrow(table, j)) {
+	    if (table->getrow)
+		n = j;
+	    row = gettablerow(table, &n, cells);
+	    for (i = 0, k = 0 ; i < table->cols ; ++k) {
+		c = row[k][0] - '0';
+		if (c > 1 && row[k][1] != '!') {
+		    w = sep + strlen(row[k] + 2);
+		    for (i0 = i ; i0 < i + c ; ++i0)
+			w -= colsizes[i0].w + sep;
+		    if (w > 0) {
+			if (table->collapse >= i && table->collapse < i + c)
+			    i0 = table->collapse;
+			else if (mlindex >= i && mlindex < i + c)
+			    i0 = mlindex;
+			else
+			    i0 = i + c - 1;
+			if (w > diff)
+			    w = diff;
+			colsizes[i0].w += w;
+			diff -= w;
+			if (diff == 0)
+			    break;
+		    }
+		}
+		i += c;
+	    }
+	}
+    }
+    if (diff > 0 && mlindex >= 0 && colsizes[mlindex].w < mlwidth) {
+	mlwidth -= colsizes[mlindex].w;
+	w = mlwidth < diff ? mlwidth : diff;
+	colsizes[mlindex].w += w;
+	diff -= w;
+    }
+
+    x = 0;
+    for (i = 0 ; i < table->cols && x < area->w ; ++i) {
+	colsizes[i].x = area->x + x;
+	x += colsizes[i].w + sep;
+	if (x >= area->w)
+	    colsizes[i].w = area->x + area->w - colsizes[i].x;
+    }
+    for ( ; i < table->cols ; ++i) {
+	colsizes[i].x = area->x + area->w;
+	colsizes[i].w = 0;
+    }
+
+    free(cells);
+    return colsizes;
+}
+
+/* Draw a single row of a table, using cols to locate the entries in
+ * the individual columns. row points to the position of the row, and
+ * is updated to the position of the following row. If cols is NULL,
+ * the row is skipped without drawing.
+ */
+static int drawtablerow(tablespec const *table, ttyrect *cols,
+			int *row, int flags)
+{
+    ttyrect			rect;
+    char const		      **cells;
+    char const * const	       *items;
+    char const		       *p;
+    int				c, f, n, i, y;
+
+    if (!cols) {
+	if (table->getrow)
+	    ++*row;
+	else
+	    for (i = 0 ; i < table->cols ;
+			 i += table->items[(*row)++][0] - '0') ;
+	return TRUE;
+    }
+
+    if (!(cells = malloc(table->cols * sizeof *cells)))
+	memerrexit();
+    items = gettablerow(table, row, cells);
+
+    y = cols[0].y;
+    for (i = 0, n = 0 ; i < table->cols ; ++n) {
+	p = items[n];
+	c = p[0] - '0';
+	rect = cols[i];
+	i += c;
+	if (c > 1)
+	    rect.w = cols[i - 1].x + cols[i - 1].w - rect.x;
+	f = flags | PT_UPDATERECT;
+	if (p[1] == '+')
+	    f |= PT_RIGHT;
+	else if (p[1] == '.')
+	    f |= PT_CENTER;
+	if (p[1] == '!')
+	    f |= PT_MULTILINE;
+	puttext(&rect, p + 2, -1, f);
+	if (rect.y > y)
+	    y = rect.y;
+    }
+
+    free(cells);
+    for (i = 0 ; i < table->cols ; ++i) {
+	cols[i].h -= y - cols[i].y;
+	cols[i].y = y;
+    }
+
+    return TRUE;
+}
+
+/*
+ * The exported functions.
+ */
+
+/* Select the nearest of the terminal's colors for the four colors
+ * used to render text on the display. Bold text is drawn bold, and
+ * dim text faint.
+ */
+void setcolors(long bkgnd, long text, long bold, long dim)
+{
+    int	b, t, h, d;
+
+    if (bkgnd < 0)
+	bkgnd = 0x000000;
+    if (text < 0)
+	text = 0xFFFFFF;
+    if (bold < 0)
+	bold = 0xFFFF00;
+    if (dim < 0)
+	dim = 0xC0C0C0;
+
+    if (bkgnd == text || bkgnd == bold || bkgnd == dim) {
+	errmsg(NULL, "one or more text colors matches the background color; "
+		     "color scheme left unchanged.");
+	return;
+    }
+
+#define	nearestcolor(c)	((((c) >> 23) & 1) | (((c) >> 14) & 2) \
+					   | (((c) >> 5) & 4))
+    b = nearestcolor(bkgnd);
+    t = nearestcolor(text);
+    h = nearestcolor(bold);
+    d = nearestcolor(dim);
+#undef nearestcolor
+
+    bkgndcolor = b;
+    textattr = ATTR(t, b);
+    boldattr = ATTR(h, b) | A_BOLD;
+    dimattr = ATTR(d, b) | A_DIM;
+    showninvalid = TRUE;
+}
+
+/* Wipe the display.
+ */
+void cleardisplay(void)
+{
+    int	n;
+
+    if (!composed)
+	return;
+    for (n = 0 ; n < ttyg.width * ttyg.height ; ++n) {
+	composed[n].ch = ' ';
+	composed[n].attr = ATTR(WHITE, bkgndcolor);
+    }
+}
+
+/* Draw the game's display. state is a pointer to the gamestate
+ * structure.
+ */
+int displaygame(void const *state, int timeleft, int besttime)
+{
+    int	phase;
+
+    phase = beginphase(Phase_MapView);
+    displaymapview(state);
+    endphase(phase);
+    phase = beginphase(Phase_Info);
+    displayinfo(state, timeleft, besttime);
+    displaymsg(FALSE);
+    endphase(phase);
+    phase = beginphase(Phase_Update);
+    _ttyflush();
+    endphase(phase);
+    return TRUE;
+}
+
+/* Creatures can only be shown on ticks.
+ */
+int displaygameframe(void const *state)
+{
+    (void)state;
+    return TRUE;
+}
+
+/* Update the display to acknowledge the end of game play. completed
+ * is positive if the play was successful or negative if unsuccessful.
+ * If the latter, then the other arguments can contain point values
+ * that will be reported to the user.
+ */
+int displayendmessage(int basescore, int timescore, long totalscore,
+		      int completed)
+{
+    ttyrect	rect;
+    int		fullscore;
+
+    if (totalscore) {
+	fullscore = timescore + basescore;
+	fillrect(&hintloc);
+	rect = hintloc;
+	rect.h = 1;
+	puttext(&rect, "Level Completed", -1, PT_CENTER);
+	rect.x = hintloc.x;
+	rect.y = rscoreloc.y;
+	rect.w = rscoreloc.x - hintloc.x;
+	rect.h = rscoreloc.h;
+	puttext(&rect, "Time Bonus", -1, PT_UPDATERECT);
+	puttext(&rect, "Level Bonus", -1, PT_UPDATERECT);
+	puttext(&rect, "Level Score", -1, PT_UPDATERECT);
+	puttext(&rect, "Total Score", -1, PT_UPDATERECT);
+	rect = rscoreloc;
+	puttext(&rect, decimal(timescore, 4), -1, PT_RIGHT | PT_UPDATERECT);
+	puttext(&rect, decimal(basescore, 5), -1, PT_RIGHT | PT_UPDATERECT);
+	puttext(&rect, decimal(fullscore, 5), -1, PT_RIGHT | PT_UPDATERECT);
+	puttext(&rect, decimal(totalscore, 7), -1, PT_RIGHT | PT_UPDATERECT);
+    }
+    displayprompticon(completed);
+    _ttyflush();
+    return TRUE;
+}
+
+/* Render a sequence of paragraphs on the display. title is a short
+ * string to let the user know what they're looking at. completed
+ * determines the prompt that will be displayed in the lower
+ * right-hand corner. The callback function inputcallback is called
+ * repeatedly to determine how to scroll and when to exit. The final
+ * value returned by the callback will be the return value of the
+ * function.
+ */
+int displaytextscroll(char const *title, char const **paragraphs,
+		      int ppcount, int completed,
+		      int (*inputcallback)(int*))
+{
+    ttyrect	area, rect;
+    int	       *linecounts;
+    int		arealines, totallines, topline, maxtop, thumbh;
+    int		i, n;
+
+    cleardisplay();
+    displaytitle(title);
+    displayprompticon(completed);
+
+    area.w = ttyg.width * 2 / 3;
+    area.h = ttyg.height - 4;
+    area.x = (ttyg.width - area.w) / 2;
+    area.y = 2;
+    arealines = area.h;
+
+    if (!(linecounts = malloc(ppcount * sizeof *linecounts)))
+	memerrexit();
+    totallines = 0;
+    for (i = 0 ; i < ppcount ; ++i) {
+	rect = area;
+	puttext(&rect, paragraphs[i], -1, PT_MULTILINE | PT_CALCSIZE);
+	linecounts[i] = rect.h;
+	totallines += linecounts[i] + 1;
+    }
+    maxtop = totallines - arealines;
+    if (maxtop > 0) {
+	thumbh = area.h * arealines / totallines;
+	if (thumbh < 1)
+	    thumbh = 1;
+    } else {
+	maxtop = 0;
+	thumbh = 0;
+    }
+
+    topline = 0;
+    n = SCROLL_NOP;
+    do {
+	switch (n) {
+	  case SCROLL_NOP:						break;
+	  case SCROLL_UP:		--topline;			break;
+	  case SCROLL_DN:		++topline;			break;
+	  case SCROLL_HALFPAGE_UP:	topline -= arealines / 2;	break;
+	  case SCROLL_HALFPAGE_DN:	topline += arealines / 2;	break;
+	  case SCROLL_PAGE_UP:		topline -= arealines;		break;
+	  case SCROLL_PAGE_DN:		topline += arealines;		break;
+	  case SCROLL_ALLTHEWAY_UP:	topline = 0;			break;
+	  case SCROLL_ALLTHEWAY_DN:	topline = maxtop;		break;
+	  default:			topline = n;			break;
+	}
+	if (topline < 0)
+	    topline = 0;
+	else if (topline > maxtop)
+	    topline = maxtop;
+	fillrect(&area);
+	rect = area;
+	n = topline;
+	for (i = 0 ; i < ppcount ; ++i) {
+	    if (n >= linecounts[i]) {
+		n -= linecounts[i];
+	    } else {
+		puttext(&rect, paragraphs[i], -1,
+			PT_MULTILINE | PT_UPDATERECT | PT_SKIPLINES(n));
+		n = 0;
+	    }
+	    if (rect.h <= 1)
+		break;
+	    if (n) {
+		--n;
+	    } else {
+		++rect.y;
+		--rect.h;
+	    }
+	}
+	if (maxtop > 0) {
+	    n = topline * (area.h - thumbh) / maxtop;
+	    for (i = 0 ; i < area.h ; ++i)
+		putcell(area.x + area.w + 1, area.y + i,
+			i >= n && i < n + thumbh ? '#' : '|', dimattr);
+	}
+	_ttyflush();
+	n = SCROLL_NOP;
+    } while ((*inputcallback)(&n));
+
+    free(linecounts);
+    cleardisplay();
+    return n;
+}
+
+/* Render a table on the display. title is a short string to let the
+ * user know what they're looking at. completed determines the prompt
+ * that will be displayed in the lower right-hand corner.
+ */
+int displaytable(char const *title, tablespec const *table, int completed)
+{
+    ttyrect	area;
+    ttyrect    *cols;
+    int		i, n;
+
+    cleardisplay();
+    displaytitle(title);
+
+    area.x = 1;
+    area.y = 1;
+    area.w = ttyg.width - 2;
+    area.h = ttyg.height - 3;
+    cols = measuretable(&area, table);
+    for (i = table->rows, n = 0 ; i ; --i)
+	drawtablerow(table, cols, &n, 0);
+    free(cols);
+
+    displayprompticon(completed);
+    _ttyflush();
+    return TRUE;
+}
+
+/* Render a table with embedded illustrations on the display. title is
+ * a short string to display under the table. rows is an array of
+ * count lines of text, each accompanied by one or two illustrations.
+ * completed determines the prompt that will be displayed in the lower
+ * right-hand corner.
+ */
+int displaytiletable(char const *title,
+		     tiletablerow const *rows, int count, int completed)
+{
+    ttyrect	left, right;
+    int		col, id, i;
+
+    cleardisplay();
+    displaytitle(title);
+
+    left.x = 1;
+    left.y = 1;
+    left.w = ttyg.width - 2;
+    left.h = ttyg.height - 3;
+
+    right = left;
+    col = 2 * TILEW + 2;
+    right.x += col;
+    right.w -= col;
+    for (i = 0 ; i < count ; ++i) {
+	if (rows[i].isfloor)
+	    id = rows[i].item1;
+	else
+	    id = crtile(rows[i].item1, EAST);
+	drawtile(left.x + TILEW, left.y, id);
+	if (rows[i].item2) {
+	    if (rows[i].isfloor)
+		id = rows[i].item2;
+	    else
+		id = crtile(rows[i].item2, EAST);
+	    drawtile(left.x, left.y, id);
+	}
+	++left.y;
+	--left.h;
+	puttext(&right, rows[i].desc, -1, PT_MULTILINE | PT_UPDATERECT);
+	if (left.y < right.y) {
+	    left.y = right.y;
+	    left.h = right.h;
+	} else {
+	    right.y = left.y;
+	    right.h = left.h;
+	}
+    }
+
+    displayprompticon(completed);
+    _ttyflush();
+    return TRUE;
+}
+
+/* Render a table as a scrollable list on the display. One row is
+ * highlighted as the current selection, initially set by the integer
+ * pointed to by idx. The callback function inputcallback is called
+ * repeatedly to determine how to move the selection and when to
+ * leave. The row selected when the function returns is returned to
+ * the caller through idx. If the table produces its rows on demand,
+ * only the rows that are visible are produced.
+ */
+int displaylist(char const *title, tablespec const *table, int *idx,
+		int (*inputcallback)(int*))
+{
+    ttyrect		area;
+    ttyrect	       *cols;
+    ttyrect	       *colstmp;
+    int			linecount, itemcount, topitem, index, thumbh;
+    int			j, n;
+
+    cleardisplay();
+    displaytitle(title);
+    area.x = 1;
+    area.y = 1;
+    area.w = ttyg.width - 4;
+    area.h = ttyg.height - 3;
+    cols = measuretable(&area, table);
+    if (!(colstmp = malloc(table->cols * sizeof *colstmp)))
+	memerrexit();
+
+    itemcount = table->rows - 1;
+    topitem = 0;
+    linecount = area.h - 1;
+    thumbh = itemcount <= linecount ? 0 : area.h * linecount / itemcount;
+    if (itemcount > linecount && thumbh < 1)
+	thumbh = 1;
+
+    index = *idx;
+    n = SCROLL_NOP;
+    do {
+	switch (n) {
+	  case SCROLL_NOP:						break;
+	  case SCROLL_UP:		--index;			break;
+	  case SCROLL_DN:		++index;			break;
+	  case SCROLL_HALFPAGE_UP:	index -= (linecount + 1) / 2;	break;
+	  case SCROLL_HALFPAGE_DN:	index += (linecount + 1) / 2;	break;
+	  case SCROLL_PAGE_UP:		index -= linecount;		break;
+	  case SCROLL_PAGE_DN:		index += linecount;		break;
+	  case SCROLL_ALLTHEWAY_UP:	index = 0;			break;
+	  case SCROLL_ALLTHEWAY_DN:	index = itemcount - 1;		break;
+	  default:			index = n;			break;
+	}
+	if (index < 0)
+	    index = 0;
+	else if (index >= itemcount)
+	    index = itemcount - 1;
+	if (linecount < itemcount) {
+	    n = linecount / 2;
+	    if (index < n)
+		topitem = 0;
+	    else if (index >= itemcount - n)
+		topitem = itemcount - linecount;
+	    else
+		topitem = index - n;
+	}
+
+	n = 0;
+	fillrect(&area);
+	memcpy(colstmp, cols, table->cols * sizeof *colstmp);
+	drawtablerow(table, colstmp, &n, 0);
+	if (table->getrow) {
+	    n += topitem;
+	    j = topitem;
+	} else {
+	    for (j = 0 ; j < topitem ; ++j)
+		drawtablerow(table, NULL, &n, 0);
+	}
+	for ( ; j < topitem + linecount && j < itemcount ; ++j)
+	    drawtablerow(table, colstmp, &n, j == index ? PT_HILIGHT : 0);
+	if (itemcount > linecount) {
+	    n = topitem * (area.h - thumbh) / (itemcount - linecount);
+	    for (j = 0 ; j < area.h ; ++j)
+		putcell(area.x + area.w + 1, area.y + j,
+			j >= n && j < n + thumbh ? '#' : '|', dimattr);
+	}
+	_ttyflush();
+
+	n = SCROLL_NOP;
+    } while ((*inputcallback)(&n));
+    if (n)
+	*idx = index;
+
+    free(cols);
+    free(colstmp);
+    cleardisplay();
+    return n;
+}
+
+/* Display a line of text, given by prompt, at the center of the display.
+ * The callback function inputcallback is then called repeatedly to
+ * obtain input characters, which are collected in input. maxlen sets an
+ * upper limit to the length of the input so collected.
+ */
+int displayinputprompt(char const *prompt, char *input, int maxlen,
+		       int (*inputcallback)(void))
+{
+    ttyrect	area, promptrect, inputrect;
+    int		len, ch;
+
+    area.w = strlen(prompt);
+    if (area.w < maxlen + 1)
+	area.w = maxlen + 1;
+    area.w += 4;
+    area.h = 4;
+    area.x = (ttyg.width - area.w) / 2;
+    area.y = (ttyg.height - area.h) / 2;
+    promptrect.x = area.x + 2;
+    promptrect.y = area.y + 1;
+    promptrect.w = area.w - 4;
+    promptrect.h = 1;
+    inputrect = promptrect;
+    ++inputrect.y;
+
+    len = strlen(input);
+    if (len > maxlen)
+	len = maxlen;
+    for (;;) {
+	fillrect(&area);
+	drawbox(&area, textattr);
+	puttext(&promptrect, prompt, -1, PT_CENTER);
+	input[len] = '_';
+	puttext(&inputrect, input, len + 1, PT_CENTER);
+	input[len] = '\0';
+	_ttyflush();
+	ch = (*inputcallback)();
+	if (ch == '\n' || ch < 0)
+	    break;
+	if (isprint(ch)) {
+	    input[len] = ch;
+	    if (len < maxlen)
+		++len;
+	    input[len] = '\0';
+	} else if (ch == '\b') {
+	    if (len)
+		--len;
+	    input[len] = '\0';
+	} else if (ch == '\f') {
+	    len = 0;
+	    input[0] = '\0';
+	} else {
+	    /* no op */
+	}
+    }
+    cleardisplay();
+    return ch == '\n';
+}
+
+/* The display always uses the terminal's own font.
+ */
+int loadfontfromfile(char const *filename, int complain)
+{
+    (void)filename;
+    (void)complain;
+    return TRUE;
+}
+
+/* Nothing to free.
+ */
+void freefont(void)
+{
+}
+
+/* The tiles are drawn as characters, so a tile set is not needed.
+ */
+int loadtileset(char const *filename, char const *cachefilename,
+		int complain)
+{
+    (void)filename;
+    (void)cachefilename;
+    (void)complain;
+    return TRUE;
+}
+
+/* Nothing to free.
+ */
+void freetileset(void)
+{
+}
+
+/* Videos cannot be made of a terminal's display.
+ */
+int setvideoexport(char const *filename)
+{
+    (void)filename;
+    errmsg(NULL, "videos cannot be written by the terminal version");
+    return FALSE;
+}
+
+/* Nothing to finish.
+ */
+int finishvideoexport(void)
+{
+    return TRUE;
+}
+
+/* Map images cannot be made of a terminal's display.
+ */
+int setmapimageexport(void)
+{
+    errmsg(NULL, "map images cannot be written by the terminal version");
+    return FALSE;
+}
+
+/* Nothing to write.
+ */
+int writemapimage(void const *state, char const *filename)
+{
+    (void)state;
+    (void)filename;
+    return FALSE;
+}
+
+/* Nothing to finish.
+ */
+int finishmapimages(void)
+{
+    return TRUE;
+}
+
+/* The game's display has a fixed layout, which needs 80x24 cells.
+ */
+int creategamedisplay(void)
+{
+    cleardisplay();
+    return TRUE;
+}
+
+/* Initialize the display at the terminal's current size.
+ */
+int _ttyoutputinitialize(void)
+{
+    _ttyinvalidate();
+    cleardisplay();
+    return TRUE;
+}
@@ -0,0 +1,166 @@
+/* ttysfx.c: Showing the program's sound effects.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	"ttygen.h"
+#include	"../defs.h"
+
+/* A terminal has no sound output, so the sound effects are always
+ * shown as textual onomatopoeia instead.
+ */
+static char const *textsfx[SND_COUNT];
+
+/* TRUE if the sound effects are to be shown.
+ */
+static int		enabled = FALSE;
+
+/* The volume level. It has no effect, but is kept so that the user's
+ * setting is preserved.
+ */
+static int		volume = 10;
+
+/* Initialize the textual sound effects.
+ */
+static void initonomatopoeia(void)
+{
+    textsfx[SND_CHIP_LOSES]      = "\"Bummer\"";
+    textsfx[SND_CHIP_WINS]       = "Tadaa!";
+    textsfx[SND_TIME_OUT]        = "Clang!";
+    textsfx[SND_TIME_LOW]        = "Ktick!";
+    textsfx[SND_DEREZZ]		 = "Bzont!";
+    textsfx[SND_CANT_MOVE]       = "Mnphf!";
+    textsfx[SND_IC_COLLECTED]    = "Chack!";
+    textsfx[SND_ITEM_COLLECTED]  = "Slurp!";
+    textsfx[SND_BOOTS_STOLEN]    = "Flonk!";
+    textsfx[SND_TELEPORTING]     = "Bamff!";
+    textsfx[SND_DOOR_OPENED]     = "Spang!";
+    textsfx[SND_SOCKET_OPENED]   = "Clack!";
+    textsfx[SND_BUTTON_PUSHED]   = "Click!";
+    textsfx[SND_BOMB_EXPLODES]   = "Booom!";
+    textsfx[SND_WATER_SPLASH]    = "Plash!";
+    textsfx[SND_TILE_EMPTIED]    = "Whisk!";
+    textsfx[SND_WALL_CREATED]    = "Chunk!";
+    textsfx[SND_TRAP_ENTERED]    = "Shunk!";
+    textsfx[SND_SKATING_TURN]    = "Whing!";
+    textsfx[SND_SKATING_FORWARD] = "Whizz ...";
+    textsfx[SND_SLIDING]         = "Drrrr ...";
+    textsfx[SND_BLOCK_MOVING]    = "Scrrr ...";
+    textsfx[SND_SLIDEWALKING]    = "slurp slurp ...";
+    textsfx[SND_ICEWALKING]      = "snick snick ...";
+    textsfx[SND_WATERWALKING]    = "plip plip ...";
+    textsfx[SND_FIREWALKING]     = "crackle crackle ...";
+}
+
+/* There is no sound device to activate.
+ */
+int setaudiosystem(int active)
+{
+    (void)active;
+    return FALSE;
+}
+
+/* There are no waves to load.
+ */
+int loadsfxfromfile(int index, char const *filename)
+{
+    (void)index;
+    (void)filename;
+    return FALSE;
+}
+
+/* There is no sound cache to use.
+ */
+int opensfxcache(char const *filename)
+{
+    (void)filename;
+    return FALSE;
+}
+
+/* Nothing to do.
+ */
+void keepsfxcachefile(char const *filename)
+{
+    (void)filename;
+}
+
+/* Nothing to do.
+ */
+void closesfxcache(void)
+{
+}
+
+/* Display the onomatopoeia for the first of the given sound effects.
+ * Only the first sound is used, since we can't display multiple
+ * strings.
+ */
+void playsoundeffects(unsigned long sfx)
+{
+    unsigned long	flag;
+    int			i;
+
+    if (!enabled)
+	return;
+    for (flag = 1, i = 0 ; i < SND_COUNT ; flag <<= 1, ++i) {
+	if (sfx & flag) {
+	    setdisplaymsg(textsfx[i], 500, 10);
+	    return;
+	}
+    }
+}
+
+/* Stopping the sounds erases the onomatopoeia being shown.
+ */
+void setsoundeffects(int action)
+{
+    if (enabled && action < 0)
+	setdisplaymsg(NULL, 0, 0);
+}
+
+/* Nothing to free.
+ */
+void freesfx(int index)
+{
+    (void)index;
+}
+
+/* Return the current volume level.
+ */
+int getvolume(void)
+{
+    return volume;
+}
+
+/* Remember the volume level. FALSE is returned, since there is no
+ * sound system.
+ */
+int setvolume(int v, int display)
+{
+    (void)display;
+    if (v < 0)
+	v = 0;
+    else if (v > 10)
+	v = 10;
+    volume = v;
+    return FALSE;
+}
+
+/* Change the current volume level by delta.
+ */
+int changevolume(int delta, int display)
+{
+    return setvolume(getvolume() + delta, display);
+}
+
+/* Initialize the module. If silence is TRUE, then the sound effects
+ * are not shown either.
+ */
+int _ttysfxinitialize(int silence)
+{
+    enabled = !silence;
+    initonomatopoeia();
+    return TRUE;
+}
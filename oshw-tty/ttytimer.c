@@ -0,0 +1,249 @@
+/* ttytimer.c: Game timing functions.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<errno.h>
+#include	<time.h>
+#include	<sys/time.h>
+#include	<poll.h>
+#include	"ttygen.h"
+
+/* The ticks are scheduled the same way as in the SDL layer's timer
+ * module. The two differ in their clock and in how they sleep, and
+ * each oshw layer is built as a library of its own, so the scheduler
+ * is repeated here rather than shared.
+ */
+
+/* How long before a tick the program stops sleeping and spins
+ * instead, in microseconds. Waking up from a sleep is never exact,
+ * so the last stretch is done by polling the clock.
+ */
+#define	SPINTIME	1000
+
+/* By default, a second of game time lasts for 1000 milliseconds of
+ * real time.
+ */
+static unsigned long	uspertick = 1000000 / TICKS_PER_SECOND;
+
+/* The tick counter.
+ */
+static int	utick = 0;
+
+/* The state of the timer.
+ */
+enum { Timer_Stopped, Timer_Paused, Timer_Running };
+static int	timerstate = Timer_Stopped;
+
+/* The time of the next tick, in microseconds. While the timer is
+ * paused, this holds the time remaining until the next tick instead.
+ * Times are compared by their difference, so that the counter may
+ * safely wrap around.
+ */
+static unsigned long	nexttickat = 0;
+
+/* The most ticks that the timer will fall behind before giving up on
+ * the missed ticks. A negative value means no limit.
+ */
+static int	maxcatchup = -1;
+
+/* A histogram of how many milliseconds the program spends sleeping
+ * per tick.
+ */
+static int		showhistogram = FALSE;
+static unsigned		hist[100];
+static unsigned long	missedticks = 0;
+
+/* Return the current time in microseconds.
+ */
+unsigned long _ttygetmicroseconds(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+#else
+    struct timeval	tv;
+
+    gettimeofday(&tv, NULL);
+    return (unsigned long)tv.tv_sec * 1000000UL + tv.tv_usec;
+#endif
+}
+
+/* Sleep until the given time, as returned by _ttygetmicroseconds().
+ * The program sleeps on the terminal, so that keys are collected as
+ * soon as they arrive, until shortly before the time, and then spins.
+ */
+static void sleepuntil(unsigned long when)
+{
+    struct pollfd	pfd;
+    long		us;
+
+    pfd.fd = ttyg.fd;
+    pfd.events = POLLIN;
+    for (;;) {
+	us = (long)(when - _ttygetmicroseconds()) - SPINTIME;
+	if (us <= 0)
+	    break;
+	if (poll(&pfd, 1, (us + 999) / 1000) > 0)
+	    _ttyeventupdate(FALSE);
+    }
+    while ((long)(when - _ttygetmicroseconds()) > 0) ;
+}
+
+/* Set the length (in real time) of a second of game time. A value of
+ * zero selects the default length of one second.
+ */
+void settimersecond(int ms)
+{
+    uspertick = (ms ? ms : 1000) * 1000UL / TICKS_PER_SECOND;
+}
+
+/* Set the number of missed ticks that the timer will make up.
+ */
+void settimercatchup(int maxticks)
+{
+    maxcatchup = maxticks;
+}
+
+/* Frames are only drawn on ticks, since a creature can only be shown
+ * in one cell or another.
+ */
+void setframerate(int fps)
+{
+    (void)fps;
+}
+
+/* Change the current timer setting. If action is positive, the timer
+ * is started (or resumed). If action is negative, the timer is
+ * stopped if it is running and the counter is reset to zero. If
+ * action is zero, the timer is stopped if it is running, and the
+ * counter remains at its current setting.
+ */
+void settimer(int action)
+{
+    if (action < 0) {
+	timerstate = Timer_Stopped;
+	utick = 0;
+    } else if (action > 0) {
+	if (timerstate == Timer_Paused)
+	    nexttickat += _ttygetmicroseconds();
+	else
+	    nexttickat = _ttygetmicroseconds() + uspertick;
+	timerstate = Timer_Running;
+    } else {
+	if (timerstate == Timer_Running) {
+	    nexttickat -= _ttygetmicroseconds();
+	    timerstate = Timer_Paused;
+	}
+    }
+}
+
+/* Return the number of ticks since the timer was last reset.
+ */
+int gettickcount(void)
+{
+    return (int)utick;
+}
+
+/* Put the program to sleep until the next timer tick. If we've
+ * already missed a timer tick, return immediately so that the caller
+ * can catch up, unless we have fallen too far behind, in which case
+ * the missed ticks are given up on.
+ */
+int waitfortick(void)
+{
+    unsigned long	now;
+    long		us;
+    int			n;
+
+    now = _ttygetmicroseconds();
+    us = (long)(nexttickat - now);
+    if (showhistogram) {
+	n = us >= 0 ? us / 1000 + 1 : 0;
+	if (n < (int)(sizeof hist / sizeof *hist))
+	    ++hist[n];
+    }
+
+    ++utick;
+    if (us <= 0) {
+	++missedticks;
+	if (maxcatchup >= 0 && -us >= (long)(maxcatchup * uspertick))
+	    nexttickat = now + uspertick;
+	else
+	    nexttickat += uspertick;
+	return FALSE;
+    }
+
+    sleepuntil(nexttickat);
+    nexttickat += uspertick;
+    return TRUE;
+}
+
+/* Move to the next timer tick without waiting.
+ */
+int advancetick(void)
+{
+    return ++utick;
+}
+
+/* There are no frames in between ticks.
+ */
+int waitforframe(void)
+{
+    return FALSE;
+}
+
+/* Return TRUE if the time of the next tick has been reached.
+ */
+int istickdue(void)
+{
+    return timerstate == Timer_Running
+	&& (long)(nexttickat - _ttygetmicroseconds()) <= 0;
+}
+
+/* Return the current time in microseconds.
+ */
+unsigned long getmicroseconds(void)
+{
+    return _ttygetmicroseconds();
+}
+
+/* At shutdown time, display the histogram data on stdout.
+ */
+static void shutdown(void)
+{
+    unsigned long	n;
+    int			i;
+
+    settimer(-1);
+
+    if (showhistogram) {
+	n = 0;
+	for (i = 0 ; i < (int)(sizeof hist / sizeof *hist) ; ++i)
+	    n += hist[i];
+	if (n) {
+	    printf("Histogram of idle time (ms/tick)\n");
+	    if (hist[0])
+		printf("NEG: %.1f%%\n", (hist[0] * 100.0) / n);
+	    for (i = 1 ; i < (int)(sizeof hist / sizeof *hist) ; ++i)
+		if (hist[i])
+		    printf("%3d: %.1f%%\n", i - 1, (hist[i] * 100.0) / n);
+	    printf("Missed ticks: %lu of %lu\n", missedticks, n);
+	}
+    }
+}
+
+/* Initialize and reset the timer.
+ */
+int _ttytimerinitialize(int _showhistogram)
+{
+    showhistogram = _showhistogram;
+    atexit(shutdown);
+    settimer(-1);
+    return TRUE;
+}
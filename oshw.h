@@ -20,14 +20,17 @@ extern int tworld(int argc, char *argv[]);
  * sound system will be disabled, as if no soundcard was present. If
  * showhistogram is TRUE, then during shutdown the timer module will
  * send a histogram to stdout describing the amount of time the
- * program explicitly yielded to other processes. (This feature is for
- * debugging purposes.) soundbufsize is a number between 0 and 3 which
- * is used to scale the size of the sound buffer. A larger number is
- * more efficient, but pushes the sound effects farther out of
- * synchronization with the video.
+ * program explicitly yielded to other processes, and the input module
+ * will describe the delay between key presses and their display.
+ * (This feature is for debugging purposes.) soundbufsize is a number
+ * between 0 and 3 which is used to scale the size of the sound
+ * buffer. A larger number is more efficient, but pushes the sound
+ * effects farther out of synchronization with the video. scale is a
+ * number between 1 and 4 giving the factor by which the display is
+ * enlarged.
  */
 extern int oshwinitialize(int silence, int soundbufsize,
-			  int showhistogram, int fullscreen);
+			  int showhistogram, int fullscreen, int scale);
 
 /*
  * Timer functions.
@@ -45,11 +48,20 @@ extern void settimer(int action);
  */
 extern void settimersecond(int ms);
 
+/* Set how many ticks the timer may fall behind real time. When the
+ * program misses a tick, waitfortick() returns immediately until the
+ * timer has caught up. If it falls more than maxticks ticks behind,
+ * the missed time is instead given up on. A negative value (the
+ * default) makes up every missed tick.
+ */
+extern void settimercatchup(int maxticks);
+
 /* Return the number of ticks since the timer was last reset.
  */
 extern int gettickcount(void);
 
-/* Put the program to sleep until the next timer tick.
+/* Put the program to sleep until the next timer tick. The return
+ * value is FALSE if the tick had already passed.
  */
 extern int waitfortick(void);
 
@@ -57,6 +69,29 @@ extern int waitfortick(void);
  */
 extern int advancetick(void);
 
+/* Set the number of frames per second to draw in between timer
+ * ticks, in which the creatures move smoothly between their positions
+ * at the last two ticks. Zero means that frames are drawn only on
+ * ticks.
+ */
+extern void setframerate(int fps);
+
+/* Put the program to sleep until it is time to draw a frame in
+ * between timer ticks. The return value is FALSE, without sleeping,
+ * if it is time to wait for the next tick instead.
+ */
+extern int waitforframe(void);
+
+/* Return TRUE if the real time for the next timer tick has arrived,
+ * so that waitfortick() would not sleep.
+ */
+extern int istickdue(void);
+
+/* Return the current time in microseconds, for measuring how long
+ * things take. Only the difference between two values is meaningful.
+ */
+extern unsigned long getmicroseconds(void);
+
 /*
  * Keyboard input functions.
  */
@@ -121,9 +156,12 @@ extern void freefont(void);
 /* Extract the tile images stored in the given file and use them as
  * the current tile set. FALSE is returned if the attempt was
  * unsuccessful. If complain is FALSE, no error messages will be
- * displayed.
+ * displayed. If cachefilename is not NULL, it names a file used to
+ * keep a copy of the extracted images, so that later calls with the
+ * same tile set can skip the extraction.
  */
-extern int loadtileset(char const *filename, int complain);
+extern int loadtileset(char const *filename, char const *cachefilename,
+		       int complain);
 
 /* Free all memory associated with the current tile images.
  */
@@ -160,6 +198,12 @@ extern void cleardisplay(void);
  */
 extern int displaygame(void const *state, int timeleft, int besttime);
 
+/* Redraw the map view in between timer ticks, with the creatures that
+ * are moving placed between their positions at the last two ticks
+ * that were displayed. Nothing is drawn if nothing is moving.
+ */
+extern int displaygameframe(void const *state);
+
 /* Display a short message appropriate to the end of a level's game
  * play. If the level was completed successfully, totalscore is
  * nonzero, and the other three arguments define the base score and
@@ -228,6 +272,40 @@ enum {
 extern int displayinputprompt(char const *prompt, char *input, int maxlen,
 			      int (*inputcallback)(void));
 
+/* Write the game display to the given file as a video instead of
+ * showing it in a window. Each call to displaygame() adds a frame,
+ * and the frames are written at the rate of one per tick. If the
+ * filename ends in .y4m, the video is written as a YUV4MPEG2 stream;
+ * otherwise it is written as a series of PPM images. A filename of
+ * "-" selects stdout. This function must be called before
+ * oshwinitialize(). FALSE is returned if the OS/hardware layer cannot
+ * write videos.
+ */
+extern int setvideoexport(char const *filename);
+
+/* Finish writing the video. FALSE is returned if the video could not
+ * be written in full.
+ */
+extern int finishvideoexport(void);
+
+/* Prepare to write images of level maps instead of showing the
+ * display. This function must be called before oshwinitialize().
+ * FALSE is returned if the OS/hardware layer cannot write images.
+ */
+extern int setmapimageexport(void);
+
+/* Write an image of the entire map of the given game state, with its
+ * creatures, to the given file, in PPM format. Each cell of the map is
+ * reduced to 8x8 pixels. The image may be written after the function
+ * returns, and the game state can be changed immediately.
+ */
+extern int writemapimage(void const *state, char const *filename);
+
+/* Wait for all of the map images to be written. FALSE is returned if
+ * any of them could not be written.
+ */
+extern int finishmapimages(void);
+
 /*
  * Sound functions.
  */
@@ -242,6 +320,26 @@ extern int setaudiosystem(int active);
  */
 extern int loadsfxfromfile(int index, char const *filename);
 
+/* Use the given file as a cache of wave data already converted to the
+ * sound device's format. Until closesfxcache() is called,
+ * loadsfxfromfile() takes a sound from the cache when the cache holds
+ * the data converted from the same wave file. FALSE is returned if
+ * the sound system is not active.
+ */
+extern int opensfxcache(char const *filename);
+
+/* Indicate that the named wave file is still one of the program's
+ * resources, even if it was not loaded, so that its converted data is
+ * kept when the cache file is rewritten. Data for wave files that are
+ * neither loaded nor passed to this function is dropped from the file.
+ */
+extern void keepsfxcachefile(char const *filename);
+
+/* Stop using the sound cache file, first rewriting it if any of the
+ * sounds that were loaded were not found in it.
+ */
+extern void closesfxcache(void);
+
 /* Specify the sounds effects to be played at this time. sfx is the
  * bitwise-or of any number of sound effects. If a non-continuous
  * sound effect in sfx is already playing, it will be restarted. Any
@@ -292,6 +390,25 @@ extern void ding(void);
  */
 extern void setsubtitle(char const *subtitle);
 
+/* Start running func(data) in the background, on a separate thread.
+ * The return value is a handle to be passed to
+ * waitforbackgroundtask(). If no thread can be started, func is run
+ * to completion before returning. The function must not call any of
+ * the display or input functions.
+ */
+extern void *startbackgroundtask(int (*func)(void*), void *data);
+
+/* Wait until the given background task has finished, and return the
+ * value that its function returned. The handle is no longer valid
+ * afterwards.
+ */
+extern int waitforbackgroundtask(void *task);
+
+/* Return TRUE if the caller is running on the given background
+ * task's own thread, in which case the task cannot be waited for.
+ */
+extern int onbackgroundtask(void const *task);
+
 /* Display a message to the user. cfile and lineno can be NULL and 0
  * respectively; otherwise, they identify the source code location
  * where this function was called from. prefix is an optional string
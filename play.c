@@ -15,7 +15,9 @@
 #include	"logic.h"
 #include	"random.h"
 #include	"solution.h"
+#include	"series.h"
 #include	"play.h"
+#include	"telemetry.h"
 
 /* The current state of the current game.
  */
@@ -25,6 +27,18 @@ static gamestate	state;
  */
 static gamelogic       *logic = NULL;
 
+/* A copy of the initial state of the most recently started level,
+ * kept so that restarting the level is just a matter of copying it
+ * back. If the logic engine is able to restore its state from such a
+ * copy, the copy is taken after the engine has initialized the game;
+ * otherwise it is taken beforehand, and only the decoding of the
+ * level data is skipped.
+ */
+static gamestate	pristinestate;
+static void	       *pristinelocalinfo = NULL;
+static unsigned long	pristinelevelhash;
+static int		pristinevalid = FALSE;
+
 /* TRUE if the user has requested pedantic mode game play.
  */
 static int		pedanticmode = FALSE;
@@ -63,6 +77,9 @@ static int setrulesetbehavior(int ruleset, int withgui)
 	logic = NULL;
 	free(state.localstateinfo);
 	state.localstateinfo = NULL;
+	free(pristinelocalinfo);
+	pristinelocalinfo = NULL;
+	pristinevalid = FALSE;
     }
     if (ruleset == Ruleset_None)
 	return TRUE;
@@ -99,14 +116,64 @@ static int setrulesetbehavior(int ruleset, int withgui)
     return TRUE;
 }
 
+/* Save a copy of the current state as the level's initial state.
+ */
+static void savepristinestate(void)
+{
+    if (!pristinelocalinfo) {
+	pristinelocalinfo = malloc(logic->localstateinfosize);
+	if (!pristinelocalinfo)
+	    memerrexit();
+    }
+    pristinestate = state;
+    memcpy(pristinelocalinfo, state.localstateinfo, logic->localstateinfosize);
+    pristinelevelhash = state.game->levelhash;
+    pristinevalid = TRUE;
+}
+
+/* Restore the current state from the saved copy of the level's initial
+ * state, if the copy was made for the given level and ruleset. The
+ * move list and the PRNG are not part of the copy, and are reset
+ * instead. FALSE is returned if there is no suitable copy.
+ */
+static int restorepristinestate(gamesetup const *game, int ruleset)
+{
+    actlist	moves;
+    void       *localstateinfo;
+
+    if (!pristinevalid || pristinestate.game != game
+		       || pristinestate.ruleset != ruleset
+		       || pristinelevelhash != game->levelhash)
+	return FALSE;
+
+    moves = state.moves;
+    localstateinfo = state.localstateinfo;
+    state = pristinestate;
+    state.moves = moves;
+    state.localstateinfo = localstateinfo;
+    memcpy(state.localstateinfo, pristinelocalinfo, logic->localstateinfosize);
+    initmovelist(&state.moves);
+    resetprng(&state.mainprng);
+    return TRUE;
+}
+
 /* Initialize the current state to the starting position of the
- * given level.
+ * given level. If the level is the same one that was started last
+ * time, the saved copy of its initial state is used instead.
  */
 int initgamestate(gamesetup *game, int ruleset, int withgui)
 {
+    int	f;
+
     if (!setrulesetbehavior(ruleset, withgui))
 	die("unable to initialize the system for the requested ruleset");
 
+    if (restorepristinestate(game, ruleset)) {
+	if (logic->restoregame)
+	    return (*logic->restoregame)(logic);
+	return (*logic->initgame)(logic);
+    }
+
     memset(state.map, 0, sizeof state.map);
     state.game = game;
     state.ruleset = ruleset;
@@ -125,10 +192,17 @@ int initgamestate(gamesetup *game, int ruleset, int withgui)
     initmovelist(&state.moves);
     resetprng(&state.mainprng);
 
-    if (!expandleveldata(&state))
+    if (!loadleveldata(game) || !expandleveldata(&state)) {
+	pristinevalid = FALSE;
 	return FALSE;
+    }
 
-    return (*logic->initgame)(logic);
+    if (!logic->restoregame)
+	savepristinestate();
+    f = (*logic->initgame)(logic);
+    if (logic->restoregame)
+	savepristinestate();
+    return f;
 }
 
 /* Change the current state to run from the recorded solution.
@@ -137,7 +211,7 @@ int prepareplayback(void)
 {
     solutioninfo	solution;
 
-    if (!state.game->solutionsize)
+    if (!state.game->solutionsize || !loadsolutiondata(state.game))
 	return FALSE;
     solution.moves.list = NULL;
     solution.moves.allocated = 0;
@@ -272,8 +346,9 @@ int rotaterndslidedir(int display)
 int doturn(int cmd)
 {
     action	act;
-    int		n;
+    int		n, phase;
 
+    telemetrytick();
     state.soundeffects &= ~((1 << SND_ONESHOT_COUNT) - 1);
     state.currenttime = gettickcount();
     if (state.currenttime >= MAXIMUM_TICK_COUNT) {
@@ -301,7 +376,9 @@ int doturn(int cmd)
 	}
     }
 
+    phase = beginphase(Phase_Logic);
     n = (*logic->advancegame)(logic);
+    endphase(phase);
 
     if (state.replay < 0 && state.lastmove) {
 	act.when = state.currenttime;
@@ -316,6 +393,30 @@ int doturn(int cmd)
     return 0;
 }
 
+/* Advance the game by count ticks, or until the next timer tick is
+ * due if count is not positive. The one-shot sound effects of the
+ * earlier ticks are folded into the last one, so that none are lost
+ * when only the last tick is displayed.
+ */
+int doturns(int cmd, int count)
+{
+    unsigned long	sfx;
+    int			n;
+
+    sfx = 0;
+    for (;;) {
+	n = doturn(cmd);
+	sfx |= state.soundeffects & ((1 << SND_ONESHOT_COUNT) - 1);
+	if (n)
+	    break;
+	if (count > 0 ? --count == 0 : istickdue())
+	    break;
+	advancetick();
+    }
+    state.soundeffects |= sfx;
+    return n;
+}
+
 /* Update the display to show the current game state (including sound
  * effects, if any). If showframe is FALSE, then nothing is actually
  * displayed.
@@ -349,6 +450,20 @@ int drawscreen(int showframe)
     return displaygame(&state, timeleft, besttime);
 }
 
+/* Redraw the map view in between ticks.
+ */
+int drawframe(void)
+{
+    return displaygameframe(&state);
+}
+
+/* Write an image of the entire map to a file.
+ */
+int savemapimage(char const *filename)
+{
+    return writemapimage(&state, filename);
+}
+
 /* Stop game play and clean up.
  */
 int quitgamestate(void)
@@ -441,9 +556,7 @@ int deletesolution(void)
 	return FALSE;
     state.game->besttime = TIME_NIL;
     state.game->sgflags &= ~SGF_REPLACEABLE;
-    free(state.game->solutiondata);
-    state.game->solutionsize = 0;
-    state.game->solutiondata = NULL;
+    freesolutiondata(state.game);
     return TRUE;
 }
 
@@ -62,11 +62,32 @@ extern int secondsplayed(void);
  */
 extern int doturn(int cmd);
 
+/* Advance the game count ticks without waiting for the timer between
+ * them, as when playing back a solution at high speed. If count is
+ * zero or less, the game is advanced until the time for the next
+ * timer tick arrives. The sound effects of all the ticks are merged
+ * for the next call to drawscreen(). The return value is that of
+ * doturn() for the last tick; the game stops advancing as soon as it
+ * ends.
+ */
+extern int doturns(int cmd, int count);
+
 /* Update the display during game play. If showframe is FALSE, then
  * nothing is actually displayed.
  */
 extern int drawscreen(int showframe);
 
+/* Redraw the map view in between ticks, with the creatures shown in
+ * the middle of their moves. The sound effects and the rest of the
+ * display are left alone.
+ */
+extern int drawframe(void);
+
+/* Write an image of the entire map at its current state to the given
+ * file.
+ */
+extern int savemapimage(char const *filename);
+
 /* Quit game play early.
  */
 extern int quitgamestate(void);
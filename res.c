@@ -12,6 +12,7 @@
 #include	"err.h"
 #include	"oshw.h"
 #include	"unslist.h"
+#include	"solution.h"
 #include	"res.h"
 
 /*
@@ -127,6 +128,10 @@ static int		currentruleset = Ruleset_None;
  */
 static char const      *resdir = NULL;
 
+/* The background task loading the sound resources, if any.
+ */
+static void	       *soundloader = NULL;
+
 /* Getting and setting the resource directory.
  */
 char const *getresdir(void)		{ return resdir; }
@@ -248,23 +253,61 @@ static int loadcolors(void)
     return TRUE;
 }
 
+/* Return the pathname of the file in the save directory used to
+ * cache the data derived from the named resource (such as the images
+ * extracted from a tileset), or NULL if no cache file is to be used.
+ * When resname includes a directory, a hash of the directory is added
+ * to the cache's name, so that resources with the same name in
+ * different directories do not share a cache. The caller must free
+ * the returned buffer.
+ */
+static char *getcachepath(char const *resname)
+{
+    char const	       *name;
+    char const	       *p;
+    char	       *cachename = NULL;
+    char	       *path;
+    unsigned long	hash;
+
+    if (isreadonly() || !getsavedir() || !*getsavedir()
+		     || !finddir(getsavedir()))
+	return NULL;
+    name = skippathname(resname);
+    xalloc(cachename, strlen(name) + 16);
+    if (name == resname) {
+	sprintf(cachename, "%s.cache", name);
+    } else {
+	for (hash = 0, p = resname ; p < name ; ++p)
+	    hash = (hash * 31 + (unsigned char)*p) & 0xFFFFFFFFUL;
+	sprintf(cachename, "%s-%08lX.cache", name, hash);
+    }
+    path = getpathforfileindir(getsavedir(), cachename);
+    free(cachename);
+    return path;
+}
+
 /* Attempt to load the tile images.
  */
 static int loadimages(void)
 {
     char       *path;
+    char       *cachepath;
     int		f;
 
     f = FALSE;
     path = getpathbuffer();
     if (*resources[RES_IMG_TILES]) {
 	combinepath(path, resdir, resources[RES_IMG_TILES]);
-	f = loadtileset(path, TRUE);
+	cachepath = getcachepath(path);
+	f = loadtileset(path, cachepath, TRUE);
+	free(cachepath);
     }
     if (!f && resources != globalresources
 	   && *globalresources[RES_IMG_TILES]) {
 	combinepath(path, resdir, globalresources[RES_IMG_TILES]);
-	f = loadtileset(path, TRUE);
+	cachepath = getcachepath(path);
+	f = loadtileset(path, cachepath, TRUE);
+	free(cachepath);
     }
     free(path);
 
@@ -315,14 +358,20 @@ static int loadunslist(void)
     return loadunslistfromfile(filename);
 }
 
-/* Load all of the sound resources.
+/* Load all of the sound resources. The converted sounds are kept in
+ * a cache file, so that they need not be converted every time. The
+ * sounds of every ruleset are kept in the one cache file.
  */
 static int loadsounds(void)
 {
     char       *path;
+    char       *cachepath;
     int		count;
-    int		n, f;
+    int		r, n, f;
 
+    cachepath = getcachepath("sounds");
+    opensfxcache(cachepath);
+    free(cachepath);
     path = getpathbuffer();
     count = 0;
     for (n = 0 ; n < SND_COUNT ; ++n) {
@@ -339,33 +388,71 @@ static int loadsounds(void)
 	if (f)
 	    ++count;
     }
+    for (r = Ruleset_None ; r < Ruleset_Count ; ++r) {
+	for (n = 0 ; n < SND_COUNT ; ++n) {
+	    if (*allresources[r][RES_SND_BASE + n]) {
+		combinepath(path, resdir, allresources[r][RES_SND_BASE + n]);
+		keepsfxcachefile(path);
+	    }
+	}
+    }
     free(path);
+    closesfxcache();
     return count;
 }
 
+/* Load the sound resources as a background task.
+ */
+static int loadsoundstask(void *data)
+{
+    (void)data;
+    return loadsounds();
+}
+
+/* Wait for the sound resources to finish loading, if they are being
+ * loaded in the background. If no sounds could be loaded, the sound
+ * system is shut off. This is also called at exit, so that the
+ * loading thread is finished before the audio system is shut down.
+ * If the loading thread is the one exiting (e.g. because it ran out
+ * of memory), it cannot wait for itself, so nothing is done.
+ */
+static void finishloadingsounds(void)
+{
+    if (!soundloader || onbackgroundtask(soundloader))
+	return;
+    if (waitforbackgroundtask(soundloader) == 0)
+	setaudiosystem(FALSE);
+    soundloader = NULL;
+}
+
 /* Load all resources that are available. FALSE is returned if the
  * tile images could not be loaded. (Sounds are not required in order
  * to run, and by this point we should already have a valid font and
- * color scheme set.)
+ * color scheme set.) The sounds are loaded in the background, so that
+ * the game can begin before they are ready.
  */
 int loadgameresources(int ruleset)
 {
+    finishloadingsounds();
     currentruleset = ruleset;
     resources = allresources[ruleset];
     loadcolors();
     loadfont();
     if (!loadimages())
 	return FALSE;
-    if (loadsounds() == 0)
-	setaudiosystem(FALSE);
+    if (setaudiosystem(TRUE))
+	soundloader = startbackgroundtask(loadsoundstask, NULL);
     return TRUE;
 }
 
 /* Parse the rc file and load the font and color scheme. FALSE is returned
- * if an error occurs.
+ * if an error occurs. Since this is called after the oshw layer is
+ * initialized, the exit handler registered here runs before the
+ * layer's own shutdown handlers.
  */
 int initresources(void)
 {
+    atexit(finishloadingsounds);
     initresourcedefaults();
     resources = allresources[Ruleset_None];
     if (!readrcfile() || !loadcolors() || !loadfont())
@@ -380,6 +467,7 @@ void freeallresources(void)
 {
     int	n;
 
+    finishloadingsounds();
     freefont();
     freetileset();
     clearunslist();
@@ -93,115 +93,161 @@ int getscoresforlevel(gameseries const *series, int level,
     return TRUE;
 }
 
+/* The information used to produce the rows of a score or time list
+ * on demand.
+ */
+typedef	struct scorelist {
+    gameseries const   *series;		/* the series of levels */
+    int		       *levels;		/* the level shown in each row */
+    long		totalscore;	/* the grand total score */
+    int			usepasswds;	/* TRUE to hide unlearned levels */
+    int			showpartial;	/* the fractional time precision */
+    char		zchar;		/* the character for zero */
+    char		text[5][272];	/* the cells of the last row */
+} scorelist;
+
+/* Allocate a scorelist structure for a table of count levels, and
+ * fill in the table's fields.
+ */
+static scorelist *newscorelist(gameseries const *series, char zchar,
+			       int count, tablespec *table, int cols,
+			       int (*getrow)(void*, int, char const**))
+{
+    scorelist  *list;
+
+    if (!(list = malloc(sizeof *list)))
+	memerrexit();
+    if (!(list->levels = malloc((count + 1) * sizeof *list->levels)))
+	memerrexit();
+    list->series = series;
+    list->totalscore = 0;
+    list->usepasswds = FALSE;
+    list->showpartial = 0;
+    list->zchar = zchar;
+    table->cols = cols;
+    table->sep = 2;
+    table->collapse = 1;
+    table->items = NULL;
+    table->getrow = getrow;
+    table->rowdata = list;
+    return list;
+}
+
+/* Produce one row of the score list. Row zero is the header, and the
+ * last row holds the grand total.
+ */
+static int getscorelistrow(void *data, int row, char const **cells)
+{
+    scorelist  *list = data;
+    gamesetup  *game;
+    long	levelscore, timescore;
+
+    if (row == 0) {
+	cells[0] = "1+Level";
+	cells[1] = "1-Name";
+	cells[2] = "1+Base";
+	cells[3] = "1+Bonus";
+	cells[4] = "1+Score";
+	return 5;
+    }
+    if (list->levels[row - 1] < 0) {
+	cells[0] = "2-Total Score";
+	sprintf(list->text[1], "3+%s",
+		cdecimal(list->totalscore, list->zchar));
+	cells[1] = list->text[1];
+	return 2;
+    }
+
+    game = list->series->games + list->levels[row - 1];
+    sprintf(list->text[0], "1+%s", decimal(game->number, list->zchar));
+    cells[0] = list->text[0];
+    if (!hassolution(game)) {
+	if (!list->usepasswds || (game->sgflags & SGF_HASPASSWD)) {
+	    sprintf(list->text[1], "4-%s", game->name);
+	    cells[1] = list->text[1];
+	} else {
+	    cells[1] = "4- ";
+	}
+	return 2;
+    }
+    sprintf(list->text[1], "1-%.64s", game->name);
+    cells[1] = list->text[1];
+    if (game->sgflags & SGF_REPLACEABLE) {
+	cells[2] = "3.*BAD*";
+	return 3;
+    }
+    levelscore = 500 * game->number;
+    sprintf(list->text[2], "1+%s", cdecimal(levelscore, list->zchar));
+    cells[2] = list->text[2];
+    if (game->time) {
+	timescore = 10 * (game->time - game->besttime / TICKS_PER_SECOND);
+	sprintf(list->text[3], "1+%s", cdecimal(timescore, list->zchar));
+	cells[3] = list->text[3];
+    } else {
+	timescore = 0;
+	cells[3] = "1+---";
+    }
+    sprintf(list->text[4], "1+%s",
+	    cdecimal(levelscore + timescore, list->zchar));
+    cells[4] = list->text[4];
+    return 5;
+}
+
 /* Produce a table that displays the user's score, broken down by
  * levels with a grand total at the end. If usepasswds is FALSE, all
  * levels are displayed. Otherwise, levels after the last level for
  * which the user knows the password are left out. Other levels for
  * which the user doesn't know the password are in the table, but
- * without any information besides the level's number.
+ * without any information besides the level's number. Only the
+ * scores are added up here; the text of each row is produced when
+ * the row is displayed.
  */
 int createscorelist(gameseries const *series, int usepasswds, char zchar,
 		    int **plevellist, int *pcount, tablespec *table)
 {
+    scorelist  *list;
     gamesetup  *game;
-    char      **ptrs;
-    char       *textheap;
-    char       *blank;
     int	       *levellist = NULL;
-    int		levelscore, timescore;
-    long	totalscore;
-    int		count;
-    int		used, j, n;
+    int		count, shown, j;
 
     if (plevellist) {
 	levellist = malloc((series->count + 2) * sizeof *levellist);
 	if (!levellist)
 	    memerrexit();
     }
-    ptrs = malloc((series->count + 2) * 5 * sizeof *ptrs);
-    textheap = malloc((series->count + 2) * 128);
-    if (!ptrs || !textheap)
-	memerrexit();
-    totalscore = 0;
-
-    n = 0;
-    used = 0;
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+Level");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1-Name");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+Base");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+Bonus");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+Score");
-
-    blank = textheap + used;
-    used += 1 + sprintf(textheap + used, "4- ");
+    list = newscorelist(series, zchar, series->count + 1, table, 5,
+			getscorelistrow);
+    list->usepasswds = usepasswds;
 
     count = 0;
+    shown = 0;
     for (j = 0, game = series->games ; j < series->count ; ++j, ++game) {
 	if (j >= series->allocated)
 	    break;
-
-	ptrs[n++] = textheap + used;
-	used += 1 + sprintf(textheap + used, "1+%s",
-			    decimal(game->number, zchar));
 	if (hassolution(game)) {
-	    ptrs[n++] = textheap + used;
-	    used += 1 + sprintf(textheap + used, "1-%.64s", game->name);
-	    if (game->sgflags & SGF_REPLACEABLE) {
-		ptrs[n++] = textheap + used;
-		used += 1 + sprintf(textheap + used, "3.*BAD*");
-	    } else {
-		levelscore = 500 * game->number;
-		ptrs[n++] = textheap + used;
-		used += 1 + sprintf(textheap + used, "1+%s",
-				    cdecimal(levelscore, zchar));
-		ptrs[n++] = textheap + used;
-		if (game->time) {
-		    timescore = 10 * (game->time
+	    if (!(game->sgflags & SGF_REPLACEABLE)) {
+		list->totalscore += 500 * game->number;
+		if (game->time)
+		    list->totalscore += 10 * (game->time
 					- game->besttime / TICKS_PER_SECOND);
-		    used += 1 + sprintf(textheap + used, "1+%s",
-					cdecimal(timescore, zchar));
-		} else {
-		    timescore = 0;
-		    strcpy(textheap + used, "1+---");
-		    used += 6;
-		}
-		ptrs[n++] = textheap + used;
-		used += 1 + sprintf(textheap + used, "1+%s",
-				    cdecimal(levelscore + timescore, zchar));
-		totalscore += levelscore + timescore;
 	    }
 	    if (plevellist)
 		levellist[count] = j;
-	    ++count;
+	    shown = count + 1;
+	} else if (!usepasswds || (game->sgflags & SGF_HASPASSWD)) {
+	    if (plevellist)
+		levellist[count] = j;
+	    shown = count + 1;
 	} else {
-	    if (!usepasswds || (game->sgflags & SGF_HASPASSWD)) {
-		ptrs[n++] = textheap + used;
-		used += 1 + sprintf(textheap + used, "4-%s", game->name);
-		if (plevellist)
-		    levellist[count] = j;
-	    } else {
-		ptrs[n++] = blank;
-		if (plevellist)
-		    levellist[count] = -1;
-	    }
-	    ++count;
+	    if (plevellist)
+		levellist[count] = -1;
 	}
+	list->levels[count] = j;
+	++count;
     }
 
-    while (ptrs[n - 1] == blank) {
-	n -= 2;
-	--count;
-    }
-
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "2-Total Score");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "3+%s", cdecimal(totalscore, zchar));
+    count = shown;
+    list->levels[count] = -1;
     if (plevellist)
 	levellist[count] = -1;
     ++count;
@@ -210,56 +256,86 @@ int createscorelist(gameseries const *series, int usepasswds, char zchar,
 	*plevellist = levellist;
     if (pcount)
 	*pcount = count;
-
     table->rows = count + 1;
-    table->cols = 5;
-    table->sep = 2;
-    table->collapse = 1;
-    table->items = ptrs;
 
     return TRUE;
 }
 
+/* Produce one row of the time list. Row zero is the header.
+ */
+static int gettimelistrow(void *data, int row, char const **cells)
+{
+    scorelist  *list = data;
+    gamesetup  *game;
+    char       *p;
+    long	leveltime;
+    int		secs;
+
+    if (row == 0) {
+	cells[0] = "1+Level";
+	cells[1] = "1-Name";
+	cells[2] = "1+Time";
+	cells[3] = "1+Solution";
+	return 4;
+    }
+
+    game = list->series->games + list->levels[row - 1];
+    sprintf(list->text[0], "1+%s", decimal(game->number, list->zchar));
+    cells[0] = list->text[0];
+    sprintf(list->text[1], "1-%.64s", game->name);
+    cells[1] = list->text[1];
+    if (game->time) {
+	leveltime = game->time * TICKS_PER_SECOND - game->besttime;
+	sprintf(list->text[2], "1+%s", decimal(game->time, list->zchar));
+	cells[2] = list->text[2];
+    } else {
+	leveltime = 999 * TICKS_PER_SECOND - game->besttime;
+	cells[2] = "1+---";
+    }
+    if (game->sgflags & SGF_REPLACEABLE) {
+	cells[3] = "1.*BAD*";
+	return 4;
+    }
+    if (leveltime < 0)
+	secs = -(-leveltime / TICKS_PER_SECOND);
+    else
+	secs = (leveltime + TICKS_PER_SECOND - 1) / TICKS_PER_SECOND;
+    p = list->text[3];
+    p += sprintf(p, "1+%s", decimal(secs, list->zchar));
+    if (list->showpartial) {
+	double f, i;
+	f = modf((double)leveltime / TICKS_PER_SECOND, &i);
+	f = f <= 0 ? -f : 1.0 - f;
+	secs = (int)(f * list->showpartial + 0.49);
+	sprintf(p, " - .%s",
+		decimal(list->showpartial + secs, list->zchar) + 1);
+    }
+    cells[3] = list->text[3];
+    return 4;
+}
+
 /* Produce a table that displays the user's best times for each level
  * that has a solution. If showpartial is zero, times are rounded down
  * to second precision, otherwise fractional values will be
- * calculated.
+ * calculated. The text of each row is produced when the row is
+ * displayed.
  */
 int createtimelist(gameseries const *series, int showpartial, char zchar,
 		   int **plevellist, int *pcount, tablespec *table)
 {
+    scorelist	       *list;
     gamesetup	       *game;
-    char	      **ptrs;
-    char	       *textheap;
-    char	       *untimed;
     int		       *levellist = NULL;
-    long		leveltime;
-    int			count;
-    int			used, secs, j, n;
+    int			count, j;
 
     if (plevellist) {
 	levellist = malloc((series->count + 1) * sizeof *levellist);
 	if (!levellist)
 	    memerrexit();
     }
-    ptrs = malloc((series->count + 1) * 4 * sizeof *ptrs);
-    textheap = malloc((series->count + 1) * 128);
-    if (!ptrs || !textheap)
-	memerrexit();
-
-    n = 0;
-    used = 0;
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+Level");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1-Name");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+Time");
-    ptrs[n++] = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+Solution");
-
-    untimed = textheap + used;
-    used += 1 + sprintf(textheap + used, "1+---");
+    list = newscorelist(series, zchar, series->count, table, 4,
+			gettimelistrow);
+    list->showpartial = showpartial;
 
     count = 0;
     for (j = 0, game = series->games ; j < series->count ; ++j, ++game) {
@@ -267,42 +343,9 @@ int createtimelist(gameseries const *series, int showpartial, char zchar,
 	    break;
 	if (!hassolution(game))
 	    continue;
-	ptrs[n++] = textheap + used;
-	used += 1 + sprintf(textheap + used, "1+%s",
-			    decimal(game->number, zchar));
-	ptrs[n++] = textheap + used;
-	used += 1 + sprintf(textheap + used, "1-%.64s", game->name);
-	if (game->time) {
-	    leveltime = game->time * TICKS_PER_SECOND - game->besttime;
-	    ptrs[n++] = textheap + used;
-	    used += 1 + sprintf(textheap + used, "1+%s",
-				decimal(game->time, zchar));
-	} else {
-	    leveltime = 999 * TICKS_PER_SECOND - game->besttime;
-	    ptrs[n++] = untimed;
-	}
-	if (game->sgflags & SGF_REPLACEABLE) {
-	    ptrs[n++] = textheap + used;
-	    used += 1 + sprintf(textheap + used, "1.*BAD*");
-	} else {
-	    if (leveltime < 0)
-		secs = -(-leveltime / TICKS_PER_SECOND);
-	    else
-		secs = (leveltime + TICKS_PER_SECOND - 1) / TICKS_PER_SECOND;
-	    ptrs[n++] = textheap + used;
-	    used += 1 + sprintf(textheap + used, "1+%s", decimal(secs, zchar));
-	    if (showpartial) {
-		double f, i;
-		f = modf((double)leveltime / TICKS_PER_SECOND, &i);
-		f = f <= 0 ? -f : 1.0 - f;
-		secs = (int)(f * showpartial + 0.49);
-		--used;
-		used += 1 + sprintf(textheap + used, " - .%s",
-				    decimal(showpartial + secs, zchar) + 1);
-	    }
-	}
 	if (plevellist)
 	    levellist[count] = j;
+	list->levels[count] = j;
 	++count;
     }
 
@@ -310,12 +353,7 @@ int createtimelist(gameseries const *series, int showpartial, char zchar,
 	*plevellist = levellist;
     if (pcount)
 	*pcount = count;
-
     table->rows = count + 1;
-    table->cols = 4;
-    table->sep = 2;
-    table->collapse = 1;
-    table->items = ptrs;
 
     return TRUE;
 }
@@ -324,9 +362,13 @@ int createtimelist(gameseries const *series, int showpartial, char zchar,
  */
 void freescorelist(int *levellist, tablespec *table)
 {
+    scorelist  *list;
+
     free(levellist);
-    if (table) {
-	free(table->items[0]);
-	free(table->items);
+    if (table && table->rowdata) {
+	list = table->rowdata;
+	free(list->levels);
+	free(list);
+	table->rowdata = NULL;
     }
 }
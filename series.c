@@ -15,6 +15,7 @@
 #include	"solution.h"
 #include	"unslist.h"
 #include	"messages.h"
+#include	"encoding.h"
 #include	"series.h"
 
 /* The signature bytes of the data files.
@@ -24,6 +25,10 @@
 #define	SIG_DATFILE_MS		0x0002
 #define	SIG_DATFILE_LYNX	0x0102
 
+/* The flag added to the ruleset signature of a compiled data file.
+ */
+#define	SIG_DATFILE_COMPILED	0x8000
+
 /* The "signature bytes" of the configuration files.
  */
 #define	SIG_DACFILE		0x656C6966
@@ -46,6 +51,27 @@ static char const      *seriesdir = NULL;
  */
 static char const      *seriesdatdir = NULL;
 
+/* The maximum number of bytes of level and solution data to keep in
+ * memory, or zero if all levels are to be kept in memory.
+ */
+static unsigned long	levelmemorylimit = 0;
+
+/* The levels whose data is subject to the memory limit, the number of
+ * bytes of their data currently in memory, the data file that the
+ * discarded data is reread from, and the position of the "clock hand"
+ * that selects the next level to discard.
+ */
+static gamesetup       *managedgames = NULL;
+static int		managedcount = 0;
+static unsigned long	levelmemoryused = 0;
+static fileinfo		levelsource;
+static int		levelsourcecompiled = FALSE;
+static int		clockhand = 0;
+
+/* The solution file that discarded solution data is reread from.
+ */
+static fileinfo		solutionsource;
+
 /* Getting and setting the series directory.
  */
 char const *getseriesdir(void)		{ return seriesdir; }
@@ -56,6 +82,10 @@ void setseriesdir(char const *dir)	{ seriesdir = dir; }
 char const *getseriesdatdir(void)	{ return seriesdatdir; }
 void setseriesdatdir(char const *dir)	{ seriesdatdir = dir; }
 
+/* Setting the limit on memory used for level data.
+ */
+void setlevelmemorylimit(unsigned long bytes) { levelmemorylimit = bytes; }
+
 /* Calculate a hash value for the given block of data.
  */
 static unsigned long hashvalue(unsigned char const *data, unsigned int size)
@@ -116,6 +146,67 @@ static unsigned long hashvalue(unsigned char const *data, unsigned int size)
     return accum ^ 0xFFFFFFFFUL;
 }
 
+/*
+ * Indexing the levels.
+ */
+
+/* Hash functions for the level index tables. The size of the tables
+ * is always a power of two.
+ */
+#define	numberhash(series, num) \
+	    (((unsigned)(num) * 2654435761U) & ((series)->indexsize - 1))
+#define	passwdhash(series, pw) \
+	    (hashvalue((unsigned char const*)(pw), strlen(pw)) \
+						& ((series)->indexsize - 1))
+
+/* The hash tables of level indexes, by number and by password.
+ */
+#define	numberindex(series)	((series)->levelindex)
+#define	passwdindex(series)	((series)->levelindex + (series)->indexsize)
+
+/* Discard the level index tables.
+ */
+static void freelevelindex(gameseries *series)
+{
+    free(series->levelindex);
+    series->levelindex = NULL;
+    series->indexsize = 0;
+}
+
+/* Build the tables used by findlevelinseries() to look up levels by
+ * number and by password. Each table is an open-addressed hash table
+ * of indexes into the games array, with -1 marking unused slots. A
+ * level with a duplicated key simply goes into the next free slot, so
+ * a lookup still finds all of the matching levels.
+ */
+static void buildlevelindex(gameseries *series)
+{
+    int	       *table;
+    int		i, n;
+
+    freelevelindex(series);
+    for (n = 16 ; n < 2 * series->count ; n <<= 1) ;
+    series->indexsize = n;
+    xalloc(series->levelindex, 2 * n * sizeof *series->levelindex);
+    for (i = 0 ; i < 2 * n ; ++i)
+	series->levelindex[i] = -1;
+
+    table = numberindex(series);
+    for (i = 0 ; i < series->count ; ++i) {
+	n = numberhash(series, series->games[i].number);
+	while (table[n] >= 0)
+	    n = (n + 1) & (series->indexsize - 1);
+	table[n] = i;
+    }
+    table = passwdindex(series);
+    for (i = 0 ; i < series->count ; ++i) {
+	n = passwdhash(series, series->games[i].passwd);
+	while (table[n] >= 0)
+	    n = (n + 1) & (series->indexsize - 1);
+	table[n] = i;
+    }
+}
+
 /*
  * Reading the data file.
  */
@@ -134,7 +225,9 @@ static int readseriesheader(gameseries *series)
 	return fileerr(&series->mapfile, "not a valid data file");
     if (!filereadint16(&series->mapfile, &val16, "not a valid data file"))
 	return FALSE;
-    switch (val16) {
+    if (val16 & SIG_DATFILE_COMPILED)
+	series->gsflags |= GSF_COMPILED;
+    switch (val16 & ~SIG_DATFILE_COMPILED) {
       case SIG_DATFILE_MS:	ruleset = Ruleset_MS;		break;
       case SIG_DATFILE_LYNX:	ruleset = Ruleset_Lynx;		break;
       default:
@@ -155,12 +248,15 @@ static int readseriesheader(gameseries *series)
 }
 
 /* Read a single level out of the given data file. The level's name,
- * password, and time limit are extracted from the data.
+ * password, and time limit are extracted from the data. If compiled
+ * is TRUE, the level's compiled image is read as well.
  */
-static int readleveldata(fileinfo *file, gamesetup *game)
+static int readleveldata(fileinfo *file, gamesetup *game, int compiled)
 {
     unsigned char	       *data;
     unsigned char const	       *dataend;
+    unsigned char	       *image = NULL;
+    unsigned long		hash;
     unsigned short		size;
     int				n;
 
@@ -169,13 +265,28 @@ static int readleveldata(fileinfo *file, gamesetup *game)
     data = filereadbuf(file, size, "missing or invalid level data");
     if (!data)
 	return FALSE;
+    if (compiled) {
+	image = filereadbuf(file, LEVELIMAGE_SIZE,
+			    "missing or invalid compiled level data");
+	if (!image) {
+	    free(data);
+	    return FALSE;
+	}
+    }
+    hash = hashvalue(data, size);
+    if (image && !checklevelimage(image, hash)) {
+	free(image);
+	image = NULL;
+    }
     if (size < 2) {
 	fileerr(file, "invalid level data");
 	free(data);
+	free(image);
 	return FALSE;
     }
     game->levelsize = size;
     game->leveldata = data;
+    game->levelimage = image;
     dataend = game->leveldata + game->levelsize;
 
     game->number = data[0] | (data[1] << 8);
@@ -224,17 +335,272 @@ static int readleveldata(fileinfo *file, gamesetup *game)
     if (!game->passwd[0] || strlen(game->passwd) != 4)
 	goto badlevel;
 
-    game->levelhash = hashvalue(game->leveldata, game->levelsize);
+    game->levelhash = hash;
     return TRUE;
 
   badlevel:
     free(game->leveldata);
+    free(game->levelimage);
     game->levelsize = 0;
     game->leveldata = NULL;
+    game->levelimage = NULL;
     errmsg(file->name, "level %d: invalid level data", game->number);
     return FALSE;
 }
 
+/*
+ * Keeping level data within the memory limit.
+ */
+
+/* The number of bytes of memory occupied by a level's data.
+ */
+#define	leveldatasize(game)	\
+    ((game)->levelsize + ((game)->levelimage ? LEVELIMAGE_SIZE : 0))
+
+/* True if game is one of the levels subject to the memory limit.
+ */
+#define	ismanaged(game)	\
+    (managedgames && (game) >= managedgames \
+		  && (game) < managedgames + managedcount)
+
+/* True if the clock hand is permitted to discard some of the level's
+ * data, i.e. if the data is in memory and can be reread from a file.
+ */
+#define	isdiscardable(game)						\
+    (((game)->leveldata && ((game)->ldflags & LDF_REREADABLE))		\
+     || ((game)->solutiondata && ((game)->ldflags & LDF_SOLREREADABLE)))
+
+/* Free the given level's data, and update the tally of memory used.
+ */
+static void discardleveldata(gamesetup *game)
+{
+    if (managedgames && game->leveldata)
+	levelmemoryused -= leveldatasize(game);
+    free(game->leveldata);
+    game->leveldata = NULL;
+    free(game->levelimage);
+    game->levelimage = NULL;
+}
+
+/* Free the given level's solution data, leaving the solution's size
+ * in place, and update the tally of memory used.
+ */
+static void discardsolutiondata(gamesetup *game)
+{
+    if (game->solutiondata)
+	levelmemoryused -= game->solutionsize;
+    free(game->solutiondata);
+    game->solutiondata = NULL;
+}
+
+/* Discard level and solution data until the memory used is within
+ * the limit. The levels are visited in turn by a clock hand, which
+ * clears the recently-used flag of each level it passes, and a
+ * level's data is only discarded when the hand finds the flag already
+ * clear. Thus the levels discarded are those that have gone longest
+ * without use. The data of keep, and data that cannot be reread, is
+ * not touched.
+ */
+static void trimlevelmemory(gamesetup const *keep)
+{
+    gamesetup  *game;
+    int		n;
+
+    if (!managedgames || !levelmemorylimit)
+	return;
+    n = 2 * managedcount;
+    for ( ; n && levelmemoryused > levelmemorylimit ; --n) {
+	if (clockhand >= managedcount)
+	    clockhand = 0;
+	game = managedgames + clockhand++;
+	if (game == keep || !isdiscardable(game))
+	    continue;
+	if (game->ldflags & LDF_RECENTLYUSED) {
+	    game->ldflags &= ~LDF_RECENTLYUSED;
+	} else {
+	    if (game->ldflags & LDF_REREADABLE)
+		discardleveldata(game);
+	    if (game->ldflags & LDF_SOLREREADABLE)
+		discardsolutiondata(game);
+	}
+    }
+}
+
+/* Read a level's data back in from the data file after it has been
+ * discarded. The level's other fields are left untouched, so the data
+ * is refused if it is not the same as what was read the first time.
+ */
+static int rereadleveldata(fileinfo *file, gamesetup *game, int compiled)
+{
+    unsigned char      *data;
+    unsigned char      *image = NULL;
+    unsigned long	hash;
+    unsigned short	size;
+
+    if (!filesetpos(file, &game->levelpos, "cannot reread level data")
+		|| !filereadint16(file, &size, "cannot reread level data"))
+	return FALSE;
+    if (size != game->levelsize)
+	return fileerr(file, "level data has changed since it was read");
+    data = filereadbuf(file, size, "cannot reread level data");
+    if (!data)
+	return FALSE;
+    hash = hashvalue(data, size);
+    if (hash != game->levelhash) {
+	free(data);
+	return fileerr(file, "level data has changed since it was read");
+    }
+    if (compiled) {
+	image = filereadbuf(file, LEVELIMAGE_SIZE,
+			    "cannot reread compiled level data");
+	if (image && !checklevelimage(image, hash)) {
+	    free(image);
+	    image = NULL;
+	}
+    }
+    game->leveldata = data;
+    game->levelimage = image;
+    return TRUE;
+}
+
+/* Make sure that the given level's data is in memory.
+ */
+int loadleveldata(gamesetup *game)
+{
+    game->ldflags |= LDF_RECENTLYUSED;
+    if (game->leveldata)
+	return TRUE;
+    if (!(game->ldflags & LDF_REREADABLE) || !levelsource.fp) {
+	errmsg(NULL, "level %d: level data is unavailable", game->number);
+	return FALSE;
+    }
+    if (!rereadleveldata(&levelsource, game, levelsourcecompiled))
+	return FALSE;
+    levelmemoryused += leveldatasize(game);
+    trimlevelmemory(game);
+    return TRUE;
+}
+
+/* Read a level's solution data back in from the solution file after
+ * it has been discarded. As with the level data, the data is refused
+ * if it is not the same as what was in memory before.
+ */
+static int rereadsolutiondata(fileinfo *file, gamesetup *game)
+{
+    unsigned char      *data;
+    unsigned long	size;
+
+    if (!filesetpos(file, &game->solutionpos, "cannot reread solution data")
+		|| !filereadint32(file, &size, "cannot reread solution data"))
+	return FALSE;
+    if (size != (unsigned long)game->solutionsize)
+	return fileerr(file, "solution data has changed since it was read");
+    data = filereadbuf(file, size, "cannot reread solution data");
+    if (!data)
+	return FALSE;
+    if (hashvalue(data, size) != game->solutionhash) {
+	free(data);
+	return fileerr(file, "solution data has changed since it was read");
+    }
+    game->solutiondata = data;
+    return TRUE;
+}
+
+/* Make sure that the given level's solution data is in memory.
+ */
+int loadsolutiondata(gamesetup *game)
+{
+    game->ldflags |= LDF_RECENTLYUSED;
+    if (game->solutiondata || !game->solutionsize)
+	return TRUE;
+    if (!(game->ldflags & LDF_SOLREREADABLE) || !solutionsource.fp) {
+	errmsg(NULL, "level %d: solution data is unavailable", game->number);
+	return FALSE;
+    }
+    if (!rereadsolutiondata(&solutionsource, game))
+	return FALSE;
+    levelmemoryused += game->solutionsize;
+    trimlevelmemory(game);
+    return TRUE;
+}
+
+/* Add a level's newly created solution data to the tally of memory
+ * used.
+ */
+void addsolutiondata(gamesetup *game)
+{
+    if (!ismanaged(game) || !game->solutiondata)
+	return;
+    game->ldflags |= LDF_RECENTLYUSED;
+    levelmemoryused += game->solutionsize;
+    trimlevelmemory(game);
+}
+
+/* Free a level's solution data, and update the tally of memory used.
+ */
+void freesolutiondata(gamesetup *game)
+{
+    if (ismanaged(game) && game->solutiondata)
+	levelmemoryused -= game->solutionsize;
+    free(game->solutiondata);
+    game->solutiondata = NULL;
+    game->solutionsize = 0;
+    game->ldflags &= ~LDF_SOLREREADABLE;
+}
+
+/* Record where a level's solution is stored in the solution file.
+ */
+void setsolutionpos(gamesetup *game, fpos_t const *pos)
+{
+    if (!ismanaged(game) || !game->solutionsize)
+	return;
+    if (game->solutiondata)
+	game->solutionhash = hashvalue(game->solutiondata,
+				       game->solutionsize);
+    game->solutionpos = *pos;
+    game->ldflags |= LDF_SOLREREADABLE;
+}
+
+/* Change the solution file that discarded solution data is reread
+ * from. Solution data that has become rereadable is then discarded as
+ * needed to stay within the limit.
+ */
+int setsolutionsource(char const *filename)
+{
+    int	f = TRUE;
+
+    fileclose(&solutionsource, NULL);
+    clearfileinfo(&solutionsource);
+    if (managedgames && filename)
+	f = fileopen(&solutionsource, filename, "rb",
+		     "cannot reopen solution file");
+    trimlevelmemory(NULL);
+    return f;
+}
+
+/* Return TRUE if the levels of the given series are subject to the
+ * memory limit.
+ */
+int islevelmemorylimited(gameseries const *series)
+{
+    return series->games && series->games == managedgames;
+}
+
+/* Stop applying the memory limit to a series' levels, and close the
+ * files kept open for rereading them.
+ */
+static void releasemanagedlevels(void)
+{
+    fileclose(&levelsource, NULL);
+    clearfileinfo(&levelsource);
+    fileclose(&solutionsource, NULL);
+    clearfileinfo(&solutionsource);
+    managedgames = NULL;
+    managedcount = 0;
+    levelmemoryused = 0;
+    clockhand = 0;
+}
+
 /* Assuming that the series passed in is in fact the original
  * chips.dat file, this function undoes the changes that MS introduced
  * to the original Lynx levels. A rather "ad hack" way to accomplish
@@ -267,6 +633,8 @@ static int undomschanges(gameseries *series)
 	{ 126,  0x01B6,  0x01 },	{ 126,  0x01C2,  0x00 },
 	{ -1, -1, -1 }
     };
+    gamesetup  *game;
+    int		n;
 
     if (series->count != 149)
 	return FALSE;
@@ -274,10 +642,25 @@ static int undomschanges(gameseries *series)
 	if (series->games[fixup->num].levelsize <= fixup->pos)
 	    return FALSE;
 
-    free(series->games[144].leveldata);
+    for (fixup = fixups ; fixup->num >= 0 ; ++fixup) {
+	game = series->games + fixup->num;
+	if (!loadleveldata(game))
+	    return FALSE;
+	game->ldflags &= ~LDF_REREADABLE;
+    }
+    for (n = 0 ; n < series->count ; ++n) {
+	game = series->games + n;
+	if (game->levelimage && managedgames)
+	    levelmemoryused -= LEVELIMAGE_SIZE;
+	free(game->levelimage);
+	game->levelimage = NULL;
+    }
+    discardleveldata(series->games + 144);
     memmove(series->games + 144, series->games + 145,
 	    4 * sizeof *series->games);
     --series->count;
+    if (managedgames == series->games)
+	managedcount = series->count;
 
     for (fixup = fixups ; fixup->num >= 0 ; ++fixup)
 	series->games[fixup->num].leveldata[fixup->pos] = fixup->val;
@@ -303,7 +686,8 @@ static int undomschanges(gameseries *series)
  */
 int readseriesfile(gameseries *series)
 {
-    int	n;
+    gamesetup  *game;
+    int		n;
 
     if (series->gsflags & GSF_ALLMAPSREAD)
 	return TRUE;
@@ -316,6 +700,8 @@ int readseriesfile(gameseries *series)
 	if (!openfileindir(&series->mapfile, seriesdir,
 			   series->mapfilename, "rb", "unknown error"))
 	    return FALSE;
+	if (!levelmemorylimit)
+	    filebuffer(&series->mapfile, NULL);
 	if (!readseriesheader(series))
 	    return FALSE;
     }
@@ -324,17 +710,42 @@ int readseriesfile(gameseries *series)
     memset(series->games + series->allocated, 0,
 	   (series->count - series->allocated) * sizeof *series->games);
     series->allocated = series->count;
+    if (levelmemorylimit) {
+	releasemanagedlevels();
+	managedgames = series->games;
+	managedcount = series->count;
+    }
     n = 0;
     while (n < series->count && !filetestend(&series->mapfile)) {
-	if (readleveldata(&series->mapfile, series->games + n))
+	game = series->games + n;
+	if (managedgames && !filegetpos(&series->mapfile, &game->levelpos,
+					"cannot read data file"))
+	    break;
+	if (readleveldata(&series->mapfile, game,
+			  series->gsflags & GSF_COMPILED)) {
+	    if (managedgames) {
+		game->ldflags = LDF_REREADABLE | LDF_RECENTLYUSED;
+		levelmemoryused += leveldatasize(game);
+		trimlevelmemory(game);
+	    }
 	    ++n;
-	else
+	} else {
 	    --series->count;
+	}
+    }
+    if (managedgames) {
+	series->count = n;
+	managedcount = n;
+	levelsource = series->mapfile;
+	levelsourcecompiled = series->gsflags & GSF_COMPILED;
+	clearfileinfo(&series->mapfile);
+    } else {
+	fileclose(&series->mapfile, NULL);
     }
-    fileclose(&series->mapfile, NULL);
     series->gsflags |= GSF_ALLMAPSREAD;
     if (series->gsflags & GSF_LYNXFIXES)
 	undomschanges(series);
+    buildlevelindex(series);
     markunsolvablelevels(series);
     readsolutions(series);
     if (series->msgfilename)
@@ -342,6 +753,42 @@ int readseriesfile(gameseries *series)
     return TRUE;
 }
 
+/* Write out the levels of the given series as a compiled data file.
+ * The original level data is stored unchanged, and each level is
+ * followed by its compiled image.
+ */
+int writecompiledseries(gameseries const *series, char const *filename)
+{
+    fileinfo		file;
+    gamesetup	       *game;
+    unsigned char      *image;
+    unsigned short	sig;
+    int			f, n;
+
+    if (!(image = malloc(LEVELIMAGE_SIZE)))
+	memerrexit();
+    clearfileinfo(&file);
+    if (!fileopen(&file, filename, "wb", "cannot create compiled file")) {
+	free(image);
+	return FALSE;
+    }
+    sig = series->ruleset == Ruleset_Lynx ? SIG_DATFILE_LYNX : SIG_DATFILE_MS;
+    f = filewriteint16(&file, SIG_DATFILE, "write error")
+     && filewriteint16(&file, sig | SIG_DATFILE_COMPILED, "write error")
+     && filewriteint16(&file, series->count, "write error");
+    for (n = 0, game = series->games ; f && n < series->count ; ++n, ++game) {
+	if (!(f = loadleveldata(game)))
+	    break;
+	compileleveldata(game, image);
+	f = filewriteint16(&file, game->levelsize, "write error")
+	 && filewrite(&file, game->leveldata, game->levelsize, "write error")
+	 && filewrite(&file, image, LEVELIMAGE_SIZE, "write error");
+    }
+    fileclose(&file, NULL);
+    free(image);
+    return f;
+}
+
 /* Free all memory allocated for the given gameseries.
  */
 void freeseriesdata(gameseries *series)
@@ -350,6 +797,9 @@ void freeseriesdata(gameseries *series)
     int		n;
 
     clearsolutions(series);
+    freelevelindex(series);
+    if (series->games && series->games == managedgames)
+	releasemanagedlevels();
 
     fileclose(&series->mapfile, NULL);
     clearfileinfo(&series->mapfile);
@@ -368,6 +818,8 @@ void freeseriesdata(gameseries *series)
 	free(game->leveldata);
 	game->leveldata = NULL;
 	game->levelsize = 0;
+	free(game->levelimage);
+	game->levelimage = NULL;
     }
     free(series->games);
     series->games = NULL;
@@ -508,6 +960,8 @@ static int getseriesfile(char *filename, void *data)
     series->final = 0;
     series->ruleset = Ruleset_None;
     series->games = NULL;
+    series->levelindex = NULL;
+    series->indexsize = 0;
     sprintf(series->filebase, "%.*s", (int)(sizeof series->filebase - 1),
 				      filename);
     sprintf(series->name, "%.*s", (int)(sizeof series->name - 1),
@@ -671,6 +1125,8 @@ int createserieslist(char const *preferredfile, gameseries **pserieslist,
     table->sep = 2;
     table->collapse = 0;
     table->items = ptrs;
+    table->getrow = NULL;
+    table->rowdata = NULL;
     return TRUE;
 }
 
@@ -709,14 +1165,33 @@ void freeserieslist(gameseries *list, int count, tablespec *table)
  */
 
 /* A function for looking up a specific level in a series by number
- * and/or password.
+ * and/or password. The index tables are used if they have been built;
+ * otherwise the levels are searched sequentially.
  */
 int findlevelinseries(gameseries const *series, int number, char const *passwd)
 {
-    int	i, n;
+    int const  *table;
+    int		i, j, n;
 
     n = -1;
-    if (number) {
+    if (series->levelindex && (number || passwd)) {
+	if (number) {
+	    table = numberindex(series);
+	    j = numberhash(series, number);
+	} else {
+	    table = passwdindex(series);
+	    j = passwdhash(series, passwd);
+	}
+	for ( ; (i = table[j]) >= 0 ; j = (j + 1) & (series->indexsize - 1)) {
+	    if (number && series->games[i].number != number)
+		continue;
+	    if (passwd && strcmp(series->games[i].passwd, passwd))
+		continue;
+	    if (n >= 0)
+		return -1;
+	    n = i;
+	}
+    } else if (number) {
 	for (i = 0 ; i < series->count ; ++i) {
 	    if (series->games[i].number == number) {
 		if (!passwd || !strcmp(series->games[i].passwd, passwd)) {
@@ -19,10 +19,62 @@ extern void setseriesdir(char const *dir);
 extern char const *getseriesdatdir(void);
 extern void setseriesdatdir(char const *dir);
 
+/* Set the maximum number of bytes of level data to keep in memory.
+ * When a series is read with a limit in effect, the data and saved
+ * solutions of the least recently used levels are discarded as
+ * needed, and are read back in from the data file and the solution
+ * file on demand. A value of zero removes the limit.
+ */
+extern void setlevelmemorylimit(unsigned long bytes);
+
 /* Load all levels of the given series.
  */
 extern int readseriesfile(gameseries *series);
 
+/* Make sure that the level data of game is in memory, rereading it
+ * from the data file if necessary. FALSE is returned if the data
+ * could not be reread.
+ */
+extern int loadleveldata(gamesetup *game);
+
+/* Return TRUE if the levels of series are subject to the memory
+ * limit, in which case their solution data is subject to it as well.
+ */
+extern int islevelmemorylimited(gameseries const *series);
+
+/* Make sure that the solution data of game is in memory, rereading
+ * it from the solution file if necessary. FALSE is returned if the
+ * data could not be reread.
+ */
+extern int loadsolutiondata(gamesetup *game);
+
+/* Count the solution data just given to game against the memory
+ * limit. The data cannot be discarded until its position in the
+ * solution file has been recorded with setsolutionpos().
+ */
+extern void addsolutiondata(gamesetup *game);
+
+/* Free the solution data of game, whether or not it is in memory.
+ */
+extern void freesolutiondata(gamesetup *game);
+
+/* Record pos as the location of game's solution in the solution
+ * file, so that the solution data can be discarded and reread.
+ */
+extern void setsolutionpos(gamesetup *game, fpos_t const *pos);
+
+/* Set the solution file that discarded solution data is reread from,
+ * or close it if filename is NULL. FALSE is returned if the file
+ * could not be opened.
+ */
+extern int setsolutionsource(char const *filename);
+
+/* Write the levels of the given series to filename as a compiled
+ * data file, in which each level's map is stored already decoded.
+ */
+extern int writecompiledseries(gameseries const *series,
+			       char const *filename);
+
 /* Release all resources associated with a gameseries structure.
  */
 extern void freeseriesdata(gameseries *series);
@@ -169,6 +169,13 @@ void setreadonly(void)
     readonly = TRUE;
 }
 
+/* Return TRUE if the system is in read-only mode.
+ */
+int isreadonly(void)
+{
+    return readonly;
+}
+
 /*
  * Functions for manipulating move lists.
  */
@@ -379,9 +386,7 @@ int contractsolution(solutioninfo const *solution, gamesetup *game)
     unsigned char      *data;
     int			size, delta, when, i;
 
-    free(game->solutiondata);
-    game->solutionsize = 0;
-    game->solutiondata = NULL;
+    freesolutiondata(game);
     if (!solution->moves.count)
 	return TRUE;
 
@@ -477,6 +482,7 @@ int contractsolution(solutioninfo const *solution, gamesetup *game)
     game->solutiondata = realloc(data, size);
     if (!game->solutiondata)
 	game->solutiondata = data;
+    addsolutiondata(game);
     return TRUE;
 }
 
@@ -556,6 +562,25 @@ static int writesolution(fileinfo *file, gamesetup const *game)
  * File I/O for solution files.
  */
 
+/* Return the default name of the solution file for the given data
+ * file. The caller must free the returned buffer.
+ */
+static char *defaultsolutionname(char const *datname)
+{
+    char       *buf = NULL;
+    int		n;
+
+    n = strlen(datname);
+    if (datname[n - 4] == '.' && tolower(datname[n - 3]) == 'd'
+			      && tolower(datname[n - 2]) == 'a'
+			      && tolower(datname[n - 1]) == 't')
+	n -= 4;
+    xalloc(buf, n + 5);
+    memcpy(buf, datname, n);
+    memcpy(buf + n, ".tws", 5);
+    return buf;
+}
+
 /* Locate the solution file for the given data file and open it.
  */
 static int opensolutionfile(fileinfo *file, char const *datname, int mode)
@@ -571,14 +596,7 @@ static int opensolutionfile(fileinfo *file, char const *datname, int mode)
     if (file->name) {
 	filename = file->name;
     } else {
-	n = strlen(datname);
-	if (datname[n - 4] == '.' && tolower(datname[n - 3]) == 'd'
-				  && tolower(datname[n - 2]) == 'a'
-				  && tolower(datname[n - 1]) == 't')
-	    n -= 4;
-	xalloc(buf, n + 5);
-	memcpy(buf, datname, n);
-	memcpy(buf + n, ".tws", 5);
+	buf = defaultsolutionname(datname);
 	filename = buf;
     }
 
@@ -600,11 +618,34 @@ static int opensolutionfile(fileinfo *file, char const *datname, int mode)
     return n;
 }
 
+/* Return the pathname of the given series' solution file, or NULL if
+ * the pathname is too long. The caller must free the returned buffer.
+ */
+static char *getsolutionpath(gameseries const *series)
+{
+    char       *buf;
+    char       *path;
+
+    if (series->savefile.name)
+	return getpathforfileindir(savedir, series->savefile.name);
+    buf = defaultsolutionname(series->filebase);
+    path = getpathforfileindir(savedir, buf);
+    free(buf);
+    return path;
+}
+
 /* Read the saved solution data for the given series into memory.
+ * When the series is subject to the memory limit, the location of
+ * each solution is recorded, so that its data can be discarded and
+ * then reread on demand.
  */
 int readsolutions(gameseries *series)
 {
     gamesetup	gametmp;
+    gamesetup  *game;
+    fpos_t	pos;
+    char       *path;
+    int		managed;
     int		n;
 
     if (!series->savefile.name)
@@ -616,6 +657,9 @@ int readsolutions(gameseries *series)
 	series->solheadersize = 0;
 	return TRUE;
     }
+    managed = islevelmemorylimited(series);
+    if (!managed)
+	filebuffer(&series->savefile, NULL);
 
     if (!readsolutionheader(&series->savefile, series->ruleset,
 			    &series->currentlevel,
@@ -627,6 +671,9 @@ int readsolutions(gameseries *series)
 
     memset(&gametmp, 0, sizeof gametmp);
     for (;;) {
+	if (managed && !filegetpos(&series->savefile, &pos,
+				   "cannot read solution file"))
+	    break;
 	if (!readsolution(&series->savefile, &gametmp))
 	    break;
 	if (gametmp.sgflags & SGF_SETNAME) {
@@ -650,16 +697,86 @@ int readsolutions(gameseries *series)
 	    warn("level %d has been moved to level %d",
 		 gametmp.number, series->games[n].number);
 	}
-	series->games[n].besttime = gametmp.besttime;
-	series->games[n].sgflags = gametmp.sgflags;
-	series->games[n].solutionsize = gametmp.solutionsize;
-	series->games[n].solutiondata = gametmp.solutiondata;
+	game = series->games + n;
+	freesolutiondata(game);
+	game->besttime = gametmp.besttime;
+	game->sgflags = gametmp.sgflags;
+	game->solutionsize = gametmp.solutionsize;
+	game->solutiondata = gametmp.solutiondata;
+	if (managed) {
+	    setsolutionpos(game, &pos);
+	    addsolutiondata(game);
+	}
     }
 
+    if (managed) {
+	path = getsolutionpath(series);
+	setsolutionsource(path);
+	free(path);
+    }
     fileclose(&series->savefile, NULL);
     return TRUE;
 }
 
+/* Write out all the solutions for a series that is subject to the
+ * memory limit. Solution data that is not in memory has to be read
+ * back in from the existing file, so the new file is written under a
+ * temporary name and then moved into place. The recorded locations
+ * of the solutions are updated afterwards.
+ */
+static int rewritesolutions(gameseries *series)
+{
+    fileinfo	file;
+    gamesetup  *game;
+    fpos_t     *pos = NULL;
+    char       *path;
+    char       *tmppath = NULL;
+    int		f, i;
+
+    path = getsolutionpath(series);
+    if (!path)
+	return fileerr(&series->savefile, "can't access file");
+    xalloc(tmppath, strlen(path) + 5);
+    sprintf(tmppath, "%s.tmp", path);
+    clearfileinfo(&file);
+    if (!fileopen(&file, tmppath, "wb", "can't access file")) {
+	free(tmppath);
+	free(path);
+	return FALSE;
+    }
+
+    xalloc(pos, (series->count + 1) * sizeof *pos);
+    f = writesolutionheader(&file, series->ruleset, series->currentlevel,
+			    series->solheadersize, series->solheader)
+     && writesolutionsetname(&file, series->name);
+    if (!f)
+	fileerr(&file, "write error");
+    for (i = 0, game = series->games ; f && i < series->count ; ++i, ++game)
+	f = filegetpos(&file, pos + i, "write error")
+	 && loadsolutiondata(game)
+	 && writesolution(&file, game);
+    fileclose(&file, NULL);
+
+    if (f) {
+	setsolutionsource(NULL);
+	f = !rename(tmppath, path)
+	 || (!remove(path) && !rename(tmppath, path));
+	if (f) {
+	    for (i = 0, game = series->games ; i < series->count ; ++i, ++game)
+		setsolutionpos(game, pos + i);
+	} else {
+	    errmsg(path, "cannot replace solution file");
+	}
+	setsolutionsource(path);
+    } else {
+	remove(tmppath);
+    }
+    free(pos);
+    free(tmppath);
+    free(path);
+    return f;
+}
+
 /* Write out all the solutions for the given series.
  */
 int savesolutions(gameseries *series)
@@ -676,6 +793,8 @@ int savesolutions(gameseries *series)
 	series->savefile.name = series->savefilename;
     if (!series->savefile.name && (series->gsflags & GSF_NODEFAULTSAVE))
 	return TRUE;
+    if (islevelmemorylimited(series))
+	return rewritesolutions(series);
     if (!opensolutionfile(&series->savefile, series->filebase, F_WRITE))
 	return FALSE;
 
@@ -727,11 +846,9 @@ void clearsolutions(gameseries *series)
     int		n;
 
     for (n = 0, game = series->games ; n < series->count ; ++n, ++game) {
-	free(game->solutiondata);
+	freesolutiondata(game);
 	game->besttime = TIME_NIL;
 	game->sgflags = 0;
-	game->solutionsize = 0;
-	game->solutiondata = NULL;
     }
     series->solheadersize = 0;
     series->currentlevel = 0;
@@ -859,6 +976,8 @@ int createsolutionfilelist(gameseries const *series, int morethanone,
     table->cols = 2;
     table->sep = 1;
     table->collapse = 1;
+    table->getrow = NULL;
+    table->rowdata = NULL;
     table->items[0] = "2-Select a solution file";
     offset = 0;
     for (i = 0 ; i < s.count ; ++i) {
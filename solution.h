@@ -19,6 +19,10 @@ extern void setsavedir(char const *dir);
  */
 extern void setreadonly(void);
 
+/* Return TRUE if file modification is prohibited.
+ */
+extern int isreadonly(void);
+
 /* Initialize or reinitialize list as empty.
  */
 extern void initmovelist(actlist *list);
@@ -0,0 +1,243 @@
+/* telemetry.c: Measuring where the time of each tick goes.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"gen.h"
+#include	"err.h"
+#include	"oshw.h"
+#include	"telemetry.h"
+
+/* The number of ticks that the overlay summarizes.
+ */
+#define	OVERLAYTICKS	TICKS_PER_SECOND
+
+/* The times collected for one phase, in microseconds.
+ */
+typedef	struct phasestats {
+    unsigned long	thistick;	/* time in the current tick */
+    unsigned long	calls;		/* number of times entered */
+    double		total;		/* time over all ticks */
+    unsigned long	maxtick;	/* most time in any one tick */
+    unsigned long	recent;		/* time in the recent ticks */
+    unsigned long	recentmax;	/* most time in a recent tick */
+} phasestats;
+
+/* The names of the phases, as they appear in the output.
+ */
+static char const *phasenames[Phase_Count] = {
+    "none", "logic", "moves", "chip", "floor", "slips", "buttons",
+    "mapview", "info", "update", "audio"
+};
+
+/* TRUE if the telemetry is being collected.
+ */
+int			_telemetryon = FALSE;
+
+/* The file that the summary is written to at exit.
+ */
+static FILE	       *outfp = NULL;
+static int		outjson = FALSE;
+
+/* The times of each phase, and the total of all phases per tick.
+ */
+static phasestats	phases[Phase_Count];
+static phasestats	ticktotal;
+
+/* The phase currently being timed, and when it began (or resumed).
+ */
+static int		currentphase = Phase_None;
+static unsigned long	lastchange = 0;
+
+/* The number of ticks counted overall, and since the overlay was
+ * last updated.
+ */
+static unsigned long	tickcount = 0;
+static int		recentticks = 0;
+
+/* The text of the overlay.
+ */
+static char		overlay[1024];
+
+/* Charge the time since the last change of phase to the current
+ * phase, and change to the given phase.
+ */
+static void changephase(int phase)
+{
+    unsigned long	now;
+
+    now = getmicroseconds();
+    if (currentphase != Phase_None)
+	phases[currentphase].thistick += now - lastchange;
+    currentphase = phase;
+    lastchange = now;
+}
+
+/* Begin timing the given phase, and return the previous one.
+ */
+int _beginphase(int phase)
+{
+    int	prev;
+
+    prev = currentphase;
+    changephase(phase);
+    ++phases[phase].calls;
+    return prev;
+}
+
+/* Resume timing the phase that was interrupted.
+ */
+void _endphase(int prev)
+{
+    changephase(prev);
+}
+
+/* Add time collected outside of the main thread.
+ */
+void addphasetime(int phase, unsigned long us, unsigned long calls)
+{
+    if (!_telemetryon)
+	return;
+    phases[phase].thistick += us;
+    phases[phase].calls += calls;
+}
+
+/* Fold the time of the tick just ended into the phase's totals.
+ */
+static void addtick(phasestats *p, unsigned long us)
+{
+    p->total += us;
+    if (us > p->maxtick)
+	p->maxtick = us;
+    p->recent += us;
+    if (us > p->recentmax)
+	p->recentmax = us;
+    p->thistick = 0;
+}
+
+/* Rewrite the overlay to show the average and the greatest time per
+ * tick of each phase over the recent ticks. The phases that took no
+ * time are left out.
+ */
+static void makeoverlay(void)
+{
+    phasestats	       *p;
+    char	       *s;
+    int			n;
+
+    s = overlay;
+    s += sprintf(s, "us per tick, avg/max\n");
+    s += sprintf(s, "total %lu/%lu\n",
+		 ticktotal.recent / recentticks, ticktotal.recentmax);
+    for (n = Phase_None + 1, p = phases + n ; n < Phase_Count ; ++n, ++p)
+	if (p->recent)
+	    s += sprintf(s, "%s %lu/%lu\n", phasenames[n],
+			 p->recent / recentticks, p->recentmax);
+    s[-1] = '\0';
+
+    for (n = Phase_None + 1, p = phases + n ; n < Phase_Count ; ++n, ++p)
+	p->recent = p->recentmax = 0;
+    ticktotal.recent = ticktotal.recentmax = 0;
+    recentticks = 0;
+}
+
+/* Close out the current tick.
+ */
+void telemetrytick(void)
+{
+    unsigned long	busy;
+    int			n;
+
+    if (!_telemetryon)
+	return;
+    if (currentphase != Phase_None)
+	changephase(currentphase);
+    busy = 0;
+    for (n = Phase_None + 1 ; n < Phase_Count ; ++n) {
+	busy += phases[n].thistick;
+	addtick(&phases[n], phases[n].thistick);
+    }
+    ++ticktotal.calls;
+    addtick(&ticktotal, busy);
+    ++tickcount;
+    if (++recentticks >= OVERLAYTICKS)
+	makeoverlay();
+}
+
+/* Return the overlay text, once there is some to show.
+ */
+char const *telemetryoverlay(void)
+{
+    if (!_telemetryon || !*overlay)
+	return NULL;
+    return overlay;
+}
+
+/* Write one phase's line of the summary.
+ */
+static void writephase(char const *name, phasestats const *p, int last)
+{
+    double	mean;
+
+    mean = tickcount ? p->total / tickcount : 0.0;
+    if (outjson)
+	fprintf(outfp, "    { \"phase\": \"%s\", \"calls\": %lu,"
+		       " \"total_us\": %.0f, \"mean_us_per_tick\": %.1f,"
+		       " \"max_us_per_tick\": %lu }%s\n",
+		name, p->calls, p->total, mean, p->maxtick, last ? "" : ",");
+    else
+	fprintf(outfp, "%s,%lu,%.0f,%.1f,%lu\n",
+		name, p->calls, p->total, mean, p->maxtick);
+}
+
+/* At shutdown time, write the summary of each phase, followed by the
+ * total of all phases.
+ */
+static void writesummary(void)
+{
+    int	n;
+
+    if (!outfp)
+	return;
+    if (outjson)
+	fprintf(outfp, "{\n  \"ticks\": %lu,\n  \"phases\": [\n", tickcount);
+    else
+	fprintf(outfp, "phase,calls,total_us,mean_us_per_tick,"
+		       "max_us_per_tick\n");
+    for (n = Phase_None + 1 ; n < Phase_Count ; ++n)
+	writephase(phasenames[n], &phases[n], FALSE);
+    writephase("tick", &ticktotal, TRUE);
+    if (outjson)
+	fprintf(outfp, "  ]\n}\n");
+    if (outfp == stdout)
+	fflush(outfp);
+    else
+	fclose(outfp);
+    outfp = NULL;
+}
+
+/* Open the summary file and begin collecting.
+ */
+int settelemetry(char const *filename)
+{
+    int	n;
+
+    if (!strcmp(filename, "-")) {
+	outfp = stdout;
+    } else if (!(outfp = fopen(filename, "w"))) {
+	errmsg(filename, "cannot write telemetry");
+	return FALSE;
+    }
+    n = strlen(filename);
+    outjson = n > 5 && !strcmp(filename + n - 5, ".json");
+    memset(phases, 0, sizeof phases);
+    memset(&ticktotal, 0, sizeof ticktotal);
+    *overlay = '\0';
+    _telemetryon = TRUE;
+    atexit(writesummary);
+    return TRUE;
+}
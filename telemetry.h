@@ -0,0 +1,69 @@
+/* telemetry.h: Measuring where the time of each tick goes.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_telemetry_h_
+#define	_telemetry_h_
+
+/* The phases of a tick that are timed. The time spent in a phase
+ * does not include the time spent in other phases begun inside of
+ * it, so that each microsecond is counted only once.
+ */
+enum {
+    Phase_None,			/* not being timed */
+    Phase_Logic,		/* game logic not in any phase below */
+    Phase_Moves,		/* choosing and making the creatures' moves */
+    Phase_Chip,			/* Chip's move, where it is made apart */
+    Phase_Floor,		/* floor movements (MS only) */
+    Phase_Slips,		/* updating the slip list (MS only) */
+    Phase_Buttons,		/* handling buttons */
+    Phase_MapView,		/* drawing the map view */
+    Phase_Info,			/* drawing the info panel and message */
+    Phase_Update,		/* sending the drawing to the display */
+    Phase_Audio,		/* mixing the sound effects */
+    Phase_Count
+};
+
+/* TRUE if the telemetry is being collected. This is only set by
+ * settelemetry(), and only tested by the macros below.
+ */
+extern int	_telemetryon;
+
+/* Begin timing the given phase, returning the phase that was being
+ * timed before. The return value must be passed to endphase() when
+ * the phase is over. If the telemetry is not being collected, only
+ * the flag is tested.
+ */
+#define	beginphase(p)	(_telemetryon ? _beginphase(p) : Phase_None)
+#define	endphase(p)	(_telemetryon ? _endphase(p) : (void)0)
+extern int _beginphase(int phase);
+extern void _endphase(int prev);
+
+/* Turn on the collection of telemetry. When the program exits, a
+ * summary of each phase is written to filename, as JSON if the name
+ * ends in .json and as CSV otherwise. A filename of "-" selects
+ * stdout. FALSE is returned if the file cannot be created.
+ */
+extern int settelemetry(char const *filename);
+
+/* Add time spent in a phase that is timed outside of the program's
+ * main thread, such as the mixing of the sound effects. us is the
+ * number of microseconds, and calls the number of times the phase was
+ * entered, since the last report.
+ */
+extern void addphasetime(int phase, unsigned long us, unsigned long calls);
+
+/* Mark the beginning of a new tick. The time collected since the
+ * previous call is counted as one tick's worth.
+ */
+extern void telemetrytick(void);
+
+/* Return a few lines of text summarizing the recent ticks, suitable
+ * for displaying over the game, or NULL if the telemetry is not being
+ * collected. The text changes once per second.
+ */
+extern char const *telemetryoverlay(void);
+
+#endif
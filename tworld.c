@@ -17,6 +17,7 @@
 #include	"solution.h"
 #include	"messages.h"
 #include	"help.h"
+#include	"telemetry.h"
 #include	"oshw.h"
 #include	"cmdline.h"
 #include	"ver.h"
@@ -58,9 +59,17 @@ typedef	struct startupdata {
     char const	       *seriesdir;	/* where the series files are */
     char const	       *seriesdatdir;	/* where the series data files are */
     char const	       *savedir;	/* where the solution files are */
+    char const	       *compilefilename; /* where to write a compiled set */
+    char const	       *videofilename;	/* where to write a video */
+    char const	       *mapimagedir;	/* where to write map images */
+    char const	       *telemetryfilename; /* where to write telemetry */
     int			volumelevel;	/* the initial volume level */
     int			soundbufsize;	/* the sound buffer scaling factor */
     int			mudsucking;	/* slowdown factor (for debugging) */
+    int			levelmemory;	/* limit on level data, in kilobytes */
+    int			scale;		/* the display's scaling factor */
+    int			catchup;	/* max number of missed ticks */
+    int			framerate;	/* frames per second to draw */
     unsigned char	listdirs;	/* TRUE to list directories */
     unsigned char	listseries;	/* TRUE to list files */
     unsigned char	listscores;	/* TRUE to list scores */
@@ -84,6 +93,12 @@ static int		silence = FALSE;
  */
 static int		usepasswds = TRUE;
 
+/* The speed of solution playback, as a power of two, with
+ * PLAYBACK_MAXSPEED meaning as fast as possible.
+ */
+#define	PLAYBACK_MAXSPEED	7
+static int		playbackspeed = 0;
+
 /* The top of the stack of subtitles.
  */
 static void	      **subtitlestack = NULL;
@@ -153,27 +168,34 @@ static char *findstrbreak(char const **str, int maxlen, int *breakpos)
  */
 void printtable(FILE *out, tablespec const *table)
 {
-    int const	maxwidth = 79;
-    char const *mlstr;
-    char const *p;
-    int	       *colsizes;
-    int		mlindex, mlwidth, mlpos;
-    int		diff, pos;
-    int		i, j, n, i0, c, w, z;
+    int const			maxwidth = 79;
+    char const		       *mlstr;
+    char const		       *p;
+    char const		      **cells;
+    char const * const	       *row;
+    int			       *colsizes;
+    int				mlindex, mlwidth, mlpos;
+    int				diff, pos;
+    int				i, j, k, n, i0, c, w, z;
 
     if (!(colsizes = malloc(table->cols * sizeof *colsizes)))
 	return;
+    if (!(cells = malloc(table->cols * sizeof *cells))) {
+	free(colsizes);
+	return;
+    }
     for (i = 0 ; i < table->cols ; ++i)
 	colsizes[i] = 0;
     mlindex = -1;
     mlwidth = 0;
     n = 0;
     for (j = 0 ; j < table->rows ; ++j) {
-	for (i = 0 ; i < table->cols ; ++n) {
-	    c = table->items[n][0] - '0';
+	row = gettablerow(table, &n, cells);
+	for (i = 0, k = 0 ; i < table->cols ; ++k) {
+	    c = row[k][0] - '0';
 	    if (c == 1) {
-		w = strlen(table->items[n] + 2);
-		if (table->items[n][1] == '!') {
+		w = strlen(row[k] + 2);
+		if (row[k][1] == '!') {
 		    if (w > mlwidth || mlindex != i)
 			mlwidth = w;
 		    mlindex = i;
@@ -202,10 +224,11 @@ void printtable(FILE *out, tablespec const *table)
     if (diff > 0) {
 	n = 0;
 	for (j = 0 ; j < table->rows && diff > 0 ; ++j) {
-	    for (i = 0 ; i < table->cols ; ++n) {
-		c = table->items[n][0] - '0';
-		if (c > 1 && table->items[n][1] != '!') {
-		    w = table->sep + strlen(table->items[n] + 2);
+	    row = gettablerow(table, &n, cells);
+	    for (i = 0, k = 0 ; i < table->cols ; ++k) {
+		c = row[k][0] - '0';
+		if (c > 1 && row[k][1] != '!') {
+		    w = table->sep + strlen(row[k] + 2);
 		    for (i0 = i ; i0 < i + c ; ++i0)
 			w -= colsizes[i0] + table->sep;
 		    if (w > 0) {
@@ -239,27 +262,28 @@ void printtable(FILE *out, tablespec const *table)
 	mlstr = NULL;
 	mlwidth = mlpos = 0;
 	pos = 0;
-	for (i = 0 ; i < table->cols ; ++n) {
+	row = gettablerow(table, &n, cells);
+	for (i = 0, k = 0 ; i < table->cols ; ++k) {
 	    if (i)
 		pos += fprintf(out, "%*s", table->sep, "");
-	    c = table->items[n][0] - '0';
+	    c = row[k][0] - '0';
 	    w = -table->sep;
 	    while (c--)
 		w += colsizes[i++] + table->sep;
-	    if (table->items[n][1] == '-')
-		fprintf(out, "%-*.*s", w, w, table->items[n] + 2);
-	    else if (table->items[n][1] == '+')
-		fprintf(out, "%*.*s", w, w, table->items[n] + 2);
-	    else if (table->items[n][1] == '.') {
-		z = (w - strlen(table->items[n] + 2)) / 2;
+	    if (row[k][1] == '-')
+		fprintf(out, "%-*.*s", w, w, row[k] + 2);
+	    else if (row[k][1] == '+')
+		fprintf(out, "%*.*s", w, w, row[k] + 2);
+	    else if (row[k][1] == '.') {
+		z = (w - strlen(row[k] + 2)) / 2;
 		if (z < 0)
 		    z = w;
 		fprintf(out, "%*.*s%*s",
-			     w - z, w - z, table->items[n] + 2, z, "");
-	    } else if (table->items[n][1] == '!') {
+			     w - z, w - z, row[k] + 2, z, "");
+	    } else if (row[k][1] == '!') {
 		mlwidth = w;
 		mlpos = pos;
-		mlstr = table->items[n] + 2;
+		mlstr = row[k] + 2;
 		p = findstrbreak(&mlstr, w, &z);
 		fprintf(out, "%.*s%*s", z, p, w - z, "");
 	    }
@@ -271,6 +295,7 @@ void printtable(FILE *out, tablespec const *table)
 	    fprintf(out, "%*s%.*s\n", mlpos, "", w, p);
 	}
     }
+    free(cells);
     free(colsizes);
 }
 
@@ -999,6 +1024,8 @@ static int playgame(gamespec *gs, int firstcmd)
 	lastrendered = render;
 	if (n)
 	    break;
+	while (waitforframe())
+	    drawframe();
 	render = waitfortick();
 	cmd = input(FALSE);
 	if (cmd == CmdQuitLevel) {
@@ -1056,6 +1083,7 @@ static int playgame(gamespec *gs, int firstcmd)
     if (!lastrendered)
 	drawscreen(TRUE);
     setgameplaymode(EndPlay);
+    drawframe();
     if (n > 0)
 	if (replacesolution())
 	    savesolutions(&gs->series);
@@ -1072,10 +1100,30 @@ static int playgame(gamespec *gs, int firstcmd)
     return FALSE;
 }
 
+/* Change the playback speed by delta and display the new speed.
+ */
+static void changeplaybackspeed(int delta)
+{
+    char	buf[32];
+
+    playbackspeed += delta;
+    if (playbackspeed < 0)
+	playbackspeed = 0;
+    else if (playbackspeed > PLAYBACK_MAXSPEED)
+	playbackspeed = PLAYBACK_MAXSPEED;
+    if (playbackspeed == PLAYBACK_MAXSPEED)
+	strcpy(buf, "Playback: max speed");
+    else
+	sprintf(buf, "Playback: %dx speed", 1 << playbackspeed);
+    setdisplaymsg(buf, 1000, 1000);
+}
+
 /* Play back the user's best solution for the current level in real
  * time. Other than the fact that this function runs from a
  * prerecorded series of moves, it has the same behavior as
- * playgame().
+ * playgame(). When the playback speed is raised, several ticks are
+ * run for each frame and only the last one is displayed. At the
+ * maximum speed, ticks are run until it is time for the next frame.
  */
 static int playbackgame(gamespec *gs)
 {
@@ -1087,15 +1135,22 @@ static int playbackgame(gamespec *gs)
     setgameplaymode(BeginPlay);
     render = lastrendered = TRUE;
     for (;;) {
-	n = doturn(CmdNone);
+	if (playbackspeed == PLAYBACK_MAXSPEED)
+	    n = doturns(CmdNone, 0);
+	else
+	    n = doturns(CmdNone, 1 << playbackspeed);
 	drawscreen(render);
 	lastrendered = render;
 	if (n)
 	    break;
-	render = waitfortick();
+	while (waitforframe())
+	    drawframe();
+	render = waitfortick() || playbackspeed == PLAYBACK_MAXSPEED;
 	switch (input(FALSE)) {
 	  case CmdVolumeUp:	changevolume(+2, TRUE);		break;
 	  case CmdVolumeDown:	changevolume(-2, TRUE);		break;
+	  case CmdFaster:	changeplaybackspeed(+1);	break;
+	  case CmdSlower:	changeplaybackspeed(-1);	break;
 	  case CmdPrevLevel:	changecurrentgame(gs, -1);	goto quitloop;
 	  case CmdNextLevel:	changecurrentgame(gs, +1);	goto quitloop;
 	  case CmdSameLevel:					goto quitloop;
@@ -1125,6 +1180,7 @@ static int playbackgame(gamespec *gs)
     if (!lastrendered)
 	drawscreen(TRUE);
     setgameplaymode(EndPlay);
+    drawframe();
     gs->playmode = Play_None;
     if (n < 0)
 	replaceablesolution(gs, +1);
@@ -1292,6 +1348,102 @@ static int batchverify(gameseries *series, int display)
     return invalid;
 }
 
+/* Play back the user's solution for the given level as fast as
+ * possible, without using the timer or the keyboard, and write the
+ * display at each tick to the video file. FALSE is returned if the
+ * solution could not be played back in full or the video could not be
+ * written.
+ */
+static int exportvideo(gameseries *series, int number)
+{
+    gamesetup  *game;
+    int		n, f;
+
+    n = findlevelinseries(series, number, NULL);
+    if (n < 0) {
+	errmsg(series->filebase, "no level numbered %d", number);
+	return FALSE;
+    }
+    game = series->games + n;
+    if (!hassolution(game)) {
+	errmsg(series->filebase, "no solution for level %d", number);
+	return FALSE;
+    }
+    if (!initgamestate(game, series->ruleset, TRUE) || !prepareplayback()) {
+	errmsg(series->filebase, "cannot play back level %d", number);
+	endgamestate();
+	return FALSE;
+    }
+
+    setframerate(0);
+    setgameplaymode(BeginVerify);
+    drawscreen(TRUE);
+    for (;;) {
+	f = doturn(CmdNone);
+	drawscreen(TRUE);
+	if (f)
+	    break;
+	advancetick();
+    }
+    setgameplaymode(EndVerify);
+    endgamestate();
+
+    if (!finishvideoexport())
+	return FALSE;
+    if (f < 0) {
+	errmsg(series->filebase, "solution for level %d is invalid", number);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/* Write an image of the starting position of every level in the
+ * series to the given directory, without using the timer or the
+ * keyboard. Each image is named after the level set and the level's
+ * number. FALSE is returned if any of the images could not be
+ * written.
+ */
+static int exportmapimages(gameseries *series, char const *dir)
+{
+    gamesetup  *game;
+    char const *ext;
+    char       *path;
+    char	name[256];
+    int		len, f, i;
+
+    if (!finddir(dir)) {
+	errmsg(dir, "cannot create directory");
+	return FALSE;
+    }
+    ext = strrchr(series->name, '.');
+    len = ext ? (int)(ext - series->name) : (int)strlen(series->name);
+    if (len > 200)
+	len = 200;
+
+    path = getpathbuffer();
+    f = TRUE;
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (!initgamestate(game, series->ruleset, TRUE)) {
+	    errmsg(series->filebase, "cannot start level %d", game->number);
+	    f = FALSE;
+	} else {
+	    sprintf(name, "%.*s-%03d.ppm", len, series->name, game->number);
+	    if (!combinepath(path, dir, name)) {
+		errmsg(dir, "cannot create path for %s", name);
+		f = FALSE;
+	    } else if (!savemapimage(path)) {
+		f = FALSE;
+	    }
+	}
+	endgamestate();
+    }
+    free(path);
+
+    if (!finishmapimages())
+	f = FALSE;
+    return f;
+}
+
 /*
  * Game selection functions
  */
@@ -1551,7 +1703,15 @@ static int processoption(int opt, char const *val, void *data)
       case 'L':	    start->seriesdir = val;			    break;
       case 'R':	    start->resdir = val;			    break;
       case 'S':	    start->savedir = val;			    break;
+      case 'C':	    start->compilefilename = val;		    break;
+      case 'E':	    start->videofilename = val;			    break;
+      case 'I':	    start->mapimagedir = val;			    break;
+      case 'T':	    start->telemetryfilename = val;		    break;
+      case 'M':	    start->levelmemory = nparse(val, 1, 4194304);   break;
+      case 'Z':	    start->scale = nparse(val, 1, 4);		    break;
       case 'H':	    start->showhistogram = !start->showhistogram;   break;
+      case 'c':	    start->catchup = nparse(val, 0, 1000);	    break;
+      case 'f':	    start->framerate = nparse(val, 0, 1000);	    break;
       case 'F':	    start->fullscreen = !start->fullscreen;	    break;
       case 'p':	    usepasswds = !usepasswds;			    break;
       case 'q':	    silence = !silence;				    break;
@@ -1589,14 +1749,20 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
     static option const optlist[] = {
 	{ "audio-buffer",	'a', 'a', 1 },
 	{ "batch-verify",	'b', 'b', 0 },
+	{ "catch-up",		 0 , 'c', 1 },
+	{ "compile-levelset",	 0 , 'C', 1 },
 	{ "data-dir",		'D', 'D', 1 },
 	{ "list-dirs",		'd', 'd', 0 },
+	{ "export-video",	 0 , 'E', 1 },
+	{ "frame-rate",		 0 , 'f', 1 },
 	{ "full-screen",	'F', 'F', 0 },
 	{ "histogram",		 0 , 'H', 0 },
 	{ "help",		'h', 'h', 0 },
 	{ "initial-levelset",	 0 , 'i', 1 },
+	{ "level-memory",	 0 , 'M', 1 },
 	{ "levelset-dir",	'L', 'L', 1 },
 	{ "list-levelsets",	'l', 'l', 0 },
+	{ "map-images",		 0 , 'I', 1 },
 #ifndef NDEBUG
 	{ "mud-sucking",	'm', 'm', 1 },
 #endif
@@ -1607,8 +1773,10 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
 	{ "resource-dir",	'R', 'R', 1 },
 	{ "read-only",		'r', 'r', 0 },
 	{ "save-dir",		'S', 'S', 1 },
+	{ "scale",		 0 , 'Z', 1 },
 	{ "list-scores",	's', 's', 0 },
 	{ "list-times",		't', 't', 0 },
+	{ "telemetry",		 0 , 'T', 1 },
 	{ "version",		'V', 'V', 0 },
 	{ "version-number",	'v', 'v', 0 },
 	{ 0, 0, 0, 0 }
@@ -1625,6 +1793,10 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
     start->seriesdir = NULL;
     start->seriesdatdir = NULL;
     start->savedir = NULL;
+    start->compilefilename = NULL;
+    start->videofilename = NULL;
+    start->mapimagedir = NULL;
+    start->telemetryfilename = NULL;
     start->listdirs = FALSE;
     start->listseries = FALSE;
     start->listscores = FALSE;
@@ -1637,6 +1809,10 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
     start->volumelevel = -1;
     start->soundbufsize = -1;
     start->mudsucking = 1;
+    start->levelmemory = 0;
+    start->scale = 1;
+    start->catchup = -1;
+    start->framerate = 60;
 
     if (readoptions(optlist, argc, argv, processoption, start)) {
 	fprintf(stderr, "Try --help for more information.\n");
@@ -1646,6 +1822,8 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
 	setreadonly();
     if (start->pedantic)
 	setpedanticmode();
+    if (start->levelmemory)
+	setlevelmemorylimit(start->levelmemory * 1024UL);
 
     initdirs(start->seriesdir, start->seriesdatdir,
 	     start->resdir, start->savedir);
@@ -1733,12 +1911,17 @@ static int getsettings(int argc, char *argv[], startupdata *start)
     if (!getsettingsfrominitfile(start))
 	return FALSE;
     if (start->listscores || start->listtimes || start->batchverify
-					      || start->levelnum) {
+			  || start->compilefilename || start->levelnum
+			  || start->videofilename || start->mapimagedir) {
 	if (!*start->filename) {
 	    errmsg(NULL, "no level set specified");
 	    return FALSE;
 	}
     }
+    if (start->videofilename && !start->levelnum) {
+	errmsg(NULL, "no level specified for the video");
+	return FALSE;
+    }
     return TRUE;
 }
 
@@ -1748,11 +1931,14 @@ static int initializesystem(startupdata const *start)
 {
     setmudsuckingfactor(start->mudsucking);
     if (!oshwinitialize(silence, start->soundbufsize,
-			start->showhistogram, start->fullscreen))
+			start->showhistogram, start->fullscreen,
+			start->scale))
 	return FALSE;
     if (!initresources())
 	return FALSE;
     setkeyboardrepeat(TRUE);
+    settimercatchup(start->catchup);
+    setframerate(start->framerate);
     if (start->volumelevel >= 0)
 	setvolume(start->volumelevel, FALSE);
     return TRUE;
@@ -1809,6 +1995,9 @@ static int choosegameatstartup(gamespec *gs, startupdata const *start)
 	    errmsg(series.list[0].filebase, "cannot read level set");
 	    return -1;
 	}
+	if (start->compilefilename)
+	    return writecompiledseries(series.list,
+				       start->compilefilename) ? 0 : -1;
 	if (start->batchverify) {
 	    n = batchverify(series.list, !silence && !start->listtimes
 						  && !start->listscores);
@@ -1821,9 +2010,9 @@ static int choosegameatstartup(gamespec *gs, startupdata const *start)
 	    if (!createscorelist(series.list, usepasswds, '0',
 				 NULL, NULL, &table))
 		return -1;
-	    freeserieslist(series.list, series.count, &series.table);
 	    printtable(stdout, &table);
 	    freescorelist(NULL, &table);
+	    freeserieslist(series.list, series.count, &series.table);
 	    return 0;
 	}
 	if (start->listtimes) {
@@ -1831,18 +2020,37 @@ static int choosegameatstartup(gamespec *gs, startupdata const *start)
 				series.list->ruleset == Ruleset_MS ? 10 : 100,
 				'0', NULL, NULL, &table))
 		return -1;
-	    freeserieslist(series.list, series.count, &series.table);
 	    printtable(stdout, &table);
 	    freetimelist(NULL, &table);
+	    freeserieslist(series.list, series.count, &series.table);
 	    return 0;
 	}
     }
 
+    if (start->videofilename || start->mapimagedir) {
+	if (series.count != 1) {
+	    errmsg(NULL, "a single level set must be named");
+	    return -1;
+	}
+	silence = TRUE;
+	if (!(start->videofilename ? setvideoexport(start->videofilename)
+				   : setmapimageexport()))
+	    return -1;
+    }
+
+    if (start->telemetryfilename && !settelemetry(start->telemetryfilename))
+	return -1;
+
     if (!initializesystem(start)) {
 	errmsg(NULL, "cannot initialize program due to previous errors");
 	return -1;
     }
 
+    if (start->videofilename)
+	return exportvideo(series.list, start->levelnum) ? 0 : -1;
+    if (start->mapimagedir)
+	return exportmapimages(series.list, start->mapimagedir) ? 0 : -1;
+
     return selectseriesandlevel(gs, &series, TRUE,
 				start->selectfilename, start->levelnum);
 }
@@ -246,20 +246,25 @@ int markunsolvablelevels(gameseries *series)
 
 /* Read the list of unsolvable levels from the given filename. If the
  * filename does not contain a path, then the function looks for the
- * file in the resource directory and the user's save directory.
+ * file in the resource directory and the user's save directory. The
+ * file is read into memory in one piece before it is parsed. It is
+ * opened in binary mode for this, and the parser already treats a
+ * carriage return at the end of a line as whitespace.
  */
 int loadunslistfromfile(char const *filename)
 {
     fileinfo	file;
 
     memset(&file, 0, sizeof file);
-    if (openfileindir(&file, getresdir(), filename, "r", NULL)) {
+    if (openfileindir(&file, getresdir(), filename, "rb", NULL)) {
+	filebuffer(&file, NULL);
 	readunslist(&file);
 	fileclose(&file, NULL);
     }
     if (!haspathname(filename)) {
 	memset(&file, 0, sizeof file);
-	if (openfileindir(&file, getsavedir(), filename, "r", NULL)) {
+	if (openfileindir(&file, getsavedir(), filename, "rb", NULL)) {
+	    filebuffer(&file, NULL);
 	    readunslist(&file);
 	    fileclose(&file, NULL);
 	}